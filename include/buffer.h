@@ -0,0 +1,163 @@
+/**
+ * Definition of the geometry buffers, which keep the faces of a static figure as indexed
+ * vertices. They are built once on the CPU and uploaded to a vertex and an index buffer
+ * object the first time they are drawn with OpenGL, and again only when they change.
+ * The geometry of several figures can be joined into a single buffer, drawn with a call
+ * to glMultiDrawElements for each kind of primitive. The geometry can also be kept in
+ * memory owned by someone else, such as a mapped file, and uploaded straight from it. The core profile has no quads nor
+ * polygons, so for it the primitives are split into lists of points, lines and triangles.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _BUFFER_H_
+#define _BUFFER_H_
+
+#include <GL/gl.h>
+#include <vector>
+
+namespace GEngine {
+    class GeometryBuffer;
+    class CommandBuffer;
+    struct BufferVertex;
+    struct BufferDraw;
+};
+
+/**
+ * A vertex as it is stored in the vertex buffer.
+ */
+struct GEngine::BufferVertex {
+    GLfloat x, y, z;
+    GLfloat s, t;
+};
+
+/**
+ * A primitive of the buffer, a range of its indices.
+ */
+struct GEngine::BufferDraw {
+    GLenum      mode;
+    unsigned    first, count;
+};
+
+#define BufferVertexList    std::vector<GEngine::BufferVertex>
+#define BufferIndexList     std::vector<GLuint>
+#define BufferDrawList      std::vector<GEngine::BufferDraw>
+
+/* The ranges of the indices drawn with the core profile, see GeometryBuffer::drawCore(). */
+enum {
+    CORE_CORNERS,       /* The vertices of the faces, drawn as points. */
+    CORE_POINTS,
+    CORE_LINES,
+    CORE_EDGES,         /* The edges of the faces, drawn as lines. */
+    CORE_TRIANGLES,
+    CORE_RANGES
+};
+
+/**
+ * The geometry of a static figure.
+ */
+class GEngine::GeometryBuffer {
+    private:
+        BufferVertexList    vertices;
+        BufferIndexList     indices;
+        BufferDrawList      draws;
+        bool        mapped;     /* Whether the geometry is in memory of someone else. */
+        const BufferVertex  * vertexData;   /* The geometry drawn, in the lists or not. */
+        const GLuint        * indexData;
+        const BufferDraw    * drawData;
+        unsigned    vertexCount, indexCount, drawCount;
+        GLfloat     bounds[6];  /* The minimum and maximum x, y and z of the vertices. */
+        unsigned    calls;      /* The runs of draws with the same primitive. */
+        unsigned    version;    /* Increased each time the geometry changes. */
+
+        GLuint      vbo, ibo;   /* The buffer objects, 0 until they are uploaded. */
+        unsigned    uploaded;   /* The version in the buffer objects. */
+        std::vector<GLsizei>        counts;     /* The arguments of glMultiDrawElements. */
+        std::vector<const void *>   offsets;
+
+        GLuint      coreIbo;    /* The indices of the core profile, 0 until uploaded. */
+        unsigned    coreUploaded; /* The version in the core indices. */
+        unsigned    coreFirst[CORE_RANGES + 1]; /* The first index of each range. */
+
+        /* Adds a draw, joining it with the previous one when it can be. */
+        void addDraw(GLenum mode, unsigned first, unsigned count);
+
+        /* Adds a vertex to the bounds. */
+        void addBounds(const BufferVertex& vert);
+
+        /* Points the geometry drawn to the lists, copying the mapped one into them before
+         * it changes. */
+        void sync();
+        void own();
+
+        /* Uploads the geometry into the buffer objects if it changed. */
+        void upload();
+
+        /* Binds/Unbinds the buffer objects and the arrays, uploading them if needed. */
+        void bind();
+        void unbind();
+
+        /* Builds and uploads the indices of the core profile if the geometry changed. */
+        void uploadCore();
+    public:
+        GeometryBuffer();
+        ~GeometryBuffer();
+
+        /* Builds the geometry from the draws of a command buffer, joining the vertices
+         * which are equal. */
+        void build(const CommandBuffer& cmds);
+
+        /* Adds the geometry of another buffer after the one of this one. */
+        void append(const GeometryBuffer& other);
+
+        /* Removes all the geometry. */
+        void clear();
+
+        /* Uses the geometry in memory of someone else, which must be kept until the
+         * geometry is cleared or destroyed. The box of the vertices is given. */
+        void map(const BufferVertex * verts, unsigned vertCount, const GLuint * idx,
+                unsigned idxCount, const BufferDraw * prims, unsigned primCount,
+                const GLfloat box[6]);
+
+        /* Uploads the geometry if it changed and draws it with the current context. */
+        void draw();
+
+        /* As draw(), but drawing several instances at once with glDrawElementsInstanced. */
+        void drawInstanced(GLsizei instances);
+
+        /* Draws the geometry with the core profile, giving the vertices as the attributes
+         * 0 (position) and 1 (texture coordinates), with the faces drawn as the polygon
+         * mode says. With instances > 0 it draws them with glDrawElementsInstanced. */
+        void drawCore(GLenum polyMode, GLsizei instances = 0);
+
+        /* Splits a primitive into lists of points, pairs of lines and triangles. The faces
+         * are split into triangles, or their edges or corners for the polygon modes
+         * GL_LINE and GL_POINT. The indices are idx[0..count), or base + [0..count) if
+         * idx is NULL. */
+        static void split(GLenum mode, GLenum polyMode, const GLuint * idx, GLuint base,
+                unsigned count, BufferIndexList * points, BufferIndexList * lines,
+                BufferIndexList * triangles);
+
+        /* Gets the geometry, and the number of vertices, indices and primitives. */
+        const BufferVertex * getVertices() const;
+        const GLuint * getIndices() const;
+        const BufferDraw * getDraws() const;
+        unsigned getVertexCount() const;
+        unsigned getIndexCount() const;
+        unsigned getDrawCount() const;
+
+        /* Gets the faces split into triangles, as indices of the vertices. */
+        void getFaces(BufferIndexList * triangles) const;
+        unsigned getVersion() const;
+
+        /* Gets the box containing the geometry, as the minimum and the maximum x, y, z. */
+        const GLfloat * getBounds() const;
+
+        /* Gets the number of calls needed to draw the geometry. */
+        unsigned getCalls() const;
+};
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * Definition of the bounding volume hierarchies, the trees of boxes used to find the
+ * static figures seen by a camera, crossed by a ray or inside a region without testing
+ * all of them. The tree is built once, splitting the items by the surface area heuristic
+ * over bins of their centers, with the lower levels built in parallel. The nodes are
+ * kept in a single array in depth first order: the first child of a node follows it.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _BVH_H_
+#define _BVH_H_
+
+#include <GL/gl.h>
+#include <vector>
+
+namespace GEngine {
+    class BVH;
+    class Frustum;
+    struct BVHNode;
+};
+
+/* The bins used to look for the best split of a node. */
+#define BVH_BINS        16
+
+/* The items of a leaf above which it is always split. */
+#define BVH_LEAF_SIZE   4
+
+/* The maximum depth of the tree, the size of the stacks of the traversals. */
+#define BVH_MAX_DEPTH   64
+
+/* The items below which a subtree is built by a single job. */
+#define BVH_TASK_SIZE   4096
+
+/**
+ * A node of the tree.
+ */
+struct GEngine::BVHNode {
+    GLfloat     bounds[6];  /* The box of the items below the node. */
+    unsigned    first, count; /* The items below the node, a range of BVH::items. */
+    unsigned    right;      /* The second child, 0 for the leaves; the first one follows. */
+};
+
+#define BVHNodeList     std::vector<GEngine::BVHNode>
+
+/**
+ * The hierarchy over a set of boxes. The queries give the indices of the boxes as they
+ * were passed to build().
+ */
+class GEngine::BVH {
+    private:
+        BVHNodeList             nodes;
+        std::vector<unsigned>   items;  /* The boxes, in the order of the leaves. */
+        std::vector<GLfloat>    boxes;  /* The minimum and maximum x, y and z of each box. */
+        std::vector<GLfloat>    centers;
+
+        /* Gets the box of the items in a range and the box of their centers. */
+        void bound(unsigned first, unsigned last, GLfloat box[6], GLfloat centerBox[6]) const;
+
+        /* Sorts a range into its two children, returns the first item of the second one,
+         * or last if it should be a leaf. */
+        unsigned split(unsigned first, unsigned last, const GLfloat box[6],
+                const GLfloat centerBox[6], unsigned depth);
+
+        /* Builds the subtree of a range, appending its nodes. */
+        void buildRange(unsigned first, unsigned last, unsigned depth, BVHNodeList& out);
+
+        /* Adds the items of a node to a list. */
+        void addItems(const BVHNode& node, std::vector<unsigned> * found) const;
+    public:
+        /* Builds the tree over count boxes, given by their minimum and maximum x, y, z. */
+        void build(const GLfloat * boxes, unsigned count);
+
+        /* Removes all the boxes. */
+        void clear();
+
+        /* Gets the boxes which can be seen through a frustum. */
+        void cull(const Frustum& frustum, std::vector<unsigned> * found) const;
+
+        /* Gets the boxes crossed by the segment from origin along dir, of a length in
+         * units of dir. */
+        void intersect(const GLfloat origin[3], const GLfloat dir[3], GLfloat length,
+                std::vector<unsigned> * found) const;
+
+        /* Gets the boxes which overlap a region. */
+        void query(const GLfloat region[6], std::vector<unsigned> * found) const;
+
+        /* Gets the nodes of the tree, the root first. */
+        const BVHNodeList& getNodes() const;
+};
+
+#endif
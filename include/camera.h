@@ -17,13 +17,18 @@
 namespace GEngine {
     class Camera;
     class StaticCamera;
+    class Frustum;
 };
 
+/* The planes tested by a frustum, the six of the camera padded to groups of four. */
+#define FRUSTUM_PLANES  8
+
 /**
  * Define the generic camera class.
  */
 class GEngine::Camera {
     friend class StaticCamera;
+    friend class SceneFile;
     protected:
         Geometry::Point       position;   /* The position of the camera in the space. */
         double      yaw, pitch, roll;   /* The inclination of the camera in the three axis. */
@@ -49,8 +54,49 @@ class GEngine::Camera {
 
         /* Sets the field of view for the camera. */
         void setFOV(double distance, double overture, double depth);
+
+        /* Gets the modelview and projection matrices set by activate(), by columns. */
+        void getModelview(double matrix[16]) const;
+        void getProjection(double matrix[16]) const;
+
+        /* Gets the position of the camera as the modelview places it. */
+        void getEye(double eye[3]) const;
+
+        /* Gets the planes of the view: left, right, bottom, top, near and far. */
+        void getFrustum(double planes[6][4]) const;
  };
 
+/**
+ * The volume seen by a camera, to discard the figures out of it before drawing them. The
+ * planes are kept by components, so four of them are tested at once with SSE.
+ */
+class GEngine::Frustum {
+    private:
+        /* The planes, with the normals pointing inside, and the absolute normals. */
+        alignas(16) GLfloat nx[FRUSTUM_PLANES], ny[FRUSTUM_PLANES], nz[FRUSTUM_PLANES];
+        alignas(16) GLfloat dist[FRUSTUM_PLANES];
+        alignas(16) GLfloat ax[FRUSTUM_PLANES], ay[FRUSTUM_PLANES], az[FRUSTUM_PLANES];
+
+        /* Tests a box given by its center and its half sizes, grown by a radius. */
+        bool test(GLfloat cx, GLfloat cy, GLfloat cz, GLfloat ex, GLfloat ey, GLfloat ez,
+                GLfloat radius) const;
+    public:
+        /* Builds a frustum which sees everything. */
+        Frustum();
+
+        /* Sets the frustum seen by a camera. */
+        void set(const Camera * cam);
+
+        /* Returns whether a box, the minimum and maximum x, y and z, can be seen. */
+        bool isBoxVisible(const GLfloat box[6]) const;
+
+        /* Returns whether a box is entirely inside the frustum. */
+        bool isBoxInside(const GLfloat box[6]) const;
+
+        /* Returns whether a sphere, its center and radius, can be seen. */
+        bool isSphereVisible(const GLfloat sphere[4]) const;
+};
+
 /**
  * Define a static camera.
  */
@@ -0,0 +1,72 @@
+/**
+ * Definition of the clock used to measure the time of the frames. It is based on
+ * a monotonic clock with nanosecond resolution, so it is not affected by the changes
+ * of the wall-clock time.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include <chrono>
+
+/* The number of frame times kept by the clock. */
+#define CLOCK_HISTORY   256
+
+/* Weight of the last frame on the smoothed FPS. */
+#define CLOCK_FPS_ALPHA 0.1
+
+namespace GEngine {
+    class Clock;
+};
+
+/**
+ * The frame clock. It must be ticked once per frame, and it keeps the delta between
+ * frames, the total time since it was reset, the number of frames and a ring buffer
+ * with the last CLOCK_HISTORY frame times.
+ */
+class GEngine::Clock {
+    private:
+        std::chrono::steady_clock::time_point   start,  /* The moment of the last reset. */
+                                                last;   /* The moment of the last tick. */
+        long long   delta;  /* The duration of the last frame in nanoseconds. */
+        long long   total;  /* The time since the reset in nanoseconds. */
+        unsigned long long frames; /* The number of frames since the reset. */
+        double      fps;    /* The smoothed frames per second. */
+        long long   history[CLOCK_HISTORY]; /* The ring buffer of frame times. */
+        unsigned    head;   /* The next position to write in the ring buffer. */
+    public:
+        Clock();
+
+        /* Restarts the clock, the counters and the history. */
+        void reset();
+
+        /* Marks the beginning of a new frame. */
+        void tick();
+
+        /* Gets the duration of the last frame and the time since the reset, in milliseconds. */
+        double getDelta() const;
+        double getTotal() const;
+
+        /* Gets the same values in nanoseconds. */
+        long long getDeltaNs() const;
+        long long getTotalNs() const;
+
+        /* Gets the number of frames since the reset. */
+        unsigned long long getFrames() const;
+
+        /* Gets the smoothed frames per second. */
+        double getFPS() const;
+
+        /* Copies the last frame times (in milliseconds) from the oldest to the newest. */
+        unsigned getFrameTimes(double * times, unsigned count) const;
+
+        /* Gets the monotonic time in nanoseconds, with an undefined origin. */
+        static long long now();
+};
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * Definition of the command buffers, which record what the scene submits to a renderer
+ * so it can be executed later by any other renderer. A buffer is not shared between
+ * threads: each thread records into its own and the buffers are appended in order.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _COMMAND_H_
+#define _COMMAND_H_
+
+#include <vector>
+#include "renderer.h"
+
+namespace GEngine {
+    class CommandBuffer;
+    struct RenderCommand;
+    struct CommandVertex;
+};
+
+/**
+ * A command recorded. Only the fields used by its type are meaningful.
+ */
+struct GEngine::RenderCommand {
+    enum Type {
+        BEGIN_FRAME,
+        END_FRAME,
+        ACTIVATE_CAMERA,
+        DEACTIVATE_CAMERA,
+        SET_AMBIENT,
+        SET_LIGHT,
+        SET_POLYGON_MODE,
+        SET_MATERIAL,
+        UNSET_MATERIAL,
+        PUSH_MATRIX,
+        POP_MATRIX,
+        DRAW,
+        DRAW_STATIC,
+        DRAW_INSTANCED
+    } type;
+    GLenum      mode;       /* The primitive of a draw or the polygon mode. */
+    GLenum      face;       /* The faces affected by a polygon mode. */
+    unsigned    first;      /* The first vertex, matrix or frame parameter of the command. */
+    unsigned    count;      /* The vertices or the instances of a draw. */
+    union {
+        Camera      * camera;
+        Light       * light;
+        Material    * material;
+        GeometryBuffer  * geometry;
+    };
+    GLfloat     color[4];   /* The ambient light. */
+};
+
+/**
+ * A vertex of a draw, with its texture coordinates.
+ */
+struct GEngine::CommandVertex {
+    GLdouble    x, y, z;
+    GLdouble    s, t;
+};
+
+#define RenderCommandList   std::vector<GEngine::RenderCommand>
+#define CommandVertexList   std::vector<GEngine::CommandVertex>
+
+/**
+ * A renderer which records the commands instead of drawing them.
+ */
+class GEngine::CommandBuffer : public GEngine::Renderer {
+    private:
+        RenderCommandList   commands;
+        CommandVertexList   vertices;
+
+        /* The parameters of the frames, which are too big to be kept by each command. */
+        std::vector<GLuint>     frameInts;
+        std::vector<GLfloat>    frameColors;
+
+        /* The matrices pushed and the ones of the instanced draws, 16 floats each. */
+        std::vector<GLfloat>    matrices;
+
+        RenderCommand& push(RenderCommand::Type type);
+    public:
+        void beginFrame(const GLuint position[2], const GLuint screen[3],
+                const GLfloat bgcolor[3], const GLfloat fgcolor[3]);
+        void endFrame();
+        void activateCamera(Camera * cam);
+        void deactivateCamera(Camera * cam);
+        void setAmbient(const GLfloat ambient[4]);
+        void setLight(Light * light);
+        void setPolygonMode(GLenum face, GLenum mode);
+        void setMaterial(Material * mat);
+        void unsetMaterial(Material * mat);
+        void pushMatrix(const GLfloat matrix[16]);
+        void popMatrix();
+        void begin(GLenum mode);
+        void vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s = 0, GLdouble t = 0);
+        void end();
+        void drawStatic(GeometryBuffer * geometry);
+        void drawInstanced(GeometryBuffer * geometry, const GLfloat * matrices,
+                unsigned count);
+        bool readPixels(GLuint width, GLuint height, unsigned char * pixels);
+
+        /* Removes all the commands, keeping the memory for the next frame. */
+        void clear();
+
+        /* Adds the commands of another buffer, or the ones in [first, last) of it, after
+         * the ones of this one. */
+        void append(const CommandBuffer& other);
+        void append(const CommandBuffer& other, unsigned first, unsigned last);
+
+        /* Submits the commands to a renderer, in the order they were recorded. */
+        void execute(Renderer * rend) const;
+
+        /* Gets the recorded commands, vertices and matrices. */
+        const RenderCommandList& getCommands() const;
+        const CommandVertexList& getVertices() const;
+        const std::vector<GLfloat>& getMatrices() const;
+};
+
+#endif
@@ -12,6 +12,9 @@
 
 #include <GL/gl.h>
 #include "world.h"
+#include "clock.h"
+#include "stats.h"
+#include "renderer.h"
 
 namespace GEngine {
     class Display;
@@ -26,6 +29,8 @@ class GEngine::Display {
         static void displayInit();
         static void SwapBuffers();
         static void idleRender();
+        static void drawOverlay();
+        static void printStats();
         void initGL();
     protected:
         GLuint screen[3];   /* Dimensions of the main window. */
@@ -38,6 +43,12 @@ class GEngine::Display {
         int mainWin;    /* The identifier of the main Window. */
 
         Scene * scene;
+        Map     * map;  /* The map streaming the scenes around the camera, or NULL. */
+        Renderer * renderer; /* The backend drawing the scene, set by print(). */
+        unsigned frames;    /* The frames to draw by the headless backends, 0 means forever. */
+        Clock   clock;  /* The clock measuring the frames. */
+        RenderStats lastStats; /* The counters of the last frame drawn. */
+        bool    overlay;    /* Whether the counters are printed over the scene. */
         /* The function to draw the screen. */
         static void displayFunc();
     public:
@@ -58,6 +69,27 @@ class GEngine::Display {
 
         /* Sets the current scene to display. */
         void setScene(Scene * scene);
+
+        /* Sets the map to display instead of a single scene. */
+        void setMap(Map * map);
+
+        /* Gets the clock with the timing of the frames. */
+        const Clock * getClock() const;
+
+        /* Gets the render counters of the last frame drawn. */
+        const RenderStats& stats() const;
+
+        /* Shows or hides the render counters over the scene. */
+        void showStats(bool show);
+
+        /* Sets the number of frames drawn by print() on the headless backends. */
+        void setFrames(unsigned count);
+
+        /* Copies the last frame as RGBA rows from the bottom to the top. */
+        bool readPixels(unsigned char * pixels);
+
+        /* Saves the last frame into a PPM file. */
+        bool saveFrame(const char * file);
 };
 
 #endif
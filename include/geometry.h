@@ -14,6 +14,7 @@
 #include <GL/gl.h>
 #include "matrix.h"
 #include "material.h"
+#include "renderer.h"
 
 static const double Z_dir[3] = { 0.0, 0.0, 1.0 };
 
@@ -57,6 +58,7 @@ namespace GEngine {
         class Cone;
         class Toroid;
     };
+    struct StaticBatch;
 };
 
 /**
@@ -64,6 +66,19 @@ namespace GEngine {
  */
 class GEngine::Geometry::Figure {
 		friend class Point;
+    private:
+        FaceList    * faces;    /* The faces printed for the bounds, not recorded yet. */
+        GLfloat     bounds[6];  /* The minimum and maximum x, y and z of the faces. */
+        GLfloat     sphere[4];  /* The center and the radius of the faces. */
+        bool        bounded;    /* Whether the bounds were calculated. */
+        double      faceBox[6]; /* The box of the faces as printed, before the rotation. */
+        bool        shaped;     /* Whether faceBox is the one of the current faces. */
+
+        /* Deletes the faces printed for the bounds. */
+        void clearFaces();
+
+        /* Prints the faces and finds their box. */
+        void boundFaces();
     protected:
         bool solid; /* Indicates if the figure has solid color. */
 		GLenum	mode;	/* Indicates the mode to use to print. */
@@ -75,6 +90,7 @@ class GEngine::Geometry::Figure {
 	
         Figure();
 		Figure(const Figure& fig);
+        virtual ~Figure();
 
         /* Virtual functions needed to be overriden. */
         virtual FaceList * print() = 0; 
@@ -89,6 +105,10 @@ class GEngine::Geometry::Figure {
 		/* Returns the mode to be used to print the figure. */
 		GLenum getMode();
 
+        /* Returns the material of the figure, or NULL, and whether it is solid. */
+        Material * getMaterial() const;
+        bool isSolid() const;
+
 		/* Sets the material, through a material pointer, a file, a pixelmap or even a RGB component. */
         void setMaterial(Material * mat);
         void setMaterialFromFile(const char * file);
@@ -96,8 +116,27 @@ class GEngine::Geometry::Figure {
         void setMaterialFromRGB(GLubyte red, GLubyte green, GLubyte blue);
 
         /* Activates/deactivates the material for the figure. */
-        void activeMaterial();
-        void deactivateMaterial();
+        void activeMaterial(Renderer * rend);
+        void deactivateMaterial(Renderer * rend);
+
+        /* Gets the matrix rotating the figure, returns false if it is the identity. */
+        bool getMatrix(GLfloat matrix[16]) const;
+
+        /* Calculates the bounds of the faces, in the coordinates of the renderers. It has
+         * to be called each time the figure moves; the faces are only printed the first
+         * time and after reshape(), and then kept to be recorded. */
+        void updateBounds();
+
+        /* Marks the faces as changed, so they are printed and bounded again. motion() has
+         * to call it when it changes what print() gives; rotating the figure does not. */
+        void reshape();
+
+        /* Gets the box and the sphere bounding the figure, NULL until updateBounds(). */
+        const GLfloat * getBounds() const;
+        const GLfloat * getSphere() const;
+
+        /* Prints the faces of the figure through a renderer. */
+        void record(Renderer * rend);
 
 		/* Copy the figure. */
 		Figure& operator = (const Figure& fig);
@@ -107,8 +146,26 @@ class GEngine::Geometry::Figure {
  * Class for static figures, with no motion.
  */
 class GEngine::Geometry::StaticFigure : public GEngine::Geometry::Figure {
+    protected:
+        GeometryBuffer  * geometry; /* The faces of the figure, built once. */
+        bool    edited;     /* Whether the geometry must be built again. */
+        StaticBatch     * batch;    /* The batch joining the figure, or NULL. */
     public:
+        StaticFigure();
+        StaticFigure(const StaticFigure& fig);
+        ~StaticFigure();
+
         virtual void motion(double time);
+
+        /* Gets the geometry of the figure, building it the first time or after edit(). */
+        GeometryBuffer * getGeometry();
+
+        /* Marks the figure as edited, so its geometry is built and uploaded again, and
+         * the batch joining it too, if its scene is finalized. */
+        void edit();
+
+        /* Sets the batch joining the figure, NULL when it is not joined. */
+        void setBatch(StaticBatch * batch);
 };
 
 /**
@@ -122,9 +179,6 @@ class GEngine::Geometry::Face {
         /* Creates a new face using the list of points an the normal vector. */
         Face(PointList * list, Vector<3> * normal);
         ~Face();
-
-        /* Applies the transformations to the face. */
-        Face * transform(GLint center[3], GLfloat angles[3]);
 };
 
 /**
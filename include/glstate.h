@@ -0,0 +1,100 @@
+/**
+ * Definition of the cache of the state of OpenGL. It keeps the last values set through it
+ * and drops the calls which would set a value that is already current, since the calls
+ * to the driver cost more than the vertices in the scenes with many materials. The
+ * capabilities of the context are queried once, when it is initialized.
+ *
+ * All the changes of the cached state must go through this class, or the cache must be
+ * invalidated after them. The backends without OpenGL build with NO_GL, which removes
+ * the calls and only keeps the state.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _GLSTATE_H_
+#define _GLSTATE_H_
+
+#include <GL/gl.h>
+
+/* The lights cached, OpenGL supports at least 8. */
+#define GLSTATE_LIGHTS      8
+
+/* The capabilities cached by glEnable/glDisable. */
+#define GLSTATE_CAPS        16
+
+/* A call to OpenGL, removed from the builds without it. */
+#ifdef NO_GL
+#define GL_CALL(call)
+#else
+#define GL_CALL(call)       call
+#endif
+
+namespace GEngine {
+    class GLState;
+};
+
+/**
+ * The cache of the state of the current context, a static class.
+ */
+class GEngine::GLState {
+    private:
+        static GLint    maxLights;      /* The lights supported by the context. */
+        static bool     instancing;     /* Whether it draws instances with shaders. */
+        static bool     persistent;     /* Whether buffers can stay mapped while drawn. */
+        static GLenum   polyMode[2];    /* The polygon mode of the front and back faces. */
+        static GLenum   matMode;        /* The matrix stack selected. */
+        static GLfloat  matParams[6][4]; /* The material properties, see matIndex(). */
+        static GLfloat  lightParams[GLSTATE_LIGHTS][8][4]; /* The light params, see lightIndex(). */
+        static GLfloat  ambient[4];     /* The ambient light of the light model. */
+        static unsigned known;          /* The materials (bits 0-5) and ambient (6) set. */
+        static unsigned lightsKnown[GLSTATE_LIGHTS]; /* The params of each light set. */
+        static GLenum   caps[GLSTATE_CAPS];  /* The capabilities known. */
+        static bool     capsOn[GLSTATE_CAPS]; /* Whether each one is enabled. */
+        static unsigned numCaps;
+
+        /* Compares the cached value with a new one and stores it. */
+        static bool update(GLfloat * cached, const GLfloat * value, unsigned size);
+    public:
+        /* Queries the capabilities and forgets the state, for a new context. */
+        static void init();
+
+        /* Forgets the state, after it was changed without this class. */
+        static void invalidate();
+
+        /* Gets the number of lights supported, 8 before init(). */
+        static GLint getMaxLights();
+
+        /* Returns whether the context can draw instances (OpenGL 3.3), false before init(). */
+        static bool hasInstancing();
+
+        /* Returns whether the buffers can be mapped persistently, with glBufferStorage and
+         * the fences of OpenGL 4.4, false before init(). */
+        static bool hasPersistentMapping();
+
+        /* glPolygonMode, returns whether the call was issued. */
+        static bool polygonMode(GLenum face, GLenum mode);
+
+        /* glMatrixMode, returns whether the call was issued. */
+        static bool matrixMode(GLenum mode);
+
+        /* glMaterialfv for both faces, returns whether the call was issued. */
+        static bool material(GLenum pname, const GLfloat * params);
+
+        /* glLightfv, returns whether the call was issued. */
+        static bool light(GLenum light, GLenum pname, const GLfloat * params);
+
+        /* glLightModelfv(GL_LIGHT_MODEL_AMBIENT), returns whether the call was issued. */
+        static bool lightAmbient(const GLfloat * params);
+
+        /* glEnable/glDisable, returns whether the call was issued. */
+        static bool enable(GLenum cap);
+        static bool disable(GLenum cap);
+
+        /* glIsEnabled, answered by the cache when the capability is known. */
+        static bool isEnabled(GLenum cap);
+};
+
+#endif
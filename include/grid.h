@@ -0,0 +1,106 @@
+/**
+ * Definition of the loose grids, the cells splitting the box of a scene used to find the
+ * dynamic figures seen by a camera, near a point or inside a region. Each figure is kept
+ * in the cell containing the center of its box, and the cell is taken as if it were grown
+ * by half its side, so the figures no larger than a cell never leave it; the bigger ones
+ * are kept apart. The figures outside the box go to the cells of its border, which reach
+ * as far as needed. Moving a figure only relinks it when its center changes of cell.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _GRID_H_
+#define _GRID_H_
+
+#include <GL/gl.h>
+#include <vector>
+
+namespace GEngine {
+    class Grid;
+    class Frustum;
+};
+
+/* The cells of a grid, at most; the side of the cells grows to keep below it. */
+#define GRID_MAX_CELLS  (1 << 18)
+
+/* The coordinate standing for the infinite: the reach of the border cells and the box of
+ * the items without one. */
+#define GRID_FAR        1e30f
+
+/* The end of the lists of items. */
+#define GRID_NONE       (~0u)
+
+/**
+ * A grid of boxes which can be moved. The boxes are known by the handle given when they
+ * are inserted, which is kept until they are removed.
+ */
+class GEngine::Grid {
+    private:
+        GLfloat     origin[3];  /* The minimum x, y and z of the cells. */
+        GLfloat     side;       /* The side of the cells. */
+        unsigned    dims[3];    /* The cells along each axis. */
+
+        /* The first item of each cell, the last one holding the items too large. */
+        std::vector<unsigned>   heads;
+        std::vector<unsigned>   counts;     /* The items of each cell. */
+        std::vector<unsigned>   occupied;   /* The cells with items. */
+        std::vector<unsigned>   slots;      /* The position of each cell in occupied. */
+
+        /* The items: their boxes, their cell and their neighbours in it. */
+        std::vector<GLfloat>    boxes;
+        std::vector<unsigned>   cells, next, prev;
+        std::vector<unsigned>   freed;      /* The handles to be given again. */
+        unsigned    items;
+
+        /* Gets the cell of a box. */
+        unsigned cellOf(const GLfloat box[6]) const;
+
+        /* Gets the box of a cell, grown by half its side. */
+        void looseBox(unsigned cell, GLfloat box[6]) const;
+
+        /* Gets the cells along an axis whose grown box overlaps a range. */
+        void cellRange(unsigned axis, GLfloat min, GLfloat max, unsigned range[2]) const;
+
+        /* Puts an item into a cell, or takes it out. */
+        void link(unsigned item, unsigned cell);
+        void unlink(unsigned item);
+
+        /* Calls a function for each cell overlapping a region. */
+        template <typename F> void forCells(const GLfloat region[6], F func) const;
+    public:
+        /* Builds a grid of a single cell. */
+        Grid();
+
+        /* Splits a box into cells of a side, at least, keeping the items. */
+        void setLimits(const GLfloat limits[6], GLfloat cell);
+
+        /* Adds a box, NULL to be found everywhere, and gives its handle. */
+        unsigned insert(const GLfloat box[6]);
+
+        /* Changes the box of an item. */
+        void move(unsigned item, const GLfloat box[6]);
+
+        /* Removes an item, its handle can be given again. */
+        void remove(unsigned item);
+
+        /* Removes all the items. */
+        void clear();
+
+        /* Gets the items which can be seen through a frustum. */
+        void cull(const Frustum& frustum, std::vector<unsigned> * found) const;
+
+        /* Gets the items which overlap a region. */
+        void query(const GLfloat region[6], std::vector<unsigned> * found) const;
+
+        /* Gets the items closer to a point than a radius. */
+        void queryRadius(const GLfloat center[3], GLfloat radius,
+                std::vector<unsigned> * found) const;
+
+        /* Gets the number of items. */
+        unsigned size() const;
+};
+
+#endif
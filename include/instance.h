@@ -0,0 +1,72 @@
+/**
+ * Definition of the instances, the copies of a figure repeated over the scene. The faces
+ * are kept once in a mesh asset, and each instance only keeps where it is placed and its
+ * material, so all the instances of a mesh with the same material are drawn at once.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _INSTANCE_H_
+#define _INSTANCE_H_
+
+#include <GL/gl.h>
+#include "geometry.h"
+#include "buffer.h"
+
+namespace GEngine {
+    class MeshAsset;
+    class Instance;
+};
+
+/**
+ * The geometry shared by the instances, in the coordinates of the figure it was built from.
+ */
+class GEngine::MeshAsset {
+    private:
+        GeometryBuffer  geometry;
+        bool            solid;  /* Whether the prototype has solid color. */
+    public:
+        /* Builds the mesh from the faces of a figure placed at the origin, unrotated. */
+        MeshAsset(Geometry::Figure * prototype);
+
+        /* Gets the geometry of the mesh. */
+        GeometryBuffer * getGeometry();
+
+        /* Returns whether the instances without material are solid. */
+        bool isSolid() const;
+};
+
+/**
+ * A copy of a mesh placed in the scene.
+ */
+class GEngine::Instance {
+    private:
+        MeshAsset   * mesh;
+        Material    * material;
+        GLfloat     angle[3];   /* The angles of rotation (yaw, pitch, roll) in degrees. */
+    public:
+        GLfloat     org[3];     /* The position of the instance in the scene. */
+
+        Instance(MeshAsset * mesh, Material * mat = NULL);
+
+        /* Rotates the instance as Figure::rotate() does a figure: the yaw around z, the
+         * pitch around y and the roll around x, in degrees. */
+        void rotate(GLfloat yaw, GLfloat pitch, GLfloat roll);
+
+        /* Sets the material of the instance, NULL to draw it as its prototype. */
+        void setMaterial(Material * mat);
+
+        /* Gets the mesh and the material of the instance. */
+        MeshAsset * getMesh() const;
+        Material * getMaterial() const;
+
+        /* Gets the matrix placing the mesh in the scene, stored by columns. */
+        void getMatrix(GLfloat matrix[16]) const;
+};
+
+#define InstanceList    std::vector<GEngine::Instance *>
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * Definition of the pool of worker threads used to run the jobs of the engine in parallel.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GEngine {
+    class JobPool;
+    struct JobRange;
+};
+
+#define Job         std::function<void ()>
+#define JobQueue    std::deque<Job>
+#define JobHandle   std::shared_ptr<GEngine::JobRange>
+
+/**
+ * A pool of worker threads consuming a queue of jobs.
+ */
+class GEngine::JobPool {
+    private:
+        std::vector<std::thread>    workers;
+        JobQueue                    jobs;
+        std::mutex                  lock;
+        std::condition_variable     ready;  /* Signaled when there are new jobs. */
+        std::condition_variable     idle;   /* Signaled when all the jobs are done. */
+        unsigned                    pending; /* Jobs queued or running. */
+        bool                        stopping;
+
+        static JobPool * shared;
+
+        /* The loop of each worker. */
+        void work(unsigned idx);
+    public:
+        /* Creates the pool, by default with one worker less than the hardware threads. */
+        JobPool(unsigned threads = 0);
+        ~JobPool();
+
+        /* Queues a job to be run by any worker. */
+        void submit(Job job);
+
+        /* Waits until all the queued jobs are done. */
+        void wait();
+
+        /* Runs body(idx) for idx in [0, count), the calling thread takes part too, but
+         * runs no other job while it waits. */
+        void parallelFor(unsigned count, std::function<void (unsigned)> body);
+
+        /* As parallelFor(), but returning at once: the workers start on the range, and
+         * join() runs the indices left and waits for the rest. */
+        JobHandle start(unsigned count, std::function<void (unsigned)> body);
+        void join(JobHandle range);
+
+        /* Gets the number of workers. */
+        unsigned size() const;
+
+        /* Gets the pool shared by the engine. */
+        static JobPool * instance();
+};
+
+#endif
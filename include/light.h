@@ -20,6 +20,8 @@ namespace GEngine {
  */
 class GEngine::Light {
     friend class Scene;
+    friend class GL3Renderer;
+    friend class SceneFile;
     private:
         void setDefaults();
     protected:
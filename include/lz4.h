@@ -0,0 +1,39 @@
+/**
+ * Definition of the compression of blocks of data with LZ4, as its block format describes
+ * them: sequences of literals followed by a match of at least four bytes, copied from up
+ * to 64 KiB back. Decoding is little more than copying, faster than reading the data from
+ * a disk, so the assets are kept compressed and decoded as they are read.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _LZ4_H_
+#define _LZ4_H_
+
+#include <stddef.h>
+
+/* The shortest match, and the farthest one back. */
+#define LZ4_MIN_MATCH   4
+#define LZ4_MAX_OFFSET  65535
+
+/* The bytes at the end of a block which are always literals, and the bytes before the end
+ * where the last match can start. */
+#define LZ4_LAST_LITERALS   5
+#define LZ4_MF_LIMIT        12
+
+/* The bits of the table of the compressor, finding the previous place of four bytes. */
+#define LZ4_HASH_BITS   12
+
+/* Gets the largest size of a block of some bytes once compressed. */
+size_t lz4Bound(size_t size);
+
+/* Compresses a block, giving its compressed size, or 0 if it does not fit. */
+size_t lz4Compress(const void * source, size_t size, void * dest, size_t capacity);
+
+/* Decompresses a block, giving its size, or -1 if it is malformed or does not fit. */
+long lz4Decompress(const void * source, size_t size, void * dest, size_t capacity);
+
+#endif
@@ -11,6 +11,7 @@
 #define _MATERIAL_H_
 
 #include <GL/gl.h>
+#include <atomic>
 #include <map>
 
 namespace GEngine {
@@ -34,11 +35,16 @@ struct GEngine::Pixmap {
 class GEngine::Material {
     private:
         static MaterialMap * matDefs;
+        static std::atomic<unsigned> nextId;   /* Taken by the loaders too. */
     protected:
         MaterialMap material;
+        unsigned    id;     /* The identifier used to sort the draws by material. */
     public:
         Material();
 
+        /* Gets the identifier of the material, starting at 1. */
+        unsigned getId() const;
+
 		/* Activates/Deactivates this texture for 
 		 * printing. */
 		void activate();
@@ -46,6 +52,9 @@ class GEngine::Material {
 
 		/* Sets a property for the texture/material. */
         void setMatProperty(GLenum prop, float * values);
+
+        /* Gets a property of the material, NULL if it is not a material property. */
+        const GLfloat * getMatProperty(GLenum prop) const;
 };
 
 /**
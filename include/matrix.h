@@ -106,4 +106,28 @@ class Matrix {
 #endif
 };
 
+/**
+ * Operations over 4x4 matrices stored by columns, the layout used by OpenGL. They are plain
+ * arrays so they can be given straight to glLoadMatrixd and friends.
+ */
+
+/* Sets the identity matrix. */
+void mat4Identity(double out[16]);
+
+/* Multiplies two matrices (out = a * b), out can be any of them. */
+void mat4Multiply(const double a[16], const double b[16], double out[16]);
+
+/* Multiplies a matrix by a homogeneous vector (out = m * in). */
+void mat4Transform(const double m[16], const double in[4], double out[4]);
+
+/* Builds the same matrices as glTranslated, glRotated (degrees) and glFrustum. */
+void mat4Translation(double x, double y, double z, double out[16]);
+void mat4Rotation(double angle, double x, double y, double z, double out[16]);
+void mat4Frustum(double left, double right, double bottom, double top,
+        double near, double far, double out[16]);
+
+/* Builds the rotation of the figures for a yaw, pitch and roll in degrees, in the
+ * coordinates of the renderers. */
+void mat4Orientation(double yaw, double pitch, double roll, double out[16]);
+
 #endif
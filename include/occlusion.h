@@ -0,0 +1,92 @@
+/**
+ * Definition of the occlusion culling, which discards the figures hidden behind the big
+ * ones, the occluders, before they are drawn. The occluders are rasterized into a small
+ * depth buffer in memory, keeping only the pixels they cover entirely and the farthest
+ * depth of each one, so nothing is hidden by mistake. Then, a chain of levels, each one
+ * with the farthest depth of four pixels of the one before, lets a box be tested against
+ * a few pixels whatever its size. The bands of rows of the buffer are rasterized by the
+ * workers while the calling thread goes on, and the chain is built when it waits for
+ * them; nothing is asked to the GPU.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _OCCLUSION_H_
+#define _OCCLUSION_H_
+
+#include <GL/gl.h>
+#include <vector>
+
+#include "jobs.h"
+
+/* The size of the depth buffer, multiples of 4 and powers of 2. */
+#define OCCLUSION_WIDTH     256
+#define OCCLUSION_HEIGHT    128
+
+/* The levels of the chain, down to a single pixel. */
+#define OCCLUSION_LEVELS    9
+
+/* The groups of rows rasterized by each job. */
+#define OCCLUSION_BANDS     8
+
+namespace GEngine {
+    class Occlusion;
+    class Camera;
+    class GeometryBuffer;
+    struct OccluderTri;
+};
+
+/**
+ * A triangle of an occluder projected to the depth buffer, ready to be rasterized.
+ */
+struct GEngine::OccluderTri {
+    float   A[3], B[3], C[3];   /* The edges, A * x + B * y + C, positive inside. */
+    float   zA, zB, zC;         /* The depth, zA * x + zB * y + zC. */
+    int     minx, maxx, miny, maxy; /* The pixels it can cover. */
+};
+
+#define OccluderTriList     std::vector<GEngine::OccluderTri>
+
+/**
+ * The depth buffer of the occluders seen by a camera.
+ */
+class GEngine::Occlusion {
+    private:
+        double      clip[16];       /* The projection times the modelview. */
+        OccluderTriList         tris;   /* The triangles of the frame. */
+        std::vector<float>      levels[OCCLUSION_LEVELS]; /* The depth, then the chain. */
+        bool        active;         /* Whether there are occluders in the frame. */
+        JobHandle   raster;         /* The bands being rasterized, until wait(). */
+
+        /* Projects a triangle in clip coordinates, already clipped by the near plane. */
+        void addTriangle(const double * a, const double * b, const double * c);
+
+        /* Rasterizes the triangles on some rows of the depth buffer. */
+        void rasterBand(unsigned band);
+        void drawTriangle(const OccluderTri& tri, int y0, int y1);
+    public:
+        Occlusion();
+        ~Occlusion();
+
+        /* Starts a frame seen by a camera, with no occluders. */
+        void begin(const Camera * cam);
+
+        /* Adds the faces of a geometry as an occluder. */
+        void addOccluder(const GeometryBuffer * geometry);
+
+        /* Starts rasterizing the occluders in the workers, returning at once. */
+        void end();
+
+        /* Waits for the occluders to be rasterized and builds the chain. It must be
+         * called after end() and before testing any box. */
+        void wait();
+
+        /* Returns whether a box, the minimum and maximum x, y and z, can be seen, that is,
+         * whether it is not behind the occluders. */
+        bool isBoxVisible(const GLfloat box[6]) const;
+};
+
+#endif
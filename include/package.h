@@ -0,0 +1,174 @@
+/**
+ * Definition of the packages, files keeping many assets, such as meshes, textures and
+ * scenes, each one compressed with LZ4. The start of the file is a table of its entries
+ * and of their blocks: every entry is split into blocks of PACKAGE_BLOCK bytes compressed
+ * on their own, so they are decompressed at once by the workers, each one straight into
+ * its place in the buffer of the entry, as soon as its bytes are read. The blocks which
+ * do not get smaller are kept as they are and read straight into the buffer.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _PACKAGE_H_
+#define _PACKAGE_H_
+
+#include <GL/gl.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "material.h"
+#include "reader.h"
+
+namespace GEngine {
+    class Package;
+    class PackageWriter;
+    struct PackageHeader;
+    struct PackageEntry;
+    struct PackageBlock;
+    struct PackageItem;
+};
+
+/* The first four bytes of a package, and the version of the format. */
+#define PACKAGE_MAGIC       0x474B5047u     /* "GPKG" */
+#define PACKAGE_VERSION     1
+
+/* The bytes of the blocks of the entries, all of them but the last one of each entry. */
+#define PACKAGE_BLOCK       (64 << 10)
+
+/* The flag of the size of a block kept without compression. */
+#define PACKAGE_STORED      0x80000000u
+
+/* The function called when an entry is loaded, with whether it was. */
+#define PackageCallback     std::function<void (bool)>
+
+/* What an entry keeps, which tells what its info is. */
+enum {
+    PACKAGE_RAW,            /* Any bytes. */
+    PACKAGE_PIXMAP,         /* The pixels of a pixmap, three bytes each; its width and
+                             * height. */
+    PACKAGE_VERTICES,       /* BufferVertex records; their number. */
+    PACKAGE_INDICES,        /* GLuint indices; their number. */
+    PACKAGE_SCENE           /* A scene file. */
+};
+
+/**
+ * The start of the file, followed by the entries, the blocks, the names and the data.
+ */
+struct GEngine::PackageHeader {
+    GLuint      magic;
+    GLuint      version;
+    GLuint      entries;
+    GLuint      blocks;
+    unsigned long long  names;      /* The offset of the names. */
+    unsigned long long  namesSize;  /* Their size, each one ends with a '\0'. */
+};
+
+/**
+ * An entry, one asset.
+ */
+struct GEngine::PackageEntry {
+    unsigned long long  size;       /* Its size, uncompressed. */
+    GLuint      type;               /* A PACKAGE_* value. */
+    GLuint      info[2];            /* What describes it, depending on its type. */
+    GLuint      name;               /* The offset of its name in the names. */
+    GLuint      firstBlock;
+    GLuint      blockCount;
+};
+
+/**
+ * A block of an entry.
+ */
+struct GEngine::PackageBlock {
+    unsigned long long  offset;     /* From the start of the file. */
+    GLuint      size;               /* Its size in the file, with PACKAGE_STORED if it is
+                                     * not compressed. */
+    GLuint      raw;                /* Its size uncompressed. */
+};
+
+/**
+ * An entry to be written by a writer.
+ */
+struct GEngine::PackageItem {
+    std::string name;
+    GLuint      type;
+    GLuint      info[2];
+    const unsigned char * data;     /* The bytes of the caller, NULL for the ones below. */
+    size_t      size;
+    std::vector<unsigned char>  copy;
+};
+
+/**
+ * A package open for reading. Only its tables are kept in memory; the entries are read
+ * when asked for, and several of them can be read at once from any thread.
+ */
+class GEngine::Package {
+    private:
+        int         fd;             /* The file, -1 if none is open. */
+        unsigned long long  fileSize;
+        std::vector<PackageEntry>   entries;
+        std::vector<PackageBlock>   blocks;
+        std::vector<char>           names;
+        std::map<std::string, unsigned> index; /* The entry of each name. */
+
+        /* Returns whether the tables describe entries whose blocks are all in the file. */
+        bool check() const;
+    public:
+        Package();
+        ~Package();
+
+        /* Opens a package, reading its tables. */
+        bool open(const char * path);
+
+        /* Closes the file; there must be no load going on. */
+        void close();
+
+        /* Finds an entry by its name, giving -1 if there is none. */
+        int find(const char * name) const;
+
+        /* Gets the number of entries, and their description and name. */
+        unsigned getEntries() const;
+        const PackageEntry& getEntry(unsigned entry) const;
+        const char * getName(unsigned entry) const;
+
+        /* Reads an entry into a buffer of its size, decompressing its blocks in the
+         * calling thread and the workers. It can be called from a job. */
+        bool read(unsigned entry, void * dest) const;
+
+        /* Loads an entry into a buffer of its size without blocking: the blocks are read
+         * through a reader, the shared one by default, and decompressed by the jobs
+         * called when each one arrives. done is called in the pool at the end; the
+         * buffer and the package must be kept until then. */
+        void load(unsigned entry, void * dest, PackageCallback done,
+                FileReader * reader = NULL) const;
+
+        /* Reads a pixmap entry, allocating its data with malloc. */
+        bool readPixmap(unsigned entry, Pixmap * pixmap) const;
+};
+
+/**
+ * The writer of a package, which takes the entries and writes them at once.
+ */
+class GEngine::PackageWriter {
+    private:
+        std::vector<PackageItem>    items;
+    public:
+        /* Adds an entry, whose bytes are kept by the caller until write(). */
+        void add(const char * name, const void * data, size_t size,
+                GLuint type = PACKAGE_RAW, GLuint info0 = 0, GLuint info1 = 0);
+
+        /* Adds an entry with the pixels of a pixmap, kept by the caller until write(). */
+        void addPixmap(const char * name, const Pixmap * pixmap);
+
+        /* Adds an entry with the bytes of a file, read now. */
+        bool addFile(const char * name, const char * path, GLuint type = PACKAGE_RAW);
+
+        /* Writes the package, compressing the blocks of all the entries in the workers. */
+        bool write(const char * path) const;
+};
+
+#endif
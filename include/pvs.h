@@ -0,0 +1,90 @@
+/**
+ * Definition of the potentially visible sets, what can be seen from each cell of a scene:
+ * its static batches and the scenes around it. They are baked once, offline, casting
+ * rays from points of each cell to points of each target and stopping them with the
+ * faces of the occluders; a target is seen if any ray reaches it. The sets are kept as a
+ * row of bits for each cell, so the culling is just testing a bit.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _PVS_H_
+#define _PVS_H_
+
+#include <GL/gl.h>
+#include <vector>
+
+namespace GEngine {
+    class PVS;
+};
+
+/* The cells of a set, at most; the side of the cells grows to keep below it. */
+#define PVS_MAX_CELLS   4096
+
+/* The points of each cell the rays are cast from, 2 along each axis. */
+#define PVS_CELL_SAMPLES    8
+
+/* The fraction of the rays near their ends where the faces do not stop them. */
+#define PVS_EPSILON     1e-4f
+
+/* The first four bytes of a file of sets. */
+#define PVS_MAGIC       0x53565047u     /* "GPVS" */
+
+#define PVSBits         std::vector<unsigned long long>
+
+/**
+ * The sets of a box split into cells, each one with a bit for each target.
+ */
+class GEngine::PVS {
+    private:
+        GLfloat     origin[3];  /* The minimum x, y and z of the cells. */
+        GLfloat     side;       /* The side of the cells. */
+        unsigned    dims[3];    /* The cells along each axis. */
+        unsigned    targets;    /* The targets of each set. */
+        unsigned    words;      /* The words of each set. */
+        PVSBits     bits;       /* The sets, one after another. */
+    public:
+        /* Builds a set of a single cell, empty until it is baked. */
+        PVS();
+
+        /* Splits a box into cells of a side, at least, forgetting the sets. */
+        void setCells(const GLfloat limits[6], GLfloat cell);
+
+        /* Bakes the sets. The occluders are triangles of 9 coordinates; the points of
+         * the target t are points[firsts[t] * 3] to points[firsts[t + 1] * 3]. */
+        void bake(const std::vector<GLfloat>& triangles, const std::vector<GLfloat>& points,
+                const std::vector<unsigned>& firsts);
+
+        /* Forgets the sets, so everything is seen. */
+        void clear();
+
+        /* Returns whether the sets are baked. */
+        bool isBaked() const;
+
+        /* Gets the cell containing a point, or -1 if it is out of the box. */
+        int getCell(const GLfloat pos[3]) const;
+
+        /* Returns whether a target can be seen from a cell. */
+        bool isVisible(unsigned cell, unsigned target) const;
+
+        /* Gets the number of targets. */
+        unsigned getTargets() const;
+
+        /* Gets the cells along each axis. */
+        void getDims(unsigned cells[3]) const;
+
+        /* Gets the sets, the words of each cell one after another, or copies them from
+         * sets baked for the same cells. */
+        const PVSBits& getSets() const;
+        bool setSets(const unsigned cells[3], unsigned count, const unsigned long long * sets);
+
+        /* Writes the sets into a file or reads them from it, as baked for the same box
+         * and targets. */
+        bool save(const char * path) const;
+        bool load(const char * path);
+};
+
+#endif
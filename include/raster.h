@@ -0,0 +1,106 @@
+/**
+ * Definition of the software rasterizer, a renderer drawing into a framebuffer in memory
+ * without any GPU. The primitives are binned into tiles of the screen while they are
+ * submitted, and the tiles are rasterized in parallel at the end of the frame, using
+ * SIMD edge functions and a depth buffer. The output does not depend on the number of
+ * threads, so the images are deterministic.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _RASTER_H_
+#define _RASTER_H_
+
+#include <vector>
+#include "renderer.h"
+
+/* The size in pixels of the side of a tile, it must be a multiple of 4. */
+#define RASTER_TILE_SIZE    64
+
+namespace GEngine {
+    class Rasterizer;
+    struct RasterPrim;
+    struct ClipVertex;
+};
+
+/**
+ * A primitive already projected to the screen: x and y in pixels and the depth in [0, 1].
+ */
+struct GEngine::RasterPrim {
+    enum { POINT, LINE, TRIANGLE } type;
+    float       v[3][3];    /* The vertices used by the primitive. */
+    unsigned    color;      /* The RGBA color packed as it is stored in memory. */
+};
+
+/**
+ * A vertex in clip coordinates.
+ */
+struct GEngine::ClipVertex {
+    double x, y, z, w;
+};
+
+#define RasterPrimList  std::vector<GEngine::RasterPrim>
+#define ClipVertexList  std::vector<GEngine::ClipVertex>
+#define RasterBin       std::vector<unsigned>
+
+/**
+ * The software renderer.
+ */
+class GEngine::Rasterizer : public GEngine::Renderer {
+    private:
+        unsigned    width, height;  /* The size of the framebuffer. */
+        unsigned    stride;         /* The pixels of a row, a multiple of 4. */
+        unsigned    tilesX, tilesY; /* The number of tiles of the framebuffer. */
+        std::vector<unsigned>   colorBuf;   /* The color buffer, from the bottom row. */
+        std::vector<float>      depthBuf;   /* The depth buffer. */
+        RasterPrimList          prims;      /* The primitives of the frame. */
+        std::vector<RasterBin>  bins;       /* The primitives touching each tile. */
+
+        double      mvp[16];        /* The projection times the modelview. */
+        std::vector<double>     mvpStack;   /* The matrices saved by pushMatrix(). */
+        GLenum      polyMode[2];    /* The polygon mode for the front and back faces. */
+        unsigned    clearColor, fgColor, color;
+        GLenum      primMode;       /* The mode of the primitive being submitted. */
+        ClipVertexList  verts;      /* The vertices of the primitive being submitted. */
+
+        void resize(unsigned w, unsigned h);
+
+        /* Assembles, clips and projects the primitives. */
+        void project(const ClipVertex& in, float out[3]);
+        void emitPoint(const ClipVertex& p);
+        void emitLine(const ClipVertex& a, const ClipVertex& b);
+        void emitPolygon(const ClipVertex * poly, unsigned count);
+
+        /* Adds a primitive to the bins of the tiles it touches. */
+        void bin(const RasterPrim& prim);
+
+        /* Rasterizes all the primitives of a tile. */
+        void rasterTile(unsigned tile);
+        void drawTriangle(const RasterPrim& prim, int x0, int y0, int x1, int y1);
+        void drawLine(const RasterPrim& prim, int x0, int y0, int x1, int y1);
+        void drawPoint(const RasterPrim& prim, int x0, int y0, int x1, int y1);
+    public:
+        Rasterizer(unsigned width, unsigned height);
+
+        void beginFrame(const GLuint position[2], const GLuint screen[3],
+                const GLfloat bgcolor[3], const GLfloat fgcolor[3]);
+        void endFrame();
+        void activateCamera(Camera * cam);
+        void deactivateCamera(Camera * cam);
+        void setAmbient(const GLfloat ambient[4]);
+        void setLight(Light * light);
+        void setPolygonMode(GLenum face, GLenum mode);
+        void setMaterial(Material * mat);
+        void unsetMaterial(Material * mat);
+        void pushMatrix(const GLfloat matrix[16]);
+        void popMatrix();
+        void begin(GLenum mode);
+        void vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s = 0, GLdouble t = 0);
+        void end();
+        bool readPixels(GLuint width, GLuint height, unsigned char * pixels);
+};
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * Definition of the file reader, which reads files without blocking the threads asking for
+ * them. The reads are queued and sent to the kernel in batches through an io_uring ring,
+ * set up with the system calls themselves, and once each one is done a function is called
+ * in the pool of jobs. The buffers read again and again can be registered, so the kernel
+ * maps them only once. Where the ring cannot be created, the reads are done with pread by
+ * a few threads of the reader, and their functions are called in the same way.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _READER_H_
+#define _READER_H_
+
+#include <sys/types.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "jobs.h"
+
+namespace GEngine {
+    class FileReader;
+    struct FileRead;
+};
+
+/* The reads sent to the kernel at once, at most; the ones beyond wait in the reader. */
+#define READER_DEPTH    256
+
+/* The threads reading when there is no ring. */
+#define READER_THREADS  4
+
+/* The function called when a read is done, with the bytes read or -errno. */
+#define ReadCallback    std::function<void (long)>
+
+/**
+ * A read of a range of a file into a buffer.
+ */
+struct GEngine::FileRead {
+    int             fd;
+    unsigned char   * buffer;
+    size_t          length;
+    off_t           offset;
+    size_t          done;       /* The bytes read so far. */
+    int             registered; /* The registered buffer containing it, or -1. */
+    ReadCallback    callback;
+};
+
+#define FileReadQueue   std::deque<GEngine::FileRead *>
+
+/**
+ * The reads of files of the engine.
+ */
+class GEngine::FileReader {
+    private:
+        JobPool     * pool;         /* The pool calling the functions of the reads. */
+        std::mutex  lock;
+        std::condition_variable     finished; /* Signaled when all the reads are done. */
+        FileReadQueue   queued;     /* The reads not submitted yet. */
+        FileReadQueue   waiting;    /* The reads submitted, waiting for room in the ring. */
+        unsigned    outstanding;    /* The reads whose function has not returned yet. */
+
+        /* The ring, or -1 without it, and its queues mapped from the kernel. */
+        int         ring;
+        unsigned    depth;          /* The entries of the submission queue. */
+        unsigned    inFlight;       /* The reads sent to the kernel and not reaped. */
+        unsigned    unsent;         /* The entries queued but not taken by the kernel. */
+        unsigned    registered;     /* The buffers registered with the kernel. */
+        void        * sqMap, * cqMap, * sqes;
+        size_t      sqSize, cqSize, sqesSize;
+        unsigned    * sqHead, * sqTail, * sqMask, * sqArray;
+        unsigned    * cqHead, * cqTail, * cqMask;
+        void        * cqes;
+        std::thread reaper;         /* The thread taking the reads done from the ring. */
+
+        /* The threads reading without the ring. */
+        JobPool     * threads;
+
+        static FileReader * shared;
+
+        /* Creates or destroys the ring. */
+        bool openRing();
+        void closeRing();
+
+        /* Sends the reads waiting to the ring while there is room, with the lock held. */
+        void push();
+
+        /* The loop of the thread taking the reads done. */
+        void reap();
+
+        /* Reads a whole range with pread, in a thread of the reader. */
+        void readRange(FileRead * req);
+
+        /* Queues the function of a read done into the pool. */
+        void complete(FileRead * req, long result);
+    public:
+        /* Creates the reader, calling the functions in a pool, the shared one by default.
+         * Without ring, or if it cannot be created, the reads are done by threads. */
+        FileReader(JobPool * pool = NULL, bool ring = true);
+
+        /* Waits for all the reads and stops the reader. */
+        ~FileReader();
+
+        /* Registers buffers with the kernel, replacing the ones registered before; there
+         * must be no read into them meanwhile. A read into buffers[idx] then gives idx. */
+        bool registerBuffers(void * const * buffers, const size_t * sizes, unsigned count);
+
+        /* Queues a read of a range of a file into a buffer, which is not sent until
+         * submit(). The function is called in the pool once it is done. */
+        void read(int fd, void * buffer, size_t length, off_t offset, ReadCallback done,
+                int fixed = -1);
+
+        /* Sends the reads queued at once, giving how many were sent. */
+        unsigned submit();
+
+        /* Waits until the functions of all the reads submitted returned. It must not be
+         * called from them. */
+        void wait();
+
+        /* Returns whether the reads go through the ring. */
+        bool isRing() const;
+
+        /* Gets the reader shared by the engine. */
+        static FileReader * instance();
+};
+
+#endif
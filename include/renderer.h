@@ -0,0 +1,231 @@
+/**
+ * Definition of the renderers, the backends that receive the primitives and the states
+ * of the scene and turn them into pixels. The scene does not know which one is in use.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _RENDERER_H_
+#define _RENDERER_H_
+
+#include <GL/gl.h>
+#include "stats.h"
+#include "buffer.h"
+#include "stream.h"
+
+namespace GEngine {
+    class Renderer;
+    class GLRenderer;
+    class GL3Renderer;
+    class NullRenderer;
+    class Camera;
+    class Light;
+    class Material;
+};
+
+/**
+ * The interface of the renderers. The primitives follow the immediate mode of OpenGL:
+ * begin(), a list of vertices and end().
+ */
+class GEngine::Renderer {
+    public:
+        virtual ~Renderer();
+
+        /* Starts a frame, clearing the viewport, and finishes it. */
+        virtual void beginFrame(const GLuint position[2], const GLuint screen[3],
+                const GLfloat bgcolor[3], const GLfloat fgcolor[3]) = 0;
+        virtual void endFrame() = 0;
+
+        /* Sets/Unsets the view and the projection of a camera. */
+        virtual void activateCamera(Camera * cam) = 0;
+        virtual void deactivateCamera(Camera * cam) = 0;
+
+        /* Sets the ambient light and a source of light. */
+        virtual void setAmbient(const GLfloat ambient[4]) = 0;
+        virtual void setLight(Light * light) = 0;
+
+        /* Sets the polygon mode as glPolygonMode. */
+        virtual void setPolygonMode(GLenum face, GLenum mode) = 0;
+
+        /* Activates/Deactivates a material. */
+        virtual void setMaterial(Material * mat) = 0;
+        virtual void unsetMaterial(Material * mat) = 0;
+
+        /* Multiplies a matrix (16 floats by columns) into the modelview for the next
+         * primitives, and restores the previous modelview. */
+        virtual void pushMatrix(const GLfloat matrix[16]) = 0;
+        virtual void popMatrix() = 0;
+
+        /* Draws a primitive. */
+        virtual void begin(GLenum mode) = 0;
+        virtual void vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s = 0, GLdouble t = 0) = 0;
+        virtual void end() = 0;
+
+        /* Draws the geometry of a static figure, by default as begin(), vertex(), end(). */
+        virtual void drawStatic(GeometryBuffer * geometry);
+
+        /* Draws the geometry once for each matrix, by default transforming the vertices
+         * on the CPU and drawing them as begin(), vertex(), end(). */
+        virtual void drawInstanced(GeometryBuffer * geometry, const GLfloat * matrices,
+                unsigned count);
+
+        /* Copies the last frame as RGBA rows from the bottom to the top. */
+        virtual bool readPixels(GLuint width, GLuint height, unsigned char * pixels) = 0;
+};
+
+/* The vertices of each region of the stream buffers of the renderers. */
+#define STREAM_VERTICES     65536
+
+/**
+ * The renderer using the fixed function pipeline of OpenGL. It needs a current context.
+ * The vertices of begin()/end() are written into a stream buffer, and the primitives of
+ * the same kind are drawn together with glMultiDrawArrays when the state changes.
+ */
+class GEngine::GLRenderer : public GEngine::Renderer {
+    private:
+        GLuint  program;    /* The program drawing the instances, 0 until it is built. */
+        GLuint  instanceVbo; /* The matrices of the instances being drawn. */
+        GLint   lightingLoc, lightsLoc; /* The uniforms with the lights enabled. */
+        bool    programTried;   /* Whether the program was built, even if it failed. */
+
+        /* The primitives written and not drawn yet, all of the same kind. */
+        StreamBuffer    * stream;   /* NULL until the first primitive. */
+        GLenum          batchMode;
+        unsigned        primFirst;  /* The first vertex of the current primitive. */
+        std::vector<GLint>      firsts;
+        std::vector<GLsizei>    counts;
+
+        /* Builds the program drawing the instances. */
+        bool buildProgram();
+
+        /* Draws the primitives written. */
+        void flush();
+    public:
+        GLRenderer();
+        ~GLRenderer();
+
+        void beginFrame(const GLuint position[2], const GLuint screen[3],
+                const GLfloat bgcolor[3], const GLfloat fgcolor[3]);
+        void endFrame();
+        void activateCamera(Camera * cam);
+        void deactivateCamera(Camera * cam);
+        void setAmbient(const GLfloat ambient[4]);
+        void setLight(Light * light);
+        void setPolygonMode(GLenum face, GLenum mode);
+        void setMaterial(Material * mat);
+        void unsetMaterial(Material * mat);
+        void pushMatrix(const GLfloat matrix[16]);
+        void popMatrix();
+        void begin(GLenum mode);
+        void vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s = 0, GLdouble t = 0);
+        void end();
+        void drawStatic(GeometryBuffer * geometry);
+        void drawInstanced(GeometryBuffer * geometry, const GLfloat * matrices,
+                unsigned count);
+        bool readPixels(GLuint width, GLuint height, unsigned char * pixels);
+};
+
+/* The lights supported by the core profile renderer, kept in a uniform buffer. */
+#define GL3_MAX_LIGHTS      32
+
+/**
+ * The renderer using the core profile of OpenGL 3.3. The materials and the lights are kept
+ * in uniform buffers and lit per fragment by the shaders, as the fixed function pipeline
+ * does with the light model of the display. The vertices of begin()/end() are written
+ * into a stream buffer and drawn when the state changes. It needs a current context of
+ * OpenGL 3.3 or later, core or compatibility.
+ */
+class GEngine::GL3Renderer : public GEngine::Renderer {
+    private:
+        GLuint  program, vao;
+        StreamBuffer    * vertexStream, * indexStream; /* The primitives written. */
+        GLuint  instanceVbo;            /* The matrices of the instances being drawn. */
+        GLuint  lightUbo, materialUbo;
+        GLint   modelviewLoc, projectionLoc;
+
+        double  modelview[16], projection[16];
+        std::vector<double>     stack;  /* The modelviews saved by pushMatrix(). */
+        GLenum  polyMode;               /* The polygon mode of the front faces. */
+
+        /* The contents of the uniform buffers, in the std140 layout of the shaders. */
+        GLfloat lightBlock[2 + GL3_MAX_LIGHTS * 7][4];
+        GLfloat materialBlock[5][4];
+        bool    matricesDirty, lightsDirty, materialDirty;
+
+        /* The primitives written, split into points, lines and triangles. */
+        BufferIndexList     points, lines, triangles;
+        GLenum      primMode;
+        unsigned    primFirst;
+
+        /* Builds the program and the buffers, with the context current. */
+        bool init();
+
+        /* Uploads the matrices and the uniform buffers which changed. */
+        void applyState();
+
+        /* Draws the primitives written. */
+        void flush();
+    public:
+        GL3Renderer();
+        ~GL3Renderer();
+
+        void beginFrame(const GLuint position[2], const GLuint screen[3],
+                const GLfloat bgcolor[3], const GLfloat fgcolor[3]);
+        void endFrame();
+        void activateCamera(Camera * cam);
+        void deactivateCamera(Camera * cam);
+        void setAmbient(const GLfloat ambient[4]);
+        void setLight(Light * light);
+        void setPolygonMode(GLenum face, GLenum mode);
+        void setMaterial(Material * mat);
+        void unsetMaterial(Material * mat);
+        void pushMatrix(const GLfloat matrix[16]);
+        void popMatrix();
+        void begin(GLenum mode);
+        void vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s = 0, GLdouble t = 0);
+        void end();
+        void drawStatic(GeometryBuffer * geometry);
+        void drawInstanced(GeometryBuffer * geometry, const GLfloat * matrices,
+                unsigned count);
+        bool readPixels(GLuint width, GLuint height, unsigned char * pixels);
+};
+
+/**
+ * A renderer which draws nothing. It only counts what it receives, so the cost of the
+ * engine can be measured without the cost of the driver.
+ */
+class GEngine::NullRenderer : public GEngine::Renderer {
+    protected:
+        RenderStats total;  /* The counters of all the frames received. */
+        unsigned long long  frames; /* The number of frames received. */
+        double  checksum;   /* The sum of the coordinates received. */
+    public:
+        NullRenderer();
+
+        void beginFrame(const GLuint position[2], const GLuint screen[3],
+                const GLfloat bgcolor[3], const GLfloat fgcolor[3]);
+        void endFrame();
+        void activateCamera(Camera * cam);
+        void deactivateCamera(Camera * cam);
+        void setAmbient(const GLfloat ambient[4]);
+        void setLight(Light * light);
+        void setPolygonMode(GLenum face, GLenum mode);
+        void setMaterial(Material * mat);
+        void unsetMaterial(Material * mat);
+        void pushMatrix(const GLfloat matrix[16]);
+        void popMatrix();
+        void begin(GLenum mode);
+        void vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s = 0, GLdouble t = 0);
+        void end();
+        bool readPixels(GLuint width, GLuint height, unsigned char * pixels);
+
+        /* Gets the counters of all the frames received. */
+        const RenderStats& getTotal() const;
+        unsigned long long getFrames() const;
+        double getChecksum() const;
+};
+
+#endif
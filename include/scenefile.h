@@ -0,0 +1,192 @@
+/**
+ * Definition of the scene files, a binary format keeping a finalized scene as it is used
+ * in memory: its limits, ambient light, lights, camera, horizon, materials, the geometry
+ * of its batches of static figures and its potentially visible sets. The file is mapped
+ * and the scene uses it in place, so loading it is checking the header and creating a few
+ * objects: the vertices, indices and primitives of the batches are drawn and uploaded
+ * straight from the mapping. Everything is found by offsets from the start of the file,
+ * never by pointers, and each section starts at a multiple of SCENE_FILE_ALIGN bytes, so
+ * the file can be mapped anywhere and the vertices are aligned for the upload.
+ *
+ * The dynamic figures and the instances are not kept, as they are built by the program;
+ * neither are the static figures themselves, only their batches.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _SCENEFILE_H_
+#define _SCENEFILE_H_
+
+#include <GL/gl.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "world.h"
+
+namespace GEngine {
+    class Package;
+    class SceneFile;
+    class SceneFileLoader;
+    struct SceneFileSection;
+    struct SceneFileHeader;
+    struct SceneFileMaterial;
+    struct SceneFileLight;
+    struct SceneFileBatch;
+};
+
+/* The first four bytes of a scene file, and the version of the format. */
+#define SCENE_FILE_MAGIC    0x4E435347u     /* "GSCN" */
+#define SCENE_FILE_VERSION  1
+
+/* The boundary of the sections of the file. */
+#define SCENE_FILE_ALIGN    64
+
+/* The longest path of the files of a loader. */
+#define SCENE_FILE_PATH     1024
+
+/* The sections of the file, in the order they are written. */
+enum {
+    SCENE_FILE_MATERIALS,   /* SceneFileMaterial records. */
+    SCENE_FILE_LIGHTS,      /* SceneFileLight records. */
+    SCENE_FILE_BATCHES,     /* SceneFileBatch records. */
+    SCENE_FILE_VERTICES,    /* BufferVertex records of all the batches. */
+    SCENE_FILE_INDICES,     /* GLuint indices of all the batches. */
+    SCENE_FILE_DRAWS,       /* BufferDraw primitives of all the batches. */
+    SCENE_FILE_SETS,        /* The words of the potentially visible sets. */
+    SCENE_FILE_SECTIONS
+};
+
+/**
+ * Where a section is in the file.
+ */
+struct GEngine::SceneFileSection {
+    unsigned long long  offset;     /* From the start of the file. */
+    unsigned long long  count;      /* The number of records. */
+};
+
+/**
+ * The start of the file.
+ */
+struct GEngine::SceneFileHeader {
+    GLuint      magic;
+    GLuint      version;
+    unsigned long long  size;       /* The size of the whole file. */
+    long long   limits[6];          /* The minimum and maximum x, then y, then z. */
+    GLfloat     ambient[4];
+    GLint       horizon;            /* The material of the horizon, -1 for the black one. */
+    GLint       camera;             /* Whether the camera below is set. */
+    GLdouble    eye[3];             /* The position of the camera. */
+    GLdouble    angles[3];          /* The yaw, pitch and roll of the camera. */
+    GLuint      dims[3];            /* The cells of the sets along each axis. */
+    GLuint      targets;            /* The targets of the sets, 0 if they are not baked. */
+    SceneFileSection    sections[SCENE_FILE_SECTIONS];
+};
+
+/**
+ * A material, its properties.
+ */
+struct GEngine::SceneFileMaterial {
+    GLfloat     ambient[4];
+    GLfloat     diffuse[4];
+    GLfloat     specular[4];
+    GLfloat     emission[4];
+    GLfloat     shininess;
+};
+
+/**
+ * A light, as the class keeps it.
+ */
+struct GEngine::SceneFileLight {
+    GLfloat     ambient[4];
+    GLfloat     diffuse[4];
+    GLfloat     specular[4];
+    GLfloat     position[4];
+    GLfloat     spotDir[3];
+    GLfloat     spotExp;
+    GLfloat     spotAngle;
+    GLfloat     atten[3];
+};
+
+/**
+ * A batch of static figures. Its indices count from its first vertex and its primitives
+ * from its first index.
+ */
+struct GEngine::SceneFileBatch {
+    GLint       material;           /* The material of the figures, -1 without it. */
+    GLuint      state;              /* The polygon mode of the figures. */
+    GLuint      figures;            /* The figures joined. */
+    GLuint      firstVertex, vertexCount;
+    GLuint      firstIndex, indexCount;
+    GLuint      firstDraw, drawCount;
+    GLfloat     bounds[6];          /* The minimum and maximum x, y and z. */
+};
+
+/**
+ * A scene file mapped into memory, with the objects created from it.
+ */
+class GEngine::SceneFile {
+    private:
+        const unsigned char * data; /* The mapping, NULL if no file is open. */
+        size_t      size;
+        std::vector<Material *>     materials; /* The materials of the file. */
+        StaticCamera    camera;     /* The camera of the file, if it has one. */
+
+        /* Gets the header and the records of a section. */
+        const SceneFileHeader * header() const;
+        const void * section(unsigned sect) const;
+
+        /* Returns whether the mapping is a scene file of this version whose offsets are
+         * all inside it and whose indices are all in their batches. */
+        bool check() const;
+
+        /* Checks the image of the file and creates its materials and camera. */
+        bool prepare();
+    public:
+        SceneFile();
+        ~SceneFile();
+
+        /* Writes a scene into a file, finalizing it before. */
+        static bool write(const char * path, Scene * scene);
+
+        /* Maps a file, which must be a scene file of this version. */
+        bool open(const char * path);
+
+        /* Reads an entry of a package into anonymous memory, which then is used as the
+         * mapping; the entry must be a scene file of this version. */
+        bool open(const Package * package, unsigned entry);
+
+        /* Unmaps the file; the scenes created from it must be deleted before. */
+        void close();
+
+        /* Creates the scene of the file, finalized, using the geometry of the mapping.
+         * Adding static figures to it, or finalizing it again, drops the batches of the
+         * file. */
+        Scene * createScene();
+};
+
+/**
+ * A loader of the scenes of a map from scene files, one for each scene, named by a
+ * pattern with the coordinates of the scene, such as "scenes/%lld_%lld_%lld.gsc". The
+ * files can be the entries of a package instead, named in the same way. A scene without
+ * a file is empty.
+ */
+class GEngine::SceneFileLoader : public SceneLoader {
+    private:
+        std::string pattern;
+        const Package * package;    /* The package of the files, NULL for the disk. */
+        std::mutex  lock;
+        std::map<Scene *, SceneFile *>  files;  /* The file of each scene loaded. */
+    public:
+        SceneFileLoader(const char * pattern, const Package * package = NULL);
+        ~SceneFileLoader();
+
+        Scene * load(long long x, long long y, long long z);
+        void release(Scene * scene);
+};
+
+#endif
@@ -0,0 +1,46 @@
+/**
+ * Definition of the render statistics, the counters of the work submitted on each frame.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stddef.h>
+
+namespace GEngine {
+    struct RenderStats;
+};
+
+/**
+ * The counters of a frame. The ones of the frame being drawn are kept in RenderStats::frame,
+ * and the display saves and resets them after each frame.
+ */
+struct GEngine::RenderStats {
+    unsigned long   drawCalls;          /* The number of glBegin/glEnd pairs. */
+    unsigned long   vertices;           /* The number of vertices submitted. */
+    unsigned long   materialChanges;    /* The number of materials activated. */
+    unsigned long   polygonModeChanges; /* The number of polygon modes set. */
+    unsigned long   lightUploads;       /* The number of lights uploaded. */
+    unsigned long   figuresDrawn;       /* The number of figures drawn. */
+    unsigned long   figuresCulled;      /* The number of figures discarded before drawing. */
+    unsigned long   figuresOccluded;    /* The number of figures hidden by the occluders. */
+    unsigned long   instances;          /* The number of instances drawn. */
+    unsigned long   stateCallsSkipped;  /* The number of GL calls dropped by GLState. */
+    unsigned long   streamWaits;        /* The times the stream buffer waited for the GPU. */
+
+    /* The counters of the frame being drawn. */
+    static RenderStats frame;
+
+    /* Sets all the counters to zero. */
+    void reset();
+
+    /* Writes the counters as text, one per line. */
+    int format(char * buffer, size_t size) const;
+};
+
+#endif
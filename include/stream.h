@@ -0,0 +1,77 @@
+/**
+ * Definition of the stream buffers, the buffer objects receiving the vertices which change
+ * every frame. The buffer is split into regions used in turn: while the GPU reads one of
+ * them the next ones are written, and a fence set after the draws of each region tells
+ * when it can be written again. With OpenGL 4.4 the buffer stays mapped, so the vertices
+ * are written straight into it; without it they are written into a copy in memory and
+ * uploaded before each draw, orphaning the buffer when it is full.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <vector>
+
+/* The regions of a stream buffer: one drawn by the GPU, one queued and one written. */
+#define STREAM_REGIONS  3
+
+namespace GEngine {
+    class StreamBuffer;
+};
+
+/**
+ * A buffer object written by the CPU each frame and drawn by ranges.
+ */
+class GEngine::StreamBuffer {
+    private:
+        GLenum      target;
+        GLuint      buffer;
+        GLsizeiptr  size;           /* The size of each region. */
+        bool        persistent;     /* Whether the buffer is mapped while it is drawn. */
+        unsigned char   * data;     /* The mapping of the regions, or the copy of one. */
+        std::vector<unsigned char>  copy;
+
+        GLsync      fences[STREAM_REGIONS]; /* The end of the draws of each region. */
+        unsigned    region;         /* The region being written. */
+        GLsizeiptr  used;           /* The bytes written in the region. */
+        GLsizeiptr  uploaded;       /* The bytes of the copy uploaded. */
+
+        /* Fences the region being written and waits until the next one is free. */
+        void next();
+    public:
+        /* Creates the buffer, with the context current. */
+        StreamBuffer(GLenum target, GLsizeiptr size);
+        ~StreamBuffer();
+
+        /* Gets the bytes which can still be written in the region. */
+        GLsizeiptr getSpace() const;
+
+        /* Gets where the next bytes are written and their offset in the buffer. */
+        void * getPointer() const;
+        GLintptr getOffset() const;
+
+        /* Marks bytes as written after getPointer(). */
+        void commit(GLsizeiptr bytes);
+
+        /* Binds the buffer to its target, uploading the bytes written if it is not mapped. */
+        void bind();
+
+        /* Moves to the next region, carrying the last bytes written to its start. Whatever
+         * was drawn from the region must be submitted before. */
+        void wrap(GLsizeiptr keep = 0);
+
+        /* Moves to the next region at the end of the frame, after its draws. */
+        void endFrame();
+
+        /* Returns whether the buffer is mapped persistently. */
+        bool isPersistent() const;
+};
+
+#endif
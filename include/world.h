@@ -20,10 +20,21 @@
 
 #include <list>
 #include <vector>
+#include <map>
+#include <mutex>
+#include <set>
+#include <tuple>
 
 #include "geometry.h"
 #include "camera.h"
 #include "light.h"
+#include "command.h"
+#include "instance.h"
+#include "bvh.h"
+#include "grid.h"
+#include "occlusion.h"
+#include "pvs.h"
+#include "jobs.h"
 
 namespace GEngine {
     class Universe;
@@ -31,14 +42,18 @@ namespace GEngine {
     class Region;
     class Map;
     class Scene;
+    class SceneLoader;
+    struct DrawItem;
+    struct SceneRequest;
+    struct StaticBatch;
     enum position {
-        GES_NORTH,
-        GES_SOUTH,
-        GES_EAST,
-        GES_WEST,
+        GES_NORTH,      /* Towards -z. */
+        GES_SOUTH,      /* Towards +z. */
+        GES_EAST,       /* Towards +x. */
+        GES_WEST,       /* Towards -x. */
         GES_CENTER,
-        GES_UP,
-        GES_DOWN
+        GES_UP,         /* Towards +y. */
+        GES_DOWN        /* Towards -y. */
     };
 };
 
@@ -46,16 +61,105 @@ namespace GEngine {
 #define StaticFigureList    std::list<GEngine::Geometry::StaticFigure *>
 #define CameraVector        std::vector<GEngine::Camera *>
 #define LightList           std::vector<GEngine::Light *>
+#define FigureVector        std::vector<GEngine::Geometry::Figure *>
+#define StaticFigureVector  std::vector<GEngine::Geometry::StaticFigure *>
+
+/* The figures recorded by each job of a frame. */
+#define SCENE_RECORD_CHUNK  64
+
+/**
+ * A figure, or a group of instances, recorded for a frame, with the key used to sort the
+ * draws. The key is, from the
+ * most significant bit: the pass (4 bits), then, for the opaque pass, the polygon mode (4),
+ * the material (20), the texture (20) and the depth from the front (16); for the
+ * translucent pass, the depth from the back goes before the polygon mode.
+ */
+struct GEngine::DrawItem {
+    unsigned long long  key;
+    Material    * material; /* The material of the figure, or NULL. */
+    unsigned    state;      /* The polygon mode of the figure. */
+    unsigned    buffer;     /* The buffer with the commands of the figure. */
+    unsigned    first, last; /* The commands of the figure in the buffer. */
+    unsigned    drawn, culled; /* The figures recorded and the ones out of the view. */
+    unsigned    occluded;   /* The figures hidden by the occluders. */
+};
+
+#define DrawItemVector      std::vector<GEngine::DrawItem>
+
+/* The side of the cells of the space used to split the batches of static figures. */
+#define SCENE_BATCH_CELL    128
+
+/**
+ * The geometry of the static figures of a cell sharing the material, the polygon mode
+ * and the primitive, joined to be drawn at once.
+ */
+struct GEngine::StaticBatch {
+    GeometryBuffer      geometry;
+    Material            * material; /* The material of the figures, or NULL. */
+    unsigned            state;      /* The polygon mode of the figures. */
+    unsigned            figures;    /* The number of figures joined. */
+    StaticFigureVector  members;    /* The figures joined, none if read from a file. */
+    bool                dirty;      /* Whether a figure was edited since it was joined. */
+};
+
+#define StaticBatchList     std::vector<GEngine::StaticBatch *>
+
+/* The side of the cells of the grid keeping the dynamic figures. */
+#define SCENE_GRID_CELL     32
+
+/* The side of the cells of the potentially visible sets, and the points of each batch
+ * the rays are cast to. */
+#define SCENE_PVS_CELL      32
+#define SCENE_PVS_POINTS    16
+
+/* The scenes around a scene, the first targets of its sets; the batches go after them. */
+#define SCENE_NEIGHBOURS    26
 
 /**
  * The list of figures and objects to map into the window.
  */
 class GEngine::Scene {
     friend class Map;
+    friend class SceneFile;
     private:
         static Material black;
-        void printDynamic();
-        void printStatic();
+        FigureVector    drawList;   /* The figures to record in this frame. */
+        DrawItemVector  drawItems;  /* The figures recorded, sorted by state. */
+        std::vector<CommandBuffer>  recorders; /* The commands of each chunk of figures. */
+        CommandBuffer   commands;   /* The commands of the last frame printed. */
+        StaticBatchList batches;    /* The static figures joined by finalize(). */
+        bool            finalized;  /* Whether the batches contain all the static figures. */
+        unsigned        batched;    /* The static figures joined in the batches. */
+        BVH             batchTree;  /* The batches, to find the ones seen. */
+        BVH             figureTree; /* The static figures, for the queries. */
+        StaticFigureVector      figureIndex; /* The static figures in figureTree. */
+        std::vector<unsigned>   visibleBatches; /* The batches seen in this frame. */
+        Grid            dynGrid;    /* The dynamic figures, moved as they move. */
+        FigureVector    gridFigures; /* The dynamic figures by their handle in dynGrid. */
+        std::vector<FigureList::iterator>   gridLinks; /* Their place in DynFigures. */
+        /* The handles of the figures out of the limits, by the side they crossed. */
+        std::vector<unsigned>   leaving[GES_DOWN + 1];
+        StaticFigureVector      occluders; /* The figures hiding the ones behind them. */
+        Occlusion       occlusion;  /* The depth of the occluders seen in this frame. */
+        PVS             pvs;        /* The neighbours and batches seen from each cell. */
+        InstanceList    instances;  /* The instances, sorted by mesh and material. */
+        std::vector<unsigned>   instanceGroups; /* The first instance of each group. */
+
+        static void changeState(const DrawItem * prev, const DrawItem * item,
+                Renderer * rend);
+        unsigned long long sortKey(Material * mat, unsigned state, const double pos[3],
+                const double view[16]) const;
+        void groupInstances();
+        void clearBatches();
+        void buildTrees();
+        void rejoinBatches();
+        void setLimits();
+        void gridFound(std::vector<unsigned>& items, FigureVector * found) const;
+        void gridAdd(FigureList::iterator link);
+        enum position exitOf(const GLfloat box[6]) const;
+        void handOff(enum position side, Scene * target);
+        int cameraCell() const;
+        void recordFigures(CommandBuffer * cmds);
     protected:
         struct {
             long long xmin;
@@ -77,11 +181,51 @@ class GEngine::Scene {
         Scene(long long xmin, long long xmax, long long ymin, long long ymax, 
                 long long zmin, long long zmax);
         Scene(long long limits[6]);
+        ~Scene();
 
         /* Add figures. */
         void addDynFigure(Geometry::Figure * fig);
         void addStaFigure(Geometry::StaticFigure *fig);
 
+        /* Adds a static figure as an occluder, hiding the figures behind it. It must also
+         * be added with addStaFigure() to be drawn. */
+        void addOccluder(Geometry::StaticFigure * fig);
+
+        /* Adds an instance of a mesh, drawn with the other instances of the same mesh and
+         * material. */
+        void addInstance(Instance * inst);
+
+        /* Joins the static figures into batches, once all of them are added. The ones
+         * edited afterwards are joined again before the next frame. */
+        void finalize();
+
+        /* Bakes the sets of what can be seen from each cell of the scene, with the
+         * occluders stopping the view; it finalizes the scene. The sets are lost when
+         * the scene is finalized again. */
+        void bakePVS();
+
+        /* Writes the sets baked into a file, or reads them from it once finalized. */
+        bool savePVS(const char * path) const;
+        bool loadPVS(const char * path);
+
+        /* Returns whether the scene next to this one, by -1, 0 or 1 along each axis, can
+         * be seen from the camera. */
+        bool isNeighbourVisible(int dx, int dy, int dz) const;
+
+        /* Gets the static figures whose box is crossed by a segment, or overlaps a region,
+         * in the coordinates of the renderers. The scene must be finalized. */
+        void castRay(const GLfloat origin[3], const GLfloat dir[3], GLfloat length,
+                StaticFigureVector * found) const;
+        void findFigures(const GLfloat region[6], StaticFigureVector * found) const;
+
+        /* Gets the dynamic figures seen through a frustum, whose box overlaps a region or
+         * is closer to a point than a radius, in the order of their handles in the grid:
+         * the order they were added, unless figures left the scene. */
+        void findDynFigures(const Frustum& frustum, FigureVector * found) const;
+        void findDynFigures(const GLfloat region[6], FigureVector * found) const;
+        void findDynFigures(const GLfloat center[3], GLfloat radius,
+                FigureVector * found) const;
+
         /* Add lights to the scene. */
         void addLight(Light light);
 
@@ -91,8 +235,11 @@ class GEngine::Scene {
         /* Sets the horizon's material. */
         void setHorizon(Material  * hor);
 
-        /* Prints the whole scene on the screen. */
-        void print();
+        /* Records the whole scene into a command buffer. */
+        void record(CommandBuffer * cmds);
+
+        /* Prints the whole scene through a renderer. */
+        void print(Renderer * rend);
         void idle(const double time);
 
         /* Sets the camera. */
@@ -100,4 +247,173 @@ class GEngine::Scene {
 
 };
 
+/**
+ * The source of the scenes of a map, building them when they come near the camera and
+ * freeing them when they go away.
+ */
+class GEngine::SceneLoader {
+    public:
+        virtual ~SceneLoader();
+
+        /* Builds the scene at some coordinates of the map, covering from coords * size
+         * to (coords + 1) * size along each axis, or gives NULL if there is none. It is
+         * called by the loading threads, so it must not use the OpenGL context. */
+        virtual Scene * load(long long x, long long y, long long z) = 0;
+
+        /* Keeps whatever changed in a scene leaving the block around the camera. It is
+         * called by the loading threads; by default it does nothing. */
+        virtual void store(Scene * scene, long long x, long long y, long long z);
+
+        /* Frees a scene once it is stored, in the thread of the context, as its buffer
+         * objects go with it; by default it deletes the scene. */
+        virtual void release(Scene * scene);
+};
+
+/* The threads loading the scenes of each map. */
+#define MAP_LOADERS     2
+
+/* The weight of the direction of travel in the order the scenes are loaded. */
+#define MAP_AHEAD       1.0
+
+/* The coordinates of a scene in its map. */
+#define SceneKey        std::tuple<long long, long long, long long>
+#define SceneMap        std::map<SceneKey, GEngine::Scene *>
+
+/**
+ * A scene waiting to be loaded, and its priority: the lower, the sooner.
+ */
+struct GEngine::SceneRequest {
+    SceneKey    key;
+    double      priority;
+};
+
+#define SceneRequestList    std::vector<GEngine::SceneRequest>
+#define SceneReleaseList    std::vector<GEngine::Scene *>
+
+/**
+ * A space split into scenes of the same size, where only the 27 scenes around the camera
+ * are kept in memory. The scenes entering that block are loaded by the threads of the map,
+ * first the nearest ones and the ones in the direction the camera moves, and the ones
+ * leaving it are stored by them too. The loaded scenes are handed to the thread drawing
+ * the map only when the lock is free, so a frame never waits for them.
+ */
+class GEngine::Map {
+    private:
+        SceneLoader * loader;
+        long long   size[3];        /* The size of the scenes along each axis. */
+        long long   center[3];      /* The coordinates of the scene of the camera. */
+        bool        placed;         /* Whether center has been set. */
+        double      eye[3];         /* The position of the camera in the last update. */
+        double      heading[3];     /* The direction the camera moves, of length 1 or 0. */
+        Camera      * camera;
+
+        SceneMap    resident;       /* The scenes of the block, NULL where there is none. */
+        std::set<SceneKey>  requested; /* The scenes requested and not handed yet. */
+
+        /* Shared with the loading threads, under the lock. */
+        std::mutex          lock;
+        SceneRequestList    pending;    /* The scenes to load, by priority. */
+        SceneMap            loaded;     /* The scenes loaded, not handed yet. */
+        SceneReleaseList    stored;     /* The scenes stored, to be freed. */
+        JobPool             loaders;
+
+        /* Returns whether some coordinates are in the block around the center. */
+        bool isNear(const SceneKey& key) const;
+
+        /* Moves the block to a new center, requesting and storing the scenes. */
+        void moveTo(const long long coords[3]);
+
+        /* Loads the first scene requested, in a loading thread. */
+        void loadNext();
+
+        /* Hands the dynamic figures which left their scene to the scenes they entered. */
+        void handOff();
+    public:
+        /* Creates the map of the scenes of a loader, of a size along each axis. */
+        Map(SceneLoader * loader, long long sizeX, long long sizeY, long long sizeZ);
+        ~Map();
+
+        /* Sets the camera of the map, which chooses the scenes around it. */
+        void addCamera(Camera * cam);
+
+        /* Follows the camera, requesting the scenes around it, and takes the loaded ones
+         * if it can without waiting. */
+        void update();
+
+        /* Prints the scenes around the camera, the ones it can see from its scene. */
+        void print(Renderer * rend);
+
+        /* Processes the scenes in the idle state, hands the dynamic figures leaving them
+         * to their neighbours, then processes the camera. */
+        void idle(const double time);
+
+        /* Gets the scene next to the one of the camera, by -1, 0 or 1 along each axis, or
+         * NULL if it is not loaded. */
+        Scene * getScene(int dx, int dy, int dz) const;
+
+        /* Gets the number of scenes requested and not handed yet. */
+        unsigned getRequested() const;
+};
+
+#define MapVector       std::vector<GEngine::Map *>
+#define RegionVector    std::vector<GEngine::Region *>
+#define WorldVector     std::vector<GEngine::World *>
+
+/**
+ * A group of maps, i.e., a continent, with the one being played.
+ */
+class GEngine::Region {
+    private:
+        MapVector   maps;
+        Map         * current;
+    public:
+        Region();
+
+        /* Adds a map, the first one added becomes the current one. */
+        void addMap(Map * map);
+
+        /* Sets or gets the map being played. */
+        void setMap(Map * map);
+        Map * getMap() const;
+};
+
+/**
+ * A group of regions, with the one being played.
+ */
+class GEngine::World {
+    private:
+        RegionVector    regions;
+        Region          * current;
+    public:
+        World();
+
+        /* Adds a region, the first one added becomes the current one. */
+        void addRegion(Region * region);
+
+        /* Sets or gets the region being played. */
+        void setRegion(Region * region);
+        Region * getRegion() const;
+};
+
+/**
+ * All the worlds of the program, with the one being played.
+ */
+class GEngine::Universe {
+    private:
+        WorldVector     worlds;
+        World           * current;
+    public:
+        Universe();
+
+        /* Adds a world, the first one added becomes the current one. */
+        void addWorld(World * world);
+
+        /* Sets or gets the world being played. */
+        void setWorld(World * world);
+        World * getWorld() const;
+
+        /* Gets the map being played, through the current world and region. */
+        Map * getMap() const;
+};
+
 #endif
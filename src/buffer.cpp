@@ -0,0 +1,710 @@
+/**
+ * Implementation of the geometry buffers.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "buffer.h"
+#include "command.h"
+#include "matrix.h"
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+using namespace GEngine;
+
+/**
+ * The order used to find the vertices which are equal.
+ */
+struct VertexLess {
+    bool operator()(const BufferVertex& a, const BufferVertex& b) const
+    {
+        return memcmp(&a, &b, sizeof(BufferVertex)) < 0;
+    }
+};
+
+/**
+ * Checks whether the consecutive primitives of a mode can be drawn as a single one.
+ * @param   GLenum  mode    The mode of the primitives.
+ * @return  True for the lists of points, lines and triangles.
+ */
+static bool
+isList(GLenum mode)
+{
+    return mode == GL_POINTS || mode == GL_LINES || mode == GL_TRIANGLES || mode == GL_QUADS;
+}
+
+/**
+ * Constructor of an empty geometry.
+ */
+GeometryBuffer::GeometryBuffer()
+{
+    version = 0;
+    vbo = ibo = coreIbo = 0;
+    uploaded = coreUploaded = 0;
+    mapped = false;
+    clear();
+}
+
+/**
+ * Destructor of the geometry, freeing its buffer objects.
+ */
+GeometryBuffer::~GeometryBuffer()
+{
+#ifndef NO_GL
+    if (vbo != 0)
+        glDeleteBuffers(1, &vbo);
+    if (ibo != 0)
+        glDeleteBuffers(1, &ibo);
+    if (coreIbo != 0)
+        glDeleteBuffers(1, &coreIbo);
+#endif
+}
+
+/**
+ * Removes all the geometry.
+ */
+void
+GeometryBuffer::clear()
+{
+    vertices.clear();
+    indices.clear();
+    draws.clear();
+    mapped = false;
+    sync();
+    calls = 0;
+
+    /* An empty box, any vertex will be inside. */
+    bounds[0] = bounds[1] = bounds[2] = HUGE_VALF;
+    bounds[3] = bounds[4] = bounds[5] = -HUGE_VALF;
+
+    version++;
+}
+
+/**
+ * Points the geometry drawn to the lists, after they change.
+ */
+void
+GeometryBuffer::sync()
+{
+    vertexData = vertices.data();
+    indexData = indices.data();
+    drawData = draws.data();
+    vertexCount = vertices.size();
+    indexCount = indices.size();
+    drawCount = draws.size();
+}
+
+/**
+ * Copies the mapped geometry into the lists, so it can be changed without touching the
+ * memory it was in.
+ */
+void
+GeometryBuffer::own()
+{
+    if (!mapped)
+        return;
+
+    vertices.assign(vertexData, vertexData + vertexCount);
+    indices.assign(indexData, indexData + indexCount);
+    draws.assign(drawData, drawData + drawCount);
+    mapped = false;
+    sync();
+}
+
+/**
+ * Uses the geometry kept in memory of someone else, as it is, without copying it: it is
+ * uploaded from there and read from there by the renderers without buffer objects.
+ * @param   BufferVertex    * verts     The vertices.
+ * @param   unsigned        vertCount   The number of vertices.
+ * @param   GLuint          * idx       The indices of the primitives.
+ * @param   unsigned        idxCount    The number of indices.
+ * @param   BufferDraw      * prims     The primitives, ranges of the indices.
+ * @param   unsigned        primCount   The number of primitives.
+ * @param   GLfloat         box[6]      The minimum and maximum x, y and z of the vertices.
+ */
+void
+GeometryBuffer::map(const BufferVertex * verts, unsigned vertCount, const GLuint * idx,
+        unsigned idxCount, const BufferDraw * prims, unsigned primCount, const GLfloat box[6])
+{
+    clear();
+
+    mapped = true;
+    vertexData = verts;
+    indexData = idx;
+    drawData = prims;
+    vertexCount = vertCount;
+    indexCount = idxCount;
+    drawCount = primCount;
+    std::copy(box, box + 6, bounds);
+
+    for (unsigned draw = 0; draw < drawCount; draw++) {
+        if (draw == 0 || drawData[draw].mode != drawData[draw - 1].mode)
+            calls++;
+    }
+}
+
+/**
+ * Adds a draw. It is joined with the previous one if both are lists of the same
+ * primitive and their indices are consecutive.
+ * @param   GLenum      mode    The primitive.
+ * @param   unsigned    first   The first index.
+ * @param   unsigned    count   The number of indices.
+ */
+void
+GeometryBuffer::addDraw(GLenum mode, unsigned first, unsigned count)
+{
+    BufferDraw draw;
+
+    if (!draws.empty() && draws.back().mode == mode) {
+        if (isList(mode) && draws.back().first + draws.back().count == first) {
+            draws.back().count += count;
+            return;
+        }
+    } else
+        calls++;
+
+    draw.mode = mode;
+    draw.first = first;
+    draw.count = count;
+    draws.push_back(draw);
+}
+
+/**
+ * Extends the bounds to contain a vertex.
+ * @param   BufferVertex    vert    The vertex.
+ */
+void
+GeometryBuffer::addBounds(const BufferVertex& vert)
+{
+    const GLfloat pos[3] = { vert.x, vert.y, vert.z };
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        if (pos[axis] < bounds[axis])
+            bounds[axis] = pos[axis];
+        if (pos[axis] > bounds[axis + 3])
+            bounds[axis + 3] = pos[axis];
+    }
+}
+
+/**
+ * Builds the geometry from the draws of a command buffer. The matrices pushed are applied
+ * to the vertices, so the geometry is in the coordinates of the scene; the other commands
+ * are ignored.
+ * @param   CommandBuffer   cmds    The commands with the faces of the figure.
+ */
+void
+GeometryBuffer::build(const CommandBuffer& cmds)
+{
+    std::map<BufferVertex, GLuint, VertexLess> known;
+    std::map<BufferVertex, GLuint, VertexLess>::iterator found;
+    RenderCommandList::const_iterator cmd;
+    const CommandVertex * vert;
+    std::vector<double> saved;
+    double model[16], mat[16], in[4], out[4];
+    BufferVertex buf;
+
+    clear();
+    mat4Identity(model);
+
+    for (cmd = cmds.getCommands().begin(); cmd != cmds.getCommands().end(); cmd++) {
+        if (cmd->type == RenderCommand::PUSH_MATRIX) {
+            saved.insert(saved.end(), model, model + 16);
+            for (unsigned idx = 0; idx < 16; idx++)
+                mat[idx] = cmds.getMatrices()[cmd->first + idx];
+            mat4Multiply(model, mat, model);
+            continue;
+        } else if (cmd->type == RenderCommand::POP_MATRIX && saved.size() >= 16) {
+            std::copy(saved.end() - 16, saved.end(), model);
+            saved.resize(saved.size() - 16);
+            continue;
+        } else if (cmd->type != RenderCommand::DRAW)
+            continue;
+
+        addDraw(cmd->mode, indices.size(), cmd->count);
+
+        for (vert = &cmds.getVertices()[cmd->first];
+                vert != &cmds.getVertices()[cmd->first] + cmd->count; vert++) {
+            in[0] = vert->x;
+            in[1] = vert->y;
+            in[2] = vert->z;
+            in[3] = 1.0;
+            mat4Transform(model, in, out);
+
+            memset(&buf, 0, sizeof(buf));
+            buf.x = out[0];
+            buf.y = out[1];
+            buf.z = out[2];
+            buf.s = vert->s;
+            buf.t = vert->t;
+
+            if ((found = known.find(buf)) == known.end()) {
+                found = known.insert(std::make_pair(buf, (GLuint) vertices.size())).first;
+                vertices.push_back(buf);
+                addBounds(buf);
+            }
+            indices.push_back(found->second);
+        }
+    }
+    sync();
+}
+
+/**
+ * Adds the geometry of another buffer after the one of this one. The vertices are not
+ * joined with the ones already in the buffer.
+ * @param   GeometryBuffer  other   The geometry to add.
+ */
+void
+GeometryBuffer::append(const GeometryBuffer& other)
+{
+    const BufferDraw * draw;
+    const GLuint * idx;
+    unsigned base, first;
+
+    own();
+    base = vertices.size();
+    first = indices.size();
+
+    vertices.insert(vertices.end(), other.vertexData, other.vertexData + other.vertexCount);
+    for (idx = other.indexData; idx != other.indexData + other.indexCount; idx++)
+        indices.push_back(*idx + base);
+
+    for (draw = other.drawData; draw != other.drawData + other.drawCount; draw++)
+        addDraw(draw->mode, draw->first + first, draw->count);
+    sync();
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        if (other.bounds[axis] < bounds[axis])
+            bounds[axis] = other.bounds[axis];
+        if (other.bounds[axis + 3] > bounds[axis + 3])
+            bounds[axis + 3] = other.bounds[axis + 3];
+    }
+
+    version++;
+}
+
+#ifndef NO_GL
+/**
+ * Uploads the geometry into the buffer objects if it changed since the last upload,
+ * leaving them bound.
+ */
+void
+GeometryBuffer::upload()
+{
+    const BufferDraw * it;
+
+    if (vbo == 0) {
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ibo);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+    if (uploaded != version) {
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(BufferVertex), vertexData,
+                GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLuint), indexData,
+                GL_STATIC_DRAW);
+
+        counts.clear();
+        offsets.clear();
+        for (it = drawData; it != drawData + drawCount; it++) {
+            counts.push_back(it->count);
+            offsets.push_back((const void *) (it->first * sizeof(GLuint)));
+        }
+        uploaded = version;
+    }
+}
+
+/**
+ * Binds the buffer objects and the arrays of vertices, uploading the geometry before if it
+ * changed since the last upload.
+ */
+void
+GeometryBuffer::bind()
+{
+    upload();
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(BufferVertex), (void *) offsetof(BufferVertex, x));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(BufferVertex), (void *) offsetof(BufferVertex, s));
+}
+
+/**
+ * Unbinds the buffer objects and the arrays of vertices.
+ */
+void
+GeometryBuffer::unbind()
+{
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Draws the geometry with the current context, uploading it before if it changed since
+ * the last upload. The consecutive draws of the same primitive are drawn together with
+ * glMultiDrawElements.
+ */
+void
+GeometryBuffer::draw()
+{
+    unsigned first, last;
+
+    bind();
+
+    for (first = 0; first < drawCount; first = last) {
+        for (last = first + 1; last < drawCount && drawData[last].mode == drawData[first].mode;
+                last++);
+
+        glMultiDrawElements(drawData[first].mode, &counts[first], GL_UNSIGNED_INT,
+                &offsets[first], last - first);
+    }
+
+    unbind();
+}
+
+/**
+ * Draws several instances of the geometry with the current context, which must have set
+ * the attributes telling the instances apart. There is no instanced glMultiDrawElements,
+ * so each draw is a call to glDrawElementsInstanced; the draws joined by addDraw() keep
+ * them as few as the calls of draw().
+ * @param   GLsizei instances   The number of instances.
+ */
+void
+GeometryBuffer::drawInstanced(GLsizei instances)
+{
+    unsigned idx;
+
+    bind();
+
+    for (idx = 0; idx < drawCount; idx++)
+        glDrawElementsInstanced(drawData[idx].mode, counts[idx], GL_UNSIGNED_INT, offsets[idx],
+                instances);
+
+    unbind();
+}
+
+#endif
+
+/**
+ * Splits a primitive into the lists of the core profile, which has no quads nor polygons
+ * nor strips of lines. The faces are split into triangles, or, as OpenGL does with the
+ * polygon modes, into the edges of each triangle or quad, or into their corners.
+ * @param   GLenum      mode        The primitive, as glBegin.
+ * @param   GLenum      polyMode    The polygon mode of the faces.
+ * @param   GLuint      * idx       The indices of the vertices, or NULL.
+ * @param   GLuint      base        The first index when idx is NULL.
+ * @param   unsigned    count       The number of vertices.
+ * @param   BufferIndexList * points    The list receiving the points.
+ * @param   BufferIndexList * lines     The list receiving the pairs of lines.
+ * @param   BufferIndexList * triangles The list receiving the triangles.
+ */
+void
+GeometryBuffer::split(GLenum mode, GLenum polyMode, const GLuint * idx, GLuint base,
+        unsigned count, BufferIndexList * points, BufferIndexList * lines,
+        BufferIndexList * triangles)
+{
+    unsigned num;
+
+    auto at = [&](unsigned pos) { return idx != NULL ? idx[pos] : base + pos; };
+
+    /* A face given by its corners, as triangles, edges or points. */
+    auto face = [&](unsigned a, unsigned b, unsigned c, int d) {
+        unsigned corners[4] = { a, b, c, (unsigned) d }, size = d < 0 ? 3 : 4;
+
+        for (unsigned pos = 0; pos < size; pos++) {
+            if (polyMode == GL_POINT) {
+                points->push_back(at(corners[pos]));
+            } else if (polyMode == GL_LINE) {
+                lines->push_back(at(corners[pos]));
+                lines->push_back(at(corners[(pos + 1) % size]));
+            } else if (pos >= 2) {
+                triangles->push_back(at(corners[0]));
+                triangles->push_back(at(corners[pos - 1]));
+                triangles->push_back(at(corners[pos]));
+            }
+        }
+    };
+
+    switch (mode) {
+        case GL_POINTS:
+            for (num = 0; num < count; num++)
+                points->push_back(at(num));
+            break;
+        case GL_LINES:
+            for (num = 0; num + 1 < count; num += 2) {
+                lines->push_back(at(num));
+                lines->push_back(at(num + 1));
+            }
+            break;
+        case GL_LINE_STRIP:
+        case GL_LINE_LOOP:
+            for (num = 0; num + 1 < count; num++) {
+                lines->push_back(at(num));
+                lines->push_back(at(num + 1));
+            }
+            if (mode == GL_LINE_LOOP && count > 2) {
+                lines->push_back(at(count - 1));
+                lines->push_back(at(0));
+            }
+            break;
+        case GL_TRIANGLES:
+            for (num = 0; num + 2 < count; num += 3)
+                face(num, num + 1, num + 2, -1);
+            break;
+        case GL_TRIANGLE_STRIP:
+            /* The odd triangles are reversed to keep the winding. */
+            for (num = 0; num + 2 < count; num++) {
+                if (num % 2 == 0)
+                    face(num, num + 1, num + 2, -1);
+                else
+                    face(num + 1, num, num + 2, -1);
+            }
+            break;
+        case GL_TRIANGLE_FAN:
+            for (num = 1; num + 1 < count; num++)
+                face(0, num, num + 1, -1);
+            break;
+        case GL_QUADS:
+            for (num = 0; num + 3 < count; num += 4)
+                face(num, num + 1, num + 2, num + 3);
+            break;
+        case GL_QUAD_STRIP:
+            for (num = 0; num + 3 < count; num += 2)
+                face(num, num + 1, num + 3, num + 2);
+            break;
+        case GL_POLYGON:
+            /* A single face, drawn as a fan, with its outline as the edges. */
+            if (polyMode == GL_LINE) {
+                for (num = 0; num < count && count > 1; num++) {
+                    lines->push_back(at(num));
+                    lines->push_back(at((num + 1) % count));
+                }
+            } else if (polyMode == GL_POINT) {
+                for (num = 0; num < count; num++)
+                    points->push_back(at(num));
+            } else {
+                for (num = 1; num + 1 < count; num++)
+                    face(0, num, num + 1, -1);
+            }
+            break;
+    }
+}
+
+#ifndef NO_GL
+/**
+ * Builds the lists of the core profile from the draws and uploads them into their own
+ * buffer, as the ranges CORE_CORNERS, CORE_POINTS, CORE_LINES, CORE_EDGES and
+ * CORE_TRIANGLES, in this order, so the points and the lines drawn with each polygon mode
+ * are contiguous.
+ */
+void
+GeometryBuffer::uploadCore()
+{
+    BufferIndexList lists[CORE_RANGES], all, unused; /* The faces give nothing else. */
+    const BufferDraw * it;
+    const GLuint * idx;
+    unsigned range;
+
+    if (coreIbo == 0)
+        glGenBuffers(1, &coreIbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, coreIbo);
+
+    if (coreUploaded == version)
+        return;
+
+    for (it = drawData; it != drawData + drawCount; it++) {
+        idx = indexData + it->first;
+        split(it->mode, GL_FILL, idx, 0, it->count, &lists[CORE_POINTS], &lists[CORE_LINES],
+                &lists[CORE_TRIANGLES]);
+
+        /* The edges and the corners only come from the faces. */
+        if (it->mode != GL_POINTS && it->mode != GL_LINES && it->mode != GL_LINE_STRIP &&
+                it->mode != GL_LINE_LOOP) {
+            split(it->mode, GL_LINE, idx, 0, it->count, &unused, &lists[CORE_EDGES], &unused);
+            split(it->mode, GL_POINT, idx, 0, it->count, &lists[CORE_CORNERS], &unused,
+                    &unused);
+        }
+    }
+
+    for (range = 0; range < CORE_RANGES; range++) {
+        coreFirst[range] = all.size();
+        all.insert(all.end(), lists[range].begin(), lists[range].end());
+    }
+    coreFirst[CORE_RANGES] = all.size();
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, all.size() * sizeof(GLuint), all.data(),
+            GL_STATIC_DRAW);
+    coreUploaded = version;
+}
+
+/**
+ * Draws the geometry with the core profile. A vertex array object must be bound, the
+ * attributes 0 and 1 of it are set here. The faces are drawn as triangles, or as their
+ * edges or corners, following the polygon mode, which the core profile cannot set for the
+ * front and the back faces apart.
+ * @param   GLenum  polyMode    The polygon mode of the faces.
+ * @param   GLsizei instances   The number of instances, 0 to draw it once without them.
+ */
+void
+GeometryBuffer::drawCore(GLenum polyMode, GLsizei instances)
+{
+    const GLenum modes[3] = { GL_POINTS, GL_LINES, GL_TRIANGLES };
+    unsigned ranges[3][2];
+    unsigned idx;
+
+    upload();
+    uploadCore();
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BufferVertex),
+            (void *) offsetof(BufferVertex, x));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(BufferVertex),
+            (void *) offsetof(BufferVertex, s));
+
+    /* The ranges drawn as points, lines and triangles. */
+    ranges[0][0] = coreFirst[polyMode == GL_POINT ? CORE_CORNERS : CORE_POINTS];
+    ranges[0][1] = coreFirst[CORE_LINES];
+    ranges[1][0] = coreFirst[CORE_LINES];
+    ranges[1][1] = coreFirst[polyMode == GL_LINE ? CORE_TRIANGLES : CORE_EDGES];
+    ranges[2][0] = coreFirst[CORE_TRIANGLES];
+    ranges[2][1] = polyMode == GL_FILL ? coreFirst[CORE_RANGES] : coreFirst[CORE_TRIANGLES];
+
+    for (idx = 0; idx < 3; idx++) {
+        if (ranges[idx][1] == ranges[idx][0])
+            continue;
+
+        if (instances > 0)
+            glDrawElementsInstanced(modes[idx], ranges[idx][1] - ranges[idx][0],
+                    GL_UNSIGNED_INT, (void *) (ranges[idx][0] * sizeof(GLuint)), instances);
+        else
+            glDrawElements(modes[idx], ranges[idx][1] - ranges[idx][0], GL_UNSIGNED_INT,
+                    (void *) (ranges[idx][0] * sizeof(GLuint)));
+    }
+
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+#endif
+
+/**
+ * Gets the vertices of the geometry.
+ * @return  The vertices.
+ */
+const BufferVertex *
+GeometryBuffer::getVertices() const
+{
+    return vertexData;
+}
+
+/**
+ * Gets the indices of the primitives.
+ * @return  The indices.
+ */
+const GLuint *
+GeometryBuffer::getIndices() const
+{
+    return indexData;
+}
+
+/**
+ * Gets the primitives of the geometry.
+ * @return  The primitives.
+ */
+const BufferDraw *
+GeometryBuffer::getDraws() const
+{
+    return drawData;
+}
+
+/**
+ * Gets the number of vertices of the geometry.
+ * @return  The number of vertices.
+ */
+unsigned
+GeometryBuffer::getVertexCount() const
+{
+    return vertexCount;
+}
+
+/**
+ * Gets the number of indices of the primitives.
+ * @return  The number of indices.
+ */
+unsigned
+GeometryBuffer::getIndexCount() const
+{
+    return indexCount;
+}
+
+/**
+ * Gets the number of primitives of the geometry.
+ * @return  The number of primitives.
+ */
+unsigned
+GeometryBuffer::getDrawCount() const
+{
+    return drawCount;
+}
+
+/**
+ * Gets the faces of the geometry split into triangles, without the points and the lines.
+ * @param   BufferIndexList * triangles The list receiving the indices of the vertices of
+ *                                      the triangles, three by three.
+ */
+void
+GeometryBuffer::getFaces(BufferIndexList * triangles) const
+{
+    BufferIndexList unused;
+    const BufferDraw * it;
+
+    for (it = drawData; it != drawData + drawCount; it++)
+        split(it->mode, GL_FILL, indexData + it->first, 0, it->count, &unused, &unused,
+                triangles);
+}
+
+/**
+ * Gets the version of the geometry, increased each time it is built.
+ * @return  The version.
+ */
+unsigned
+GeometryBuffer::getVersion() const
+{
+    return version;
+}
+
+/**
+ * Gets the box containing the geometry.
+ * @return  The minimum x, y, z and the maximum x, y, z.
+ */
+const GLfloat *
+GeometryBuffer::getBounds() const
+{
+    return bounds;
+}
+
+/**
+ * Gets the number of calls needed to draw the geometry with buffer objects, one for each
+ * run of draws of the same primitive.
+ * @return  The number of calls.
+ */
+unsigned
+GeometryBuffer::getCalls() const
+{
+    return calls;
+}
@@ -0,0 +1,495 @@
+/**
+ * Implementation of the bounding volume hierarchies.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "bvh.h"
+#include "camera.h"
+#include "jobs.h"
+#include "profiler.h"
+#include <algorithm>
+#include <functional>
+#include <math.h>
+
+using namespace GEngine;
+
+/**
+ * Gets the half of the surface of a box, 0 if it is empty.
+ * @param   GLfloat box[6]  The minimum and maximum x, y and z.
+ * @return  The half of the surface.
+ */
+static GLfloat
+halfArea(const GLfloat box[6])
+{
+    GLfloat dx = box[3] - box[0], dy = box[4] - box[1], dz = box[5] - box[2];
+
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+        return 0.0f;
+
+    return dx * dy + dy * dz + dz * dx;
+}
+
+/**
+ * Empties a box, so any box grown into it is the result.
+ * @param   GLfloat box[6]  The box to empty.
+ */
+static void
+emptyBox(GLfloat box[6])
+{
+    for (unsigned axis = 0; axis < 3; axis++) {
+        box[axis] = HUGE_VALF;
+        box[axis + 3] = - HUGE_VALF;
+    }
+}
+
+/**
+ * Grows a box to contain another one.
+ * @param   GLfloat box[6]      The box to grow.
+ * @param   GLfloat other[6]    The box to contain.
+ */
+static void
+growBox(GLfloat box[6], const GLfloat other[6])
+{
+    for (unsigned axis = 0; axis < 3; axis++) {
+        box[axis] = std::min(box[axis], other[axis]);
+        box[axis + 3] = std::max(box[axis + 3], other[axis + 3]);
+    }
+}
+
+/**
+ * Tests whether a segment crosses a box, with the slabs of its three axes.
+ * @param   GLfloat box[6]      The box.
+ * @param   GLfloat origin[3]   The start of the segment.
+ * @param   GLfloat dir[3]      The direction of the segment.
+ * @param   GLfloat length      The length of the segment, in units of dir.
+ * @return  Whether the segment crosses the box.
+ */
+static bool
+crosses(const GLfloat box[6], const GLfloat origin[3], const GLfloat dir[3], GLfloat length)
+{
+    GLfloat near = 0.0f, far = length, t0, t1;
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        if (dir[axis] == 0.0f) {
+            if (origin[axis] < box[axis] || origin[axis] > box[axis + 3])
+                return false;
+            continue;
+        }
+
+        t0 = (box[axis] - origin[axis]) / dir[axis];
+        t1 = (box[axis + 3] - origin[axis]) / dir[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        near = std::max(near, t0);
+        far = std::min(far, t1);
+        if (near > far)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Gets the box of the items in a range and the box of their centers.
+ * @param   unsigned    first       The first item.
+ * @param   unsigned    last        The item after the last one.
+ * @param   GLfloat     box[6]      The box of the items.
+ * @param   GLfloat     centerBox[6] The box of the centers.
+ */
+void
+BVH::bound(unsigned first, unsigned last, GLfloat box[6], GLfloat centerBox[6]) const
+{
+    const GLfloat * center;
+
+    emptyBox(box);
+    emptyBox(centerBox);
+    for (unsigned idx = first; idx < last; idx++) {
+        growBox(box, &boxes[items[idx] * 6]);
+
+        center = &centers[items[idx] * 3];
+        for (unsigned axis = 0; axis < 3; axis++) {
+            centerBox[axis] = std::min(centerBox[axis], center[axis]);
+            centerBox[axis + 3] = std::max(centerBox[axis + 3], center[axis]);
+        }
+    }
+}
+
+/**
+ * Sorts the items of a node into its two children. The centers are put in bins along the
+ * axis where they spread the most, and the split between two bins with the lowest cost,
+ * the surface of each side by its items, is taken. The node is a leaf if it is small and
+ * the split costs more than testing all its items, or if the tree is too deep.
+ * @param   unsigned    first       The first item.
+ * @param   unsigned    last        The item after the last one.
+ * @param   GLfloat     box[6]      The box of the items.
+ * @param   GLfloat     centerBox[6] The box of their centers.
+ * @param   unsigned    depth       The depth of the node.
+ * @return  The first item of the second child, or last for a leaf.
+ */
+unsigned
+BVH::split(unsigned first, unsigned last, const GLfloat box[6], const GLfloat centerBox[6],
+        unsigned depth)
+{
+    struct {
+        GLfloat     box[6];
+        unsigned    count;
+    } bins[BVH_BINS];
+    GLfloat rightArea[BVH_BINS], side[6], extent = -1.0f, scale, cost, best = HUGE_VALF;
+    unsigned count = last - first, axis = 0, bin, leftCount, rightCount, bestBin = 0, mid;
+
+    if (count <= 1 || depth >= BVH_MAX_DEPTH - 1)
+        return last;
+
+    for (unsigned dim = 0; dim < 3; dim++) {
+        if (centerBox[dim + 3] - centerBox[dim] > extent) {
+            extent = centerBox[dim + 3] - centerBox[dim];
+            axis = dim;
+        }
+    }
+
+    /* All the centers are the same, any half is as good as the other. */
+    if (extent <= 0.0f)
+        return count <= BVH_LEAF_SIZE ? last : first + count / 2;
+
+    scale = BVH_BINS / extent;
+    auto binOf = [&](unsigned item) {
+        unsigned idx = (unsigned) ((centers[item * 3 + axis] - centerBox[axis]) * scale);
+        return idx < BVH_BINS ? idx : BVH_BINS - 1;
+    };
+
+    for (bin = 0; bin < BVH_BINS; bin++) {
+        emptyBox(bins[bin].box);
+        bins[bin].count = 0;
+    }
+    for (unsigned idx = first; idx < last; idx++) {
+        bin = binOf(items[idx]);
+        growBox(bins[bin].box, &boxes[items[idx] * 6]);
+        bins[bin].count++;
+    }
+
+    /* The surface of the right side of each split, then the left one as it grows. */
+    emptyBox(side);
+    for (bin = BVH_BINS - 1; bin > 0; bin--) {
+        growBox(side, bins[bin].box);
+        rightArea[bin] = halfArea(side);
+    }
+
+    emptyBox(side);
+    leftCount = 0;
+    for (bin = 0; bin < BVH_BINS - 1; bin++) {
+        growBox(side, bins[bin].box);
+        leftCount += bins[bin].count;
+        rightCount = count - leftCount;
+        if (leftCount == 0 || rightCount == 0)
+            continue;
+
+        cost = leftCount * halfArea(side) + rightCount * rightArea[bin + 1];
+        if (cost < best) {
+            best = cost;
+            bestBin = bin;
+        }
+    }
+
+    /* Testing the items of a leaf against crossing the node and its children. */
+    if (count <= BVH_LEAF_SIZE && count * halfArea(box) <= halfArea(box) + best)
+        return last;
+
+    mid = std::partition(items.begin() + first, items.begin() + last,
+            [&](unsigned item) { return binOf(item) <= bestBin; }) - items.begin();
+
+    if (mid == first || mid == last) {
+        mid = first + count / 2;
+        std::nth_element(items.begin() + first, items.begin() + mid, items.begin() + last,
+                [&](unsigned a, unsigned b) {
+                    return centers[a * 3 + axis] < centers[b * 3 + axis];
+                });
+    }
+
+    return mid;
+}
+
+/**
+ * Builds the subtree of a range of items, appending its nodes in depth first order. The
+ * second children are given as indices in the list.
+ * @param   unsigned    first   The first item.
+ * @param   unsigned    last    The item after the last one.
+ * @param   unsigned    depth   The depth of the subtree.
+ * @param   BVHNodeList out     The list receiving the nodes.
+ */
+void
+BVH::buildRange(unsigned first, unsigned last, unsigned depth, BVHNodeList& out)
+{
+    BVHNode node;
+    GLfloat centerBox[6];
+    unsigned idx = out.size(), mid;
+
+    bound(first, last, node.bounds, centerBox);
+    node.first = first;
+    node.count = last - first;
+    node.right = 0;
+    out.push_back(node);
+
+    if ((mid = split(first, last, node.bounds, centerBox, depth)) == last)
+        return;
+
+    buildRange(first, mid, depth + 1, out);
+    out[idx].right = out.size();
+    buildRange(mid, last, depth + 1, out);
+}
+
+/**
+ * Builds the tree over a set of boxes. The upper levels are split here until the ranges
+ * are small enough, then the subtree of each range is built by a job, and the nodes are
+ * joined at the end in depth first order.
+ * @param   GLfloat     * boxes The minimum and maximum x, y and z of each box.
+ * @param   unsigned    count   The number of boxes.
+ */
+void
+BVH::build(const GLfloat * boxes, unsigned count)
+{
+    struct Split {
+        BVHNode     node;
+        unsigned    depth;
+        int         task;   /* The subtree built by a job, -1 if the node is split here. */
+    };
+    std::vector<Split> upper;
+    std::vector<BVHNodeList> subtrees;
+    std::function<void (unsigned, unsigned, unsigned)> plan;
+    std::function<void (unsigned)> join;
+
+    PROFILE_SCOPE("BVH::build");
+
+    clear();
+    if (count == 0)
+        return;
+
+    this->boxes.assign(boxes, boxes + count * 6);
+    centers.resize(count * 3);
+    items.resize(count);
+    for (unsigned idx = 0; idx < count; idx++) {
+        items[idx] = idx;
+        for (unsigned axis = 0; axis < 3; axis++)
+            centers[idx * 3 + axis] = (boxes[idx * 6 + axis] + boxes[idx * 6 + axis + 3]) / 2;
+    }
+
+    /* The first child of each upper node follows it, as in the final tree. */
+    plan = [&](unsigned first, unsigned last, unsigned depth) {
+        Split split;
+        GLfloat centerBox[6];
+        unsigned idx = upper.size(), mid = last;
+
+        bound(first, last, split.node.bounds, centerBox);
+        split.node.first = first;
+        split.node.count = last - first;
+        split.node.right = 0;
+        split.depth = depth;
+        split.task = -1;
+        upper.push_back(split);
+
+        if (last - first > BVH_TASK_SIZE)
+            mid = this->split(first, last, split.node.bounds, centerBox, depth);
+        if (mid == last) {
+            upper[idx].task = subtrees.size();
+            subtrees.push_back(BVHNodeList());
+            return;
+        }
+
+        plan(first, mid, depth + 1);
+        upper[idx].node.right = upper.size();
+        plan(mid, last, depth + 1);
+    };
+    plan(0, count, 0);
+
+    std::vector<unsigned> tasks(subtrees.size());
+    for (unsigned idx = 0; idx < upper.size(); idx++) {
+        if (upper[idx].task >= 0)
+            tasks[upper[idx].task] = idx;
+    }
+
+    JobPool::instance()->parallelFor(tasks.size(), [&](unsigned task) {
+        const Split& split = upper[tasks[task]];
+
+        buildRange(split.node.first, split.node.first + split.node.count, split.depth,
+                subtrees[task]);
+    });
+
+    join = [&](unsigned idx) {
+        unsigned base = nodes.size(), pos;
+
+        if (upper[idx].task >= 0) {
+            for (const BVHNode& node : subtrees[upper[idx].task]) {
+                nodes.push_back(node);
+                if (node.right != 0)
+                    nodes.back().right += base;
+            }
+            return;
+        }
+
+        pos = nodes.size();
+        nodes.push_back(upper[idx].node);
+        join(idx + 1);
+        nodes[pos].right = nodes.size();
+        join(upper[idx].node.right);
+    };
+    join(0);
+}
+
+/**
+ * Removes all the boxes and the nodes.
+ */
+void
+BVH::clear()
+{
+    nodes.clear();
+    items.clear();
+    boxes.clear();
+    centers.clear();
+}
+
+/**
+ * Adds all the items below a node to a list.
+ * @param   BVHNode     node    The node.
+ * @param   unsigned    * found The list receiving the items.
+ */
+void
+BVH::addItems(const BVHNode& node, std::vector<unsigned> * found) const
+{
+    found->insert(found->end(), items.begin() + node.first,
+            items.begin() + node.first + node.count);
+}
+
+/**
+ * Gets the boxes which can be seen through a frustum. The nodes out of it are skipped
+ * with their children, and the ones inside it give all their items without testing them.
+ * @param   Frustum     frustum The frustum.
+ * @param   unsigned    * found The list receiving the indices of the boxes.
+ */
+void
+BVH::cull(const Frustum& frustum, std::vector<unsigned> * found) const
+{
+    unsigned stack[BVH_MAX_DEPTH * 2], top = 0, idx;
+
+    if (nodes.empty())
+        return;
+
+    stack[top++] = 0;
+    while (top > 0) {
+        idx = stack[--top];
+        const BVHNode& node = nodes[idx];
+
+        if (!frustum.isBoxVisible(node.bounds))
+            continue;
+
+        if (frustum.isBoxInside(node.bounds)) {
+            addItems(node, found);
+        } else if (node.right == 0) {
+            for (unsigned item = node.first; item < node.first + node.count; item++) {
+                if (frustum.isBoxVisible(&boxes[items[item] * 6]))
+                    found->push_back(items[item]);
+            }
+        } else {
+            stack[top++] = node.right;
+            stack[top++] = idx + 1;
+        }
+    }
+}
+
+/**
+ * Gets the boxes crossed by a segment.
+ * @param   GLfloat     origin[3]   The start of the segment.
+ * @param   GLfloat     dir[3]      The direction of the segment.
+ * @param   GLfloat     length      The length of the segment, in units of dir.
+ * @param   unsigned    * found     The list receiving the indices of the boxes.
+ */
+void
+BVH::intersect(const GLfloat origin[3], const GLfloat dir[3], GLfloat length,
+        std::vector<unsigned> * found) const
+{
+    unsigned stack[BVH_MAX_DEPTH * 2], top = 0, idx;
+
+    if (nodes.empty())
+        return;
+
+    stack[top++] = 0;
+    while (top > 0) {
+        idx = stack[--top];
+        const BVHNode& node = nodes[idx];
+
+        if (!crosses(node.bounds, origin, dir, length))
+            continue;
+
+        if (node.right == 0) {
+            for (unsigned item = node.first; item < node.first + node.count; item++) {
+                if (crosses(&boxes[items[item] * 6], origin, dir, length))
+                    found->push_back(items[item]);
+            }
+        } else {
+            stack[top++] = node.right;
+            stack[top++] = idx + 1;
+        }
+    }
+}
+
+/**
+ * Gets the boxes which overlap a region. The nodes inside it give all their items
+ * without testing them.
+ * @param   GLfloat     region[6]   The minimum and maximum x, y and z of the region.
+ * @param   unsigned    * found     The list receiving the indices of the boxes.
+ */
+void
+BVH::query(const GLfloat region[6], std::vector<unsigned> * found) const
+{
+    unsigned stack[BVH_MAX_DEPTH * 2], top = 0, idx, axis;
+    const GLfloat * box;
+    bool inside;
+
+    auto overlaps = [&](const GLfloat * box) {
+        for (unsigned axis = 0; axis < 3; axis++) {
+            if (box[axis] > region[axis + 3] || box[axis + 3] < region[axis])
+                return false;
+        }
+        return true;
+    };
+
+    if (nodes.empty())
+        return;
+
+    stack[top++] = 0;
+    while (top > 0) {
+        idx = stack[--top];
+        const BVHNode& node = nodes[idx];
+
+        if (!overlaps(node.bounds))
+            continue;
+
+        box = node.bounds;
+        for (axis = 0, inside = true; axis < 3 && inside; axis++)
+            inside = box[axis] >= region[axis] && box[axis + 3] <= region[axis + 3];
+
+        if (inside) {
+            addItems(node, found);
+        } else if (node.right == 0) {
+            for (unsigned item = node.first; item < node.first + node.count; item++) {
+                if (overlaps(&boxes[items[item] * 6]))
+                    found->push_back(items[item]);
+            }
+        } else {
+            stack[top++] = node.right;
+            stack[top++] = idx + 1;
+        }
+    }
+}
+
+/**
+ * Gets the nodes of the tree.
+ * @return  The nodes in depth first order, the root first.
+ */
+const BVHNodeList&
+BVH::getNodes() const
+{
+    return nodes;
+}
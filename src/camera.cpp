@@ -12,7 +12,11 @@
 #include "camera.h"
 #include <GL/gl.h>
 #include "matrix.h"
+#include "glstate.h"
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #ifdef DEBUG
 #include <stdio.h>
 #endif
@@ -29,6 +33,9 @@ Camera::Camera(Point pos, double y, double p, double r)
     yaw = y;
     pitch = p;
     roll = r;
+
+    /* A lens of 90 degrees, until the scene sets its own depth. */
+    setFOV(0.1, 45.0, 100.0);
 }
 
 /**
@@ -55,12 +62,20 @@ Camera::rotate(double y, double p, double r)
 }
 
 /**
- * Makes the camera active.
+ * Makes the camera active. The modelview is left selected, so the figures can multiply
+ * their matrices into it. Without OpenGL, it does nothing.
  */
 void
 Camera::activate()
 {
-    glMatrixMode(GL_MODELVIEW);
+#ifndef NO_GL
+    GLState::matrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glFrustum(projection[0], projection[1], projection[2], 
+            projection[3], projection[4], projection[5]);
+
+    GLState::matrixMode(GL_MODELVIEW);
     glPushMatrix();
 
     glLoadIdentity();
@@ -68,12 +83,7 @@ Camera::activate()
     glRotated(yaw, 1.0, 0.0, 0.0);
     glRotated(pitch, 0.0, 1.0, 0.0);
     glRotated(roll, 0.0, 0.0, 1.0);
-
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    glFrustum(projection[0], projection[1], projection[2], 
-            projection[3], projection[4], projection[5]);
+#endif
 }
 
 /**
@@ -82,11 +92,13 @@ Camera::activate()
 void
 Camera::deactivate()
 {
-    glMatrixMode(GL_MODELVIEW);
+#ifndef NO_GL
+    GLState::matrixMode(GL_PROJECTION);
     glPopMatrix();
 
-    glMatrixMode(GL_PROJECTION);
+    GLState::matrixMode(GL_MODELVIEW);
     glPopMatrix();
+#endif
 }
 
 /**
@@ -110,6 +122,194 @@ Camera::setFOV(double distance, double overture, double depth)
     projection[5] = distance + depth;
 }
 
+/**
+ * Calculates the modelview matrix loaded by the camera when it is activated.
+ * @param   double  matrix[16]  The matrix, stored by columns.
+ */
+void
+Camera::getModelview(double matrix[16]) const
+{
+    double rot[16];
+
+    mat4Translation(-position.x, -position.y, -position.z, matrix);
+    mat4Rotation(yaw, 1.0, 0.0, 0.0, rot);
+    mat4Multiply(matrix, rot, matrix);
+    mat4Rotation(pitch, 0.0, 1.0, 0.0, rot);
+    mat4Multiply(matrix, rot, matrix);
+    mat4Rotation(roll, 0.0, 0.0, 1.0, rot);
+    mat4Multiply(matrix, rot, matrix);
+}
+
+/**
+ * Calculates the projection matrix loaded by the camera when it is activated.
+ * @param   double  matrix[16]  The matrix, stored by columns.
+ */
+void
+Camera::getProjection(double matrix[16]) const
+{
+    mat4Frustum(projection[0], projection[1], projection[2],
+            projection[3], projection[4], projection[5], matrix);
+}
+
+/**
+ * Calculates the position of the camera in the coordinates of the figures, from its
+ * modelview: for the rotation R and the translation t of the view, it is - R^T * t.
+ * @param   double  eye[3]  The position.
+ */
+void
+Camera::getEye(double eye[3]) const
+{
+    double view[16];
+
+    getModelview(view);
+    for (unsigned axis = 0; axis < 3; axis++)
+        eye[axis] = - (view[axis * 4] * view[12] + view[axis * 4 + 1] * view[13] +
+                view[axis * 4 + 2] * view[14]);
+}
+
+/**
+ * Calculates the planes bounding the view of the camera, from its projection and its
+ * modelview. Each plane is a, b, c, d with a * x + b * y + c * z + d >= 0 inside, and the
+ * normal (a, b, c) of length one.
+ * @param   double  planes[6][4]    The left, right, bottom, top, near and far planes.
+ */
+void
+Camera::getFrustum(double planes[6][4]) const
+{
+    double view[16], proj[16], clip[16], length;
+    unsigned plane, idx;
+
+    getModelview(view);
+    getProjection(proj);
+    mat4Multiply(proj, view, clip);
+
+    /* Each plane is the last row of the matrix plus or minus one of the others. */
+    for (plane = 0; plane < 6; plane++) {
+        for (idx = 0; idx < 4; idx++) {
+            planes[plane][idx] = clip[idx * 4 + 3] +
+                (plane % 2 == 0 ? 1.0 : -1.0) * clip[idx * 4 + plane / 2];
+        }
+
+        length = sqrt(planes[plane][0] * planes[plane][0] +
+                planes[plane][1] * planes[plane][1] + planes[plane][2] * planes[plane][2]);
+        for (idx = 0; idx < 4 && length > 0.0; idx++)
+            planes[plane][idx] /= length;
+    }
+}
+
+/**
+ * Constructor of the frustum. The planes after the six of the camera are always passed,
+ * and until it is set all of them are.
+ */
+Frustum::Frustum()
+{
+    for (unsigned plane = 0; plane < FRUSTUM_PLANES; plane++) {
+        nx[plane] = ny[plane] = nz[plane] = 0.0f;
+        ax[plane] = ay[plane] = az[plane] = 0.0f;
+        dist[plane] = 1.0f;
+    }
+}
+
+/**
+ * Sets the planes seen by a camera.
+ * @param   Camera  * cam   The camera.
+ */
+void
+Frustum::set(const Camera * cam)
+{
+    double planes[6][4];
+
+    cam->getFrustum(planes);
+    for (unsigned plane = 0; plane < 6; plane++) {
+        nx[plane] = planes[plane][0];
+        ny[plane] = planes[plane][1];
+        nz[plane] = planes[plane][2];
+        dist[plane] = planes[plane][3];
+        ax[plane] = fabs(nx[plane]);
+        ay[plane] = fabs(ny[plane]);
+        az[plane] = fabs(nz[plane]);
+    }
+}
+
+/**
+ * Tests a box against the planes. The box is out of a plane when the corner furthest
+ * along its normal is behind it, that is, when the distance from the center plus the
+ * half sizes projected on the normal is negative.
+ * @param   GLfloat cx, cy, cz      The center of the box.
+ * @param   GLfloat ex, ey, ez      The half sizes of the box.
+ * @param   GLfloat radius          The radius added to the distance, for the spheres.
+ * @return  Whether the box is in front of all the planes.
+ */
+bool
+Frustum::test(GLfloat cx, GLfloat cy, GLfloat cz, GLfloat ex, GLfloat ey, GLfloat ez,
+        GLfloat radius) const
+{
+    unsigned plane;
+
+#ifdef __SSE2__
+    const __m128 vcx = _mm_set1_ps(cx), vcy = _mm_set1_ps(cy), vcz = _mm_set1_ps(cz);
+    const __m128 vex = _mm_set1_ps(ex), vey = _mm_set1_ps(ey), vez = _mm_set1_ps(ez);
+    const __m128 vr = _mm_set1_ps(radius), zero = _mm_setzero_ps();
+    __m128 d;
+
+    for (plane = 0; plane < FRUSTUM_PLANES; plane += 4) {
+        d = _mm_add_ps(_mm_load_ps(dist + plane), vr);
+        d = _mm_add_ps(d, _mm_mul_ps(_mm_load_ps(nx + plane), vcx));
+        d = _mm_add_ps(d, _mm_mul_ps(_mm_load_ps(ny + plane), vcy));
+        d = _mm_add_ps(d, _mm_mul_ps(_mm_load_ps(nz + plane), vcz));
+        d = _mm_add_ps(d, _mm_mul_ps(_mm_load_ps(ax + plane), vex));
+        d = _mm_add_ps(d, _mm_mul_ps(_mm_load_ps(ay + plane), vey));
+        d = _mm_add_ps(d, _mm_mul_ps(_mm_load_ps(az + plane), vez));
+        if (_mm_movemask_ps(_mm_cmplt_ps(d, zero)) != 0)
+            return false;
+    }
+#else
+    for (plane = 0; plane < FRUSTUM_PLANES; plane++) {
+        if (nx[plane] * cx + ny[plane] * cy + nz[plane] * cz + dist[plane] +
+                ax[plane] * ex + ay[plane] * ey + az[plane] * ez + radius < 0.0f)
+            return false;
+    }
+#endif
+
+    return true;
+}
+
+/**
+ * Returns whether a box can be seen, even partially.
+ * @param   GLfloat box[6]  The minimum and the maximum x, y and z of the box.
+ * @return  False if the box is out of the view.
+ */
+bool
+Frustum::isBoxVisible(const GLfloat box[6]) const
+{
+    return test((box[0] + box[3]) / 2, (box[1] + box[4]) / 2, (box[2] + box[5]) / 2,
+            (box[3] - box[0]) / 2, (box[4] - box[1]) / 2, (box[5] - box[2]) / 2, 0.0f);
+}
+
+/**
+ * Returns whether a box is entirely inside the frustum: the corner nearest to each plane
+ * is in front of it.
+ * @param   GLfloat box[6]  The minimum and the maximum x, y and z of the box.
+ * @return  Whether all the box can be seen.
+ */
+bool
+Frustum::isBoxInside(const GLfloat box[6]) const
+{
+    return test((box[0] + box[3]) / 2, (box[1] + box[4]) / 2, (box[2] + box[5]) / 2,
+            (box[0] - box[3]) / 2, (box[1] - box[4]) / 2, (box[2] - box[5]) / 2, 0.0f);
+}
+
+/**
+ * Returns whether a sphere can be seen, even partially.
+ * @param   GLfloat sphere[4]   The center and the radius of the sphere.
+ * @return  False if the sphere is out of the view.
+ */
+bool
+Frustum::isSphereVisible(const GLfloat sphere[4]) const
+{
+    return test(sphere[0], sphere[1], sphere[2], 0.0f, 0.0f, 0.0f, sphere[3]);
+}
+
 /**
  * Constructor of the static camera.
  */
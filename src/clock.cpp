@@ -0,0 +1,162 @@
+/**
+ * Implementation of the frame clock.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "clock.h"
+#include <string.h>
+
+using namespace GEngine;
+using namespace std::chrono;
+
+/**
+ * Constructor of the clock, starts counting from now.
+ */
+Clock::Clock()
+{
+    reset();
+}
+
+/**
+ * Restarts the clock, so the total time and the frames are counted from now.
+ */
+void
+Clock::reset()
+{
+    start = last = steady_clock::now();
+    delta = total = 0;
+    frames = 0;
+    fps = 0.0;
+    head = 0;
+    memset(history, 0, sizeof(history));
+}
+
+/**
+ * Marks the beginning of a new frame, updating the delta, the total time, the counter
+ * of frames, the FPS and the history.
+ */
+void
+Clock::tick()
+{
+    steady_clock::time_point current = steady_clock::now();
+
+    delta = duration_cast<nanoseconds>(current - last).count();
+    total = duration_cast<nanoseconds>(current - start).count();
+    last = current;
+
+    /* The first frame has no previous one to be compared with. */
+    if (frames++ == 0)
+        return;
+
+    history[head] = delta;
+    head = (head + 1) % CLOCK_HISTORY;
+
+    if (delta > 0) {
+        if (fps == 0.0)
+            fps = 1e9 / delta;
+        else
+            fps += CLOCK_FPS_ALPHA * (1e9 / delta - fps);
+    }
+}
+
+/**
+ * Gets the duration of the last frame.
+ * @return  The duration in milliseconds.
+ */
+double
+Clock::getDelta() const
+{
+    return delta / 1e6;
+}
+
+/**
+ * Gets the time since the clock was reset until the last tick.
+ * @return  The time in milliseconds.
+ */
+double
+Clock::getTotal() const
+{
+    return total / 1e6;
+}
+
+/**
+ * Gets the duration of the last frame.
+ * @return  The duration in nanoseconds.
+ */
+long long
+Clock::getDeltaNs() const
+{
+    return delta;
+}
+
+/**
+ * Gets the time since the clock was reset until the last tick.
+ * @return  The time in nanoseconds.
+ */
+long long
+Clock::getTotalNs() const
+{
+    return total;
+}
+
+/**
+ * Gets the number of ticks since the reset.
+ * @return  The number of frames.
+ */
+unsigned long long
+Clock::getFrames() const
+{
+    return frames;
+}
+
+/**
+ * Gets the frames per second, smoothed with an exponential moving average.
+ * @return  The smoothed FPS.
+ */
+double
+Clock::getFPS() const
+{
+    return fps;
+}
+
+/**
+ * Copies the last frame times into the given array, from the oldest to the newest.
+ * @param   double      * times     The array where the times (in milliseconds) are copied.
+ * @param   unsigned    count       The size of the array.
+ * @return  The number of frame times copied.
+ */
+unsigned
+Clock::getFrameTimes(double * times, unsigned count) const
+{
+    unsigned available, idx, pos;
+
+    if (times == NULL)
+        return 0;
+
+    available = frames > CLOCK_HISTORY ? CLOCK_HISTORY : (frames > 0 ? frames - 1 : 0);
+    if (count > available)
+        count = available;
+
+    /* The oldest requested frame is "count" positions before the head. */
+    pos = (head + CLOCK_HISTORY - count) % CLOCK_HISTORY;
+    for (idx = 0; idx < count; idx++) {
+        times[idx] = history[pos] / 1e6;
+        pos = (pos + 1) % CLOCK_HISTORY;
+    }
+
+    return count;
+}
+
+/**
+ * Gets the current time of the monotonic clock.
+ * @return  The time in nanoseconds from an undefined origin.
+ */
+long long
+Clock::now()
+{
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,407 @@
+/**
+ * Implementation of the command buffers.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "command.h"
+#include "profiler.h"
+#include "stats.h"
+
+using namespace GEngine;
+
+/**
+ * Adds a new command at the end of the buffer.
+ * @param   Type    type    The type of the command.
+ * @return  The command added, to fill its fields.
+ */
+RenderCommand&
+CommandBuffer::push(RenderCommand::Type type)
+{
+    RenderCommand cmd = RenderCommand();
+
+    cmd.type = type;
+    commands.push_back(cmd);
+
+    return commands.back();
+}
+
+/**
+ * Records the start of a frame. The parameters are copied, so they can change before the
+ * buffer is executed.
+ * @param   GLuint  position[2]     The position of the viewport.
+ * @param   GLuint  screen[3]       The dimensions of the viewport.
+ * @param   GLfloat bgcolor[3]      The background color.
+ * @param   GLfloat fgcolor[3]      The foreground color.
+ */
+void
+CommandBuffer::beginFrame(const GLuint position[2], const GLuint screen[3],
+        const GLfloat bgcolor[3], const GLfloat fgcolor[3])
+{
+    RenderCommand& cmd = push(RenderCommand::BEGIN_FRAME);
+
+    cmd.first = frameInts.size();
+    cmd.count = frameColors.size();
+
+    frameInts.insert(frameInts.end(), position, position + 2);
+    frameInts.insert(frameInts.end(), screen, screen + 3);
+    frameColors.insert(frameColors.end(), bgcolor, bgcolor + 3);
+    frameColors.insert(frameColors.end(), fgcolor, fgcolor + 3);
+}
+
+/**
+ * Records the end of a frame.
+ */
+void
+CommandBuffer::endFrame()
+{
+    push(RenderCommand::END_FRAME);
+}
+
+/**
+ * Records the activation of a camera.
+ * @param   Camera  * cam   The camera.
+ */
+void
+CommandBuffer::activateCamera(Camera * cam)
+{
+    push(RenderCommand::ACTIVATE_CAMERA).camera = cam;
+}
+
+/**
+ * Records the deactivation of a camera.
+ * @param   Camera  * cam   The camera.
+ */
+void
+CommandBuffer::deactivateCamera(Camera * cam)
+{
+    push(RenderCommand::DEACTIVATE_CAMERA).camera = cam;
+}
+
+/**
+ * Records the ambient light.
+ * @param   GLfloat ambient[4]  The RGBA ambient light.
+ */
+void
+CommandBuffer::setAmbient(const GLfloat ambient[4])
+{
+    RenderCommand& cmd = push(RenderCommand::SET_AMBIENT);
+
+    for (unsigned idx = 0; idx < 4; idx++)
+        cmd.color[idx] = ambient[idx];
+}
+
+/**
+ * Records the upload of a light.
+ * @param   Light   * light     The light.
+ */
+void
+CommandBuffer::setLight(Light * light)
+{
+    push(RenderCommand::SET_LIGHT).light = light;
+}
+
+/**
+ * Records a change of the polygon mode.
+ * @param   GLenum  face    The faces affected.
+ * @param   GLenum  mode    The mode.
+ */
+void
+CommandBuffer::setPolygonMode(GLenum face, GLenum mode)
+{
+    RenderCommand& cmd = push(RenderCommand::SET_POLYGON_MODE);
+
+    cmd.face = face;
+    cmd.mode = mode;
+}
+
+/**
+ * Records the activation of a material.
+ * @param   Material    * mat   The material.
+ */
+void
+CommandBuffer::setMaterial(Material * mat)
+{
+    push(RenderCommand::SET_MATERIAL).material = mat;
+}
+
+/**
+ * Records the deactivation of a material.
+ * @param   Material    * mat   The material.
+ */
+void
+CommandBuffer::unsetMaterial(Material * mat)
+{
+    push(RenderCommand::UNSET_MATERIAL).material = mat;
+}
+
+/**
+ * Records a matrix multiplied into the modelview. The matrix is copied.
+ * @param   GLfloat matrix[16]  The matrix, stored by columns.
+ */
+void
+CommandBuffer::pushMatrix(const GLfloat matrix[16])
+{
+    RenderCommand& cmd = push(RenderCommand::PUSH_MATRIX);
+
+    cmd.first = matrices.size();
+    cmd.count = 1;
+
+    matrices.insert(matrices.end(), matrix, matrix + 16);
+}
+
+/**
+ * Records the restore of the modelview.
+ */
+void
+CommandBuffer::popMatrix()
+{
+    push(RenderCommand::POP_MATRIX);
+}
+
+/**
+ * Starts recording a draw.
+ * @param   GLenum  mode    The kind of primitive.
+ */
+void
+CommandBuffer::begin(GLenum mode)
+{
+    RenderCommand& cmd = push(RenderCommand::DRAW);
+
+    cmd.mode = mode;
+    cmd.first = vertices.size();
+}
+
+/**
+ * Records a vertex of the current draw.
+ * @param   GLdouble    x, y, z     The coordinates of the vertex.
+ * @param   GLdouble    s, t        The texture coordinates of the vertex.
+ */
+void
+CommandBuffer::vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s, GLdouble t)
+{
+    CommandVertex vert = { x, y, z, s, t };
+
+    vertices.push_back(vert);
+}
+
+/**
+ * Finishes the current draw.
+ */
+void
+CommandBuffer::end()
+{
+    RenderCommand& cmd = commands.back();
+
+    cmd.count = vertices.size() - cmd.first;
+}
+
+/**
+ * Records the draw of the geometry of a static figure. The geometry is not copied.
+ * @param   GeometryBuffer  * geometry  The geometry to draw.
+ */
+void
+CommandBuffer::drawStatic(GeometryBuffer * geometry)
+{
+    push(RenderCommand::DRAW_STATIC).geometry = geometry;
+}
+
+/**
+ * Records the draw of several instances of a geometry. The matrices are copied, the
+ * geometry is not.
+ * @param   GeometryBuffer  * geometry  The geometry to draw.
+ * @param   GLfloat     * matrices  The matrices of the instances, 16 floats by columns each.
+ * @param   unsigned    count       The number of instances.
+ */
+void
+CommandBuffer::drawInstanced(GeometryBuffer * geometry, const GLfloat * matrices,
+        unsigned count)
+{
+    RenderCommand& cmd = push(RenderCommand::DRAW_INSTANCED);
+
+    cmd.geometry = geometry;
+    cmd.first = this->matrices.size();
+    cmd.count = count;
+
+    this->matrices.insert(this->matrices.end(), matrices, matrices + count * 16);
+}
+
+/**
+ * A buffer has no pixels to read.
+ * @return  Always false.
+ */
+bool
+CommandBuffer::readPixels(GLuint width, GLuint height, unsigned char * pixels)
+{
+    return false;
+}
+
+/**
+ * Removes all the commands. The memory is kept, so recording the next frame does not
+ * allocate again.
+ */
+void
+CommandBuffer::clear()
+{
+    commands.clear();
+    vertices.clear();
+    frameInts.clear();
+    frameColors.clear();
+    matrices.clear();
+}
+
+/**
+ * Adds the commands of another buffer after the ones of this one.
+ * @param   CommandBuffer   other   The buffer to append.
+ */
+void
+CommandBuffer::append(const CommandBuffer& other)
+{
+    append(other, 0, other.commands.size());
+}
+
+/**
+ * Adds some of the commands of another buffer after the ones of this one, with the
+ * vertices and the frame parameters they use.
+ * @param   CommandBuffer   other   The buffer to append.
+ * @param   unsigned        first   The first command to append.
+ * @param   unsigned        last    The command after the last one to append.
+ */
+void
+CommandBuffer::append(const CommandBuffer& other, unsigned first, unsigned last)
+{
+    RenderCommandList::const_iterator cmd, end = other.commands.begin() + last;
+
+    for (cmd = other.commands.begin() + first; cmd != end; cmd++) {
+        commands.push_back(*cmd);
+
+        /* The indices of the command refer to the arrays of the other buffer. */
+        if (cmd->type == RenderCommand::DRAW) {
+            commands.back().first = vertices.size();
+            vertices.insert(vertices.end(), other.vertices.begin() + cmd->first,
+                    other.vertices.begin() + cmd->first + cmd->count);
+        } else if (cmd->type == RenderCommand::BEGIN_FRAME) {
+            commands.back().first = frameInts.size();
+            commands.back().count = frameColors.size();
+            frameInts.insert(frameInts.end(), other.frameInts.begin() + cmd->first,
+                    other.frameInts.begin() + cmd->first + 5);
+            frameColors.insert(frameColors.end(), other.frameColors.begin() + cmd->count,
+                    other.frameColors.begin() + cmd->count + 6);
+        } else if (cmd->type == RenderCommand::PUSH_MATRIX ||
+                cmd->type == RenderCommand::DRAW_INSTANCED) {
+            commands.back().first = matrices.size();
+            matrices.insert(matrices.end(), other.matrices.begin() + cmd->first,
+                    other.matrices.begin() + cmd->first + cmd->count * 16);
+        }
+    }
+}
+
+/**
+ * Submits the commands to a renderer, in the order they were recorded. The draws and the
+ * vertices are counted for the frame here, since it is when they reach the renderer.
+ * @param   Renderer    * rend  The renderer.
+ */
+void
+CommandBuffer::execute(Renderer * rend) const
+{
+    RenderCommandList::const_iterator cmd;
+    const CommandVertex * vert, * last;
+
+    PROFILE_SCOPE("CommandBuffer::execute");
+
+    for (cmd = commands.begin(); cmd != commands.end(); cmd++) {
+        switch (cmd->type) {
+            case RenderCommand::BEGIN_FRAME:
+                rend->beginFrame(&frameInts[cmd->first], &frameInts[cmd->first + 2],
+                        &frameColors[cmd->count], &frameColors[cmd->count + 3]);
+                break;
+            case RenderCommand::END_FRAME:
+                rend->endFrame();
+                break;
+            case RenderCommand::ACTIVATE_CAMERA:
+                rend->activateCamera(cmd->camera);
+                break;
+            case RenderCommand::DEACTIVATE_CAMERA:
+                rend->deactivateCamera(cmd->camera);
+                break;
+            case RenderCommand::SET_AMBIENT:
+                rend->setAmbient(cmd->color);
+                break;
+            case RenderCommand::SET_LIGHT:
+                rend->setLight(cmd->light);
+                break;
+            case RenderCommand::SET_POLYGON_MODE:
+                rend->setPolygonMode(cmd->face, cmd->mode);
+                break;
+            case RenderCommand::SET_MATERIAL:
+                rend->setMaterial(cmd->material);
+                break;
+            case RenderCommand::UNSET_MATERIAL:
+                rend->unsetMaterial(cmd->material);
+                break;
+            case RenderCommand::PUSH_MATRIX:
+                rend->pushMatrix(&matrices[cmd->first]);
+                break;
+            case RenderCommand::POP_MATRIX:
+                rend->popMatrix();
+                break;
+            case RenderCommand::DRAW:
+                rend->begin(cmd->mode);
+                last = vertices.data() + cmd->first + cmd->count;
+                for (vert = vertices.data() + cmd->first; vert != last; vert++)
+                    rend->vertex(vert->x, vert->y, vert->z, vert->s, vert->t);
+                rend->end();
+
+                RenderStats::frame.drawCalls++;
+                RenderStats::frame.vertices += cmd->count;
+                break;
+            case RenderCommand::DRAW_STATIC:
+                rend->drawStatic(cmd->geometry);
+
+                RenderStats::frame.drawCalls += cmd->geometry->getCalls();
+                RenderStats::frame.vertices += cmd->geometry->getIndexCount();
+                break;
+            case RenderCommand::DRAW_INSTANCED:
+                rend->drawInstanced(cmd->geometry, &matrices[cmd->first], cmd->count);
+
+                RenderStats::frame.drawCalls += cmd->geometry->getDrawCount();
+                RenderStats::frame.vertices +=
+                    cmd->geometry->getIndexCount() * cmd->count;
+                RenderStats::frame.instances += cmd->count;
+                break;
+        }
+    }
+}
+
+/**
+ * Gets the recorded commands.
+ * @return  The commands.
+ */
+const RenderCommandList&
+CommandBuffer::getCommands() const
+{
+    return commands;
+}
+
+/**
+ * Gets the vertices of the recorded draws.
+ * @return  The vertices.
+ */
+const CommandVertexList&
+CommandBuffer::getVertices() const
+{
+    return vertices;
+}
+
+/**
+ * Gets the matrices of the recorded commands.
+ * @return  The matrices, 16 floats each.
+ */
+const std::vector<GLfloat>&
+CommandBuffer::getMatrices() const
+{
+    return matrices;
+}
@@ -0,0 +1,170 @@
+/**
+ * This file contains the display functions for the offscreen backend, which draws the
+ * scene with OpenGL into a pbuffer of EGL, without any window system. With the surfaceless
+ * platform of Mesa it runs on the CPU with llvmpipe, so the real GL path can be used on
+ * machines without X nor GPU.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "display.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace GEngine;
+
+Display *Display::theDisplay = NULL;
+
+/* The EGL objects, there is only one offscreen surface for the main display. */
+static EGLDisplay   eglDisplay = EGL_NO_DISPLAY;
+static EGLSurface   eglSurface = EGL_NO_SURFACE;
+static EGLContext   eglContext = EGL_NO_CONTEXT;
+
+/**
+ * Releases the EGL objects when the program finishes.
+ */
+static void
+eglRelease()
+{
+    if (eglDisplay == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (eglContext != EGL_NO_CONTEXT)
+        eglDestroyContext(eglDisplay, eglContext);
+    if (eglSurface != EGL_NO_SURFACE)
+        eglDestroySurface(eglDisplay, eglSurface);
+    eglTerminate(eglDisplay);
+
+    eglDisplay = EGL_NO_DISPLAY;
+}
+
+/**
+ * Opens the EGL display, preferring the surfaceless platform of Mesa which does not need
+ * any window system nor device.
+ */
+void
+Display::displayInit()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay;
+    EGLint major, minor;
+
+    if (eglDisplay != EGL_NO_DISPLAY)
+        return;
+
+    getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != NULL)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY,
+                NULL);
+    if (eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)) {
+        fprintf(stderr, "EGL: cannot open a display (0x%x)\n", eglGetError());
+        eglDisplay = EGL_NO_DISPLAY;
+        return;
+    }
+
+    atexit(eglRelease);
+}
+
+/**
+ * A pbuffer has no back buffer, so the frame is only finished, which makes the clock
+ * measure the work done by GL and not only its submission.
+ */
+void
+Display::SwapBuffers()
+{
+    glFinish();
+    eglSwapBuffers(eglDisplay, eglSurface);
+}
+
+/**
+ * Without a window, the FPS and the counters of the last frame go to the standard output.
+ */
+void
+Display::drawOverlay()
+{
+    printStats();
+}
+
+/**
+ * Creates the offscreen context and draws the number of frames set with setFrames(), or
+ * forever if it is 0. The context is kept, so the last frame can be read with
+ * readPixels() or saveFrame().
+ *
+ * @return int  Returns 0 on success, -1 if the context cannot be created.
+ */
+int
+Display::print()
+{
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE,   EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE,   8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE,  8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+#ifdef WITH_GL3
+    /* The renderer needs a 3.3 core context, without the fixed function pipeline. */
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR,  3,
+        EGL_CONTEXT_MINOR_VERSION_KHR,  3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+#else
+    const EGLint * contextAttribs = NULL;
+#endif
+    const EGLint surfaceAttribs[] = {
+        EGL_WIDTH,  (EGLint) screen[0],
+        EGL_HEIGHT, (EGLint) screen[1],
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint count;
+    unsigned frame;
+
+    if (eglDisplay == EGL_NO_DISPLAY)
+        return -1;
+
+    /* Both pipelines need the desktop OpenGL API. */
+    if (eglContext == EGL_NO_CONTEXT) {
+        if (!eglBindAPI(EGL_OPENGL_API) ||
+                !eglChooseConfig(eglDisplay, configAttribs, &config, 1, &count) ||
+                count == 0) {
+            fprintf(stderr, "EGL: no configuration for a pbuffer (0x%x)\n", eglGetError());
+            return -1;
+        }
+
+        eglSurface = eglCreatePbufferSurface(eglDisplay, config, surfaceAttribs);
+        eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+        if (eglSurface == EGL_NO_SURFACE || eglContext == EGL_NO_CONTEXT ||
+                !eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext)) {
+            fprintf(stderr, "EGL: cannot create the context (0x%x)\n", eglGetError());
+            return -1;
+        }
+
+#ifdef WITH_GL3
+        renderer = new GL3Renderer();
+#else
+        renderer = new GLRenderer();
+#endif
+        initGL();
+    }
+
+    clock.reset();
+    for (frame = 0; frames == 0 || frame < frames; frame++)
+        idleRender();
+
+    return 0;
+}
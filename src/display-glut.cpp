@@ -9,7 +9,12 @@
  */
 
 #include "display.h"
+#include "glstate.h"
 #include <GL/glut.h>
+#include <stdio.h>
+
+#define OVERLAY_FONT        GLUT_BITMAP_8_BY_13
+#define OVERLAY_LINE_HEIGHT 13
 
 using namespace GEngine;
 
@@ -37,6 +42,51 @@ Display::SwapBuffers()
 {
     glutSwapBuffers();
 }
+/**
+ * Prints the FPS and the render counters of the last frame on the top left corner of
+ * the window.
+ */
+void
+Display::drawOverlay()
+{
+    char text[512];
+    const char * chr;
+    int len, line = 1;
+
+    len = snprintf(text, sizeof(text), "FPS: %.1f\n", theDisplay->clock.getFPS());
+    theDisplay->lastStats.format(text + len, sizeof(text) - len);
+
+    /* The text is not affected by the lights, the textures nor the depth. */
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_DEPTH_TEST);
+
+    /* Using the window coordinates. */
+    GLState::matrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, theDisplay->screen[0], 0, theDisplay->screen[1], -1, 1);
+    GLState::matrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glColor3fv(theDisplay->fgcolor);
+    glRasterPos2i(4, theDisplay->screen[1] - OVERLAY_LINE_HEIGHT);
+    for (chr = text; *chr != '\0'; chr++) {
+        if (*chr == '\n')
+            glRasterPos2i(4, theDisplay->screen[1] - OVERLAY_LINE_HEIGHT * (++line));
+        else
+            glutBitmapCharacter(OVERLAY_FONT, *chr);
+    }
+
+    glPopMatrix();
+    GLState::matrixMode(GL_PROJECTION);
+    glPopMatrix();
+    GLState::matrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
 /**
  * Prints everything on the screen.
  *
@@ -60,6 +110,11 @@ Display::print()
     glutDisplayFunc(&Display::displayFunc);
     glutIdleFunc(&Display::idleRender);
 
+#ifdef WITH_GL3
+    renderer = new GL3Renderer();
+#else
+    renderer = new GLRenderer();
+#endif
     initGL();
 	/* Main loop should be on the GEngine class when finished. */
 	glutMainLoop();
@@ -0,0 +1,75 @@
+/**
+ * This file contains the display functions for the null backend, which has no window nor
+ * OpenGL. It runs the scene for a fixed number of frames and reports the time spent and
+ * the work submitted, to benchmark the engine without the driver.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "display.h"
+#include <stdio.h>
+
+using namespace GEngine;
+
+Display *Display::theDisplay = NULL;
+
+/**
+ * There is no window system to initialize.
+ */
+void
+Display::displayInit()
+{
+}
+
+/**
+ * There are no buffers to swap.
+ */
+void
+Display::SwapBuffers()
+{
+}
+
+/**
+ * Without a window, the FPS and the counters of the last frame go to the standard output.
+ */
+void
+Display::drawOverlay()
+{
+    printStats();
+}
+
+/**
+ * Runs the scene for the number of frames set with setFrames(), or forever if it is 0,
+ * and prints a summary of the run.
+ *
+ * @return int  Returns 0 on success.
+ */
+int
+Display::print()
+{
+    NullRenderer * counter = new NullRenderer();
+    unsigned frame;
+    long long start;
+    double elapsed;
+    char text[512];
+
+    delete renderer;
+    renderer = counter;
+
+    clock.reset();
+    start = Clock::now();
+    for (frame = 0; frames == 0 || frame < frames; frame++)
+        idleRender();
+    elapsed = (Clock::now() - start) / 1e6;
+
+    counter->getTotal().format(text, sizeof(text));
+    printf("%llu frames in %.3f ms (%.3f ms/frame, %.1f FPS), checksum %g\n%s",
+            counter->getFrames(), elapsed,
+            frame > 0 ? elapsed / frame : 0.0, elapsed > 0.0 ? frame * 1e3 / elapsed : 0.0,
+            counter->getChecksum(), text);
+
+    return 0;
+}
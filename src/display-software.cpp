@@ -0,0 +1,61 @@
+/**
+ * This file contains the display functions for the software backend, which draws the
+ * scene with the CPU into a framebuffer in memory, without any window nor GPU.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "display.h"
+#include "raster.h"
+
+using namespace GEngine;
+
+Display *Display::theDisplay = NULL;
+
+/**
+ * There is no window system to initialize.
+ */
+void
+Display::displayInit()
+{
+}
+
+/**
+ * The rasterizer draws straight into the framebuffer, so there is nothing to swap.
+ */
+void
+Display::SwapBuffers()
+{
+}
+
+/**
+ * Without a window, the FPS and the counters of the last frame go to the standard output.
+ */
+void
+Display::drawOverlay()
+{
+    printStats();
+}
+
+/**
+ * Draws the number of frames set with setFrames(), or forever if it is 0.
+ *
+ * @return int  Returns 0 on success.
+ */
+int
+Display::print()
+{
+    unsigned frame;
+
+    if (renderer == NULL)
+        renderer = new Rasterizer(screen[0], screen[1]);
+
+    clock.reset();
+    for (frame = 0; frames == 0 || frame < frames; frame++)
+        idleRender();
+
+    return 0;
+}
@@ -8,14 +8,12 @@
  * $Id$
  */
 #include "display.h"
+#include "profiler.h"
+#include "glstate.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
 #include <stdlib.h>
-#include <sys/time.h>
-
-
-static struct timeval current;
 
 using namespace GEngine;
 using namespace GEngine::Geometry;
@@ -51,13 +49,19 @@ Display::Display(GLuint width, GLuint height, GLuint depth, GLuint x, GLuint y)
     title = NULL;
 
     scene = NULL;
+    map = NULL;
+    renderer = NULL;
+    frames = 0;
+
+    overlay = false;
+    lastStats.reset();
 
     if (theDisplay == NULL) {
 		/* OS initialization. */
         displayInit();
 
 		theDisplay = this;
-        gettimeofday(&current, NULL);
+        clock.reset();
 	}
 }
 
@@ -68,6 +72,8 @@ Display::~Display()
 {
 	if (title != NULL)
 		free(title);
+
+    delete renderer;
 }
 
 /**
@@ -76,18 +82,35 @@ Display::~Display()
 void
 Display::displayFunc()
 {
+    Renderer * rend = theDisplay->renderer;
+
+    PROFILE_SCOPE("Display::displayFunc");
+
+    if (rend == NULL)
+        return;
+
     /* Cleans the screen. */
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glViewport(theDisplay->position[0], theDisplay->position[1],
-            theDisplay->screen[0], theDisplay->screen[1]);
-    glColor3f(theDisplay->fgcolor[0], theDisplay->fgcolor[1], theDisplay->fgcolor[2]);
+    rend->beginFrame(theDisplay->position, theDisplay->screen,
+            theDisplay->bgcolor, theDisplay->fgcolor);
 
     /* Prints the figures of the list. */
-        if (theDisplay->scene != NULL)
-            theDisplay->scene->print();
+        if (theDisplay->map != NULL)
+            theDisplay->map->print(rend);
+        else if (theDisplay->scene != NULL)
+            theDisplay->scene->print(rend);
+
+    /* Prints the counters of the last frame over the scene. */
+    if (theDisplay->overlay)
+        drawOverlay();
+
+    rend->endFrame();
 
     /* Swaps the buffers so the printing will be visible. */
     SwapBuffers();
+
+    /* Keeps the counters of this frame and starts the ones of the next. */
+    theDisplay->lastStats = RenderStats::frame;
+    RenderStats::frame.reset();
 }
 
 /**
@@ -145,31 +168,41 @@ Display::setTitle(const char * _title)
     return title != NULL;
 }
 
+#ifndef NO_GL
 /**
  * Initialize the GL functions before printing.
  */
 void
 Display::initGL()
 {
+    /* The context is new, so its capabilities are queried and nothing is cached. */
+    GLState::init();
+
     /* Enabling Lighting, textures and depth. */
-    glEnable(GL_DEPTH);
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_LINE_SMOOTH);
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::enable(GL_LINE_SMOOTH);
+#ifndef WITH_GL3
+    /* The core profile lights in its shaders and has no fixed matrices. */
+    GLState::enable(GL_TEXTURE_2D);
     glShadeModel(GL_SMOOTH);
-    glEnable(GL_LIGHTING);
+    GLState::enable(GL_LIGHTING);
     glLightModelf(GL_LIGHT_MODEL_COLOR_CONTROL, GL_SEPARATE_SPECULAR_COLOR);
     glLightModelf(GL_LIGHT_MODEL_LOCAL_VIEWER, 1.0);
     glLightModelf(GL_LIGHT_MODEL_TWO_SIDE, 1.0);
+#endif
     
     /* Setting the background color. */
     glClearColor(bgcolor[0], bgcolor[1], bgcolor[2], 0.0f);
 
+#ifndef WITH_GL3
     /* Setting the initial modelview and projection matrices. */
-    glMatrixMode(GL_MODELVIEW);
+    GLState::matrixMode(GL_PROJECTION);
     glLoadIdentity();
-    glMatrixMode(GL_PROJECTION);
+    GLState::matrixMode(GL_MODELVIEW);
     glLoadIdentity();
+#endif
 }
+#endif
 
 /**
  * Sets the scene to display.
@@ -184,23 +217,135 @@ Display::setScene(Scene * sc)
     scene = sc;
 }
 
+/**
+ * Sets the map to display. Its scenes are printed instead of the scene set before.
+ * @param   Map     * mp    The map which should be displayed.
+ */
+void
+Display::setMap(Map * mp)
+{
+    map = mp;
+}
+
+/**
+ * Gets the clock of the display, with the timing of the frames.
+ * @return  The clock of the display.
+ */
+const Clock *
+Display::getClock() const
+{
+    return &clock;
+}
+
+/**
+ * Gets the render counters of the last frame drawn.
+ * @return  The counters of the frame.
+ */
+const RenderStats&
+Display::stats() const
+{
+    return lastStats;
+}
+
+/**
+ * Prints the FPS and the counters of the last frame to the standard output, the overlay
+ * of the backends without a window.
+ */
+void
+Display::printStats()
+{
+    char text[512];
+
+    theDisplay->lastStats.format(text, sizeof(text));
+    printf("Frame %llu (%.1f FPS)\n%s", theDisplay->clock.getFrames(),
+            theDisplay->clock.getFPS(), text);
+}
+
+/**
+ * Shows or hides the render counters of the last frame over the scene.
+ * @param   bool    show    Whether the counters must be shown.
+ */
+void
+Display::showStats(bool show)
+{
+    overlay = show;
+}
+
+/**
+ * Sets the number of frames drawn by print() on the backends without a window. On the
+ * windowed ones, print() runs until the window is closed.
+ * @param   unsigned    count   The number of frames, 0 to draw forever.
+ */
+void
+Display::setFrames(unsigned count)
+{
+    frames = count;
+}
+
+/**
+ * Copies the last frame drawn.
+ * @param   unsigned char   * pixels    The buffer for the RGBA pixels, at least
+ *                                      width * height * 4 bytes, from the bottom row.
+ * @return  Whether the frame could be read.
+ */
+bool
+Display::readPixels(unsigned char * pixels)
+{
+    if (renderer == NULL || pixels == NULL)
+        return false;
+
+    return renderer->readPixels(screen[0], screen[1], pixels);
+}
+
+/**
+ * Saves the last frame drawn into a binary PPM file.
+ * @param   char    * file  The path of the file.
+ * @return  Whether the file could be written.
+ */
+bool
+Display::saveFrame(const char * file)
+{
+    unsigned char * pixels;
+    FILE * out;
+    unsigned row, col;
+    bool done = false;
+
+    pixels = (unsigned char *) malloc(screen[0] * screen[1] * 4);
+    if (pixels == NULL)
+        return false;
+
+    if (readPixels(pixels) && (out = fopen(file, "wb")) != NULL) {
+        fprintf(out, "P6\n%u %u\n255\n", screen[0], screen[1]);
+
+        /* The PPM rows go from the top to the bottom. */
+        for (row = screen[1]; row > 0; row--)
+            for (col = 0; col < screen[0]; col++)
+                fwrite(pixels + ((row - 1) * screen[0] + col) * 4, 1, 3, out);
+
+        done = fclose(out) == 0;
+    }
+
+    free(pixels);
+    return done;
+}
+
 /**
  * Renderize the scene as an idle process.
  */
 void
 Display::idleRender()
 {
-    struct timeval now;
-    time_t millis;
-    
-    gettimeofday(&now, NULL);
+    theDisplay->clock.tick();
 
-    millis = (now.tv_sec - current.tv_sec) * 1000 + (now.tv_usec - current.tv_usec) / 1000;
-
-    if (theDisplay->scene != NULL)
-        theDisplay->scene->idle(millis);
+    if (theDisplay->map != NULL)
+        theDisplay->map->idle(theDisplay->clock.getTotal());
+    else if (theDisplay->scene != NULL)
+        theDisplay->scene->idle(theDisplay->clock.getTotal());
 
     displayFunc();
+
+    /* The frame is finished, close the capture of the profiler if needed. */
+    Profiler::frameMark();
 }
 
 
@@ -9,9 +9,14 @@
 
 
 #include "geometry.h"
+#include "world.h"
+#include "profiler.h"
+#include "command.h"
+#include "matrix.h"
 #include <math.h>
 #include <GL/glut.h>
 #include <string.h>
+#include <algorithm>
 
 #define POINT_PREC  1800.0f /* 10 points per grad. */
 #define PI  M_PI
@@ -29,6 +34,9 @@ Figure::Figure()
     material = NULL;
     memset(angle, 0, sizeof(GLfloat) * 3);
     memset(org, 0, sizeof(int) * 3);
+    faces = NULL;
+    bounded = false;
+    shaped = false;
 }
 
 Figure::Figure(const Figure& fig)
@@ -37,6 +45,9 @@ Figure::Figure(const Figure& fig)
 	mode = fig.mode;
     memcpy(angle, fig.angle, 3 * sizeof(GLfloat));
 	memcpy(org, fig.org, 2* sizeof(int));
+    faces = NULL;
+    bounded = false;
+    shaped = false;
 
     if (fig.material != NULL)
         material = fig.material;
@@ -44,6 +55,155 @@ Figure::Figure(const Figure& fig)
         material = NULL;
 }
 
+/**
+ * Destructor, deleting the faces printed for the bounds if they were not recorded.
+ */
+Figure::~Figure()
+{
+    clearFaces();
+}
+
+/**
+ * Deletes the faces printed for the bounds and not recorded.
+ */
+void
+Figure::clearFaces()
+{
+    FaceList::iterator  faceIt;
+
+    if (faces == NULL)
+        return;
+
+    for (faceIt = faces->begin(); faceIt != faces->end(); faceIt++)
+        delete *faceIt;
+    delete faces;
+    faces = NULL;
+}
+
+/**
+ * Finds the box of the faces as print() gives them, with the z axis inverted. The faces
+ * are kept for the next record().
+ */
+void
+Figure::boundFaces()
+{
+    FaceList::iterator      faceIt;
+    PointList::iterator     pointIter;
+    double                  in[3];
+    unsigned                axis;
+
+    clearFaces();
+    faces = print();
+
+    for (axis = 0; axis < 3; axis++) {
+        faceBox[axis] = HUGE_VAL;
+        faceBox[axis + 3] = - HUGE_VAL;
+    }
+
+    for (faceIt = faces->begin(); faceIt != faces->end(); faceIt++) {
+        for (pointIter = (*faceIt)->vertex->begin(); pointIter != (*faceIt)->vertex->end();
+                pointIter++) {
+            in[0] = (*pointIter)->x;
+            in[1] = (*pointIter)->y;
+            in[2] = - (*pointIter)->z;
+            for (axis = 0; axis < 3; axis++) {
+                faceBox[axis] = std::min(faceBox[axis], in[axis]);
+                faceBox[axis + 3] = std::max(faceBox[axis + 3], in[axis]);
+            }
+        }
+    }
+
+    /* A figure without vertices is bounded by a single point. */
+    if (faceBox[0] > faceBox[3]) {
+        for (axis = 0; axis < 3; axis++)
+            faceBox[axis] = faceBox[axis + 3] = 0.0;
+    }
+
+    shaped = true;
+}
+
+/**
+ * Calculates the box and the sphere bounding the faces, as they are given to the
+ * renderers: with the z axis inverted and rotated by the matrix of the figure. The box
+ * is the one of the corners of the box of the faces rotated, and the sphere is centered
+ * on it. The faces are only printed to find their box the first time and after
+ * reshape(); otherwise only the corners are rotated, so the figures culled are never
+ * printed, and record() prints the ones seen.
+ */
+void
+Figure::updateBounds()
+{
+    GLfloat                 matrix[16];
+    double                  view[16], in[4], out[4];
+    unsigned                axis, corner;
+
+    if (!shaped)
+        boundFaces();
+
+    getMatrix(matrix);
+    for (corner = 0; corner < 16; corner++)
+        view[corner] = matrix[corner];
+
+    for (axis = 0; axis < 3; axis++) {
+        bounds[axis] = HUGE_VAL;
+        bounds[axis + 3] = - HUGE_VAL;
+    }
+    for (corner = 0; corner < 8; corner++) {
+        for (axis = 0; axis < 3; axis++)
+            in[axis] = faceBox[axis + ((corner >> axis) & 1) * 3];
+        in[3] = 1.0;
+        mat4Transform(view, in, out);
+        for (axis = 0; axis < 3; axis++) {
+            bounds[axis] = std::min<GLfloat>(bounds[axis], out[axis]);
+            bounds[axis + 3] = std::max<GLfloat>(bounds[axis + 3], out[axis]);
+        }
+    }
+
+    /* The rotation keeps the distances, so the radius is the one of the faces. */
+    for (axis = 0; axis < 3; axis++)
+        in[axis] = (faceBox[axis] + faceBox[axis + 3]) / 2;
+    in[3] = 1.0;
+    mat4Transform(view, in, out);
+    for (axis = 0; axis < 3; axis++)
+        sphere[axis] = out[axis];
+    sphere[3] = sqrt((faceBox[3] - faceBox[0]) * (faceBox[3] - faceBox[0]) +
+            (faceBox[4] - faceBox[1]) * (faceBox[4] - faceBox[1]) +
+            (faceBox[5] - faceBox[2]) * (faceBox[5] - faceBox[2])) / 2;
+
+    bounded = true;
+}
+
+/**
+ * Marks the faces as changed, dropping the ones printed, so the next updateBounds()
+ * prints them and finds their box again.
+ */
+void
+Figure::reshape()
+{
+    clearFaces();
+    shaped = false;
+}
+
+/**
+ * Gets the box bounding the figure when updateBounds() was called.
+ * @return  The minimum and maximum x, y and z, or NULL if it was never called.
+ */
+const GLfloat *
+Figure::getBounds() const
+{
+    return bounded ? bounds : NULL;
+}
+
+/**
+ * Gets the sphere bounding the figure when updateBounds() was called.
+ * @return  The center and the radius, or NULL if it was never called.
+ */
+const GLfloat *
+Figure::getSphere() const
+{
+    return bounded ? sphere : NULL;
+}
+
 /**
  * Defining the function to set the solid color into the Figure.
  */
@@ -64,6 +224,26 @@ Figure::getMode()
 	return mode;
 }
 
+/**
+ * Returns the material of the figure.
+ * @return  The material, or NULL if the figure is wired.
+ */
+GEngine::Material *
+Figure::getMaterial() const
+{
+    return material;
+}
+
+/**
+ * Returns whether the figure is solid.
+ * @return  True if setSolid() was called.
+ */
+bool
+Figure::isSolid() const
+{
+    return solid;
+}
+
 /**
  * Rotates a figure so many angles as defined.
  * @param	GLfloat	yaw	    The angle for the yaw of the figure.
@@ -78,6 +258,37 @@ Figure::rotate(GLfloat yaw, GLfloat pitch, GLfloat roll)
 	angle[2] = roll * M_PI / 180.0f;
 }
 
+/**
+ * Gets the matrix rotating the figure around its origin by its roll, pitch and yaw, in
+ * the coordinates of the renderers: the z axis is inverted, so the rotations around the
+ * x and y axes go the other way.
+ * @param   GLfloat matrix[16]  The matrix, stored by columns.
+ * @return  False if the figure is not rotated and the matrix is the identity.
+ */
+bool
+Figure::getMatrix(GLfloat matrix[16]) const
+{
+    double res[16], step[16];
+
+    if (angle[0] == 0.0f && angle[1] == 0.0f && angle[2] == 0.0f) {
+        mat4Identity(res);
+        for (unsigned idx = 0; idx < 16; idx++)
+            matrix[idx] = res[idx];
+        return false;
+    }
+
+    mat4Translation(org[0], org[1], - org[2], res);
+    mat4Orientation(angle[0] * 180.0 / M_PI, angle[1] * 180.0 / M_PI,
+            angle[2] * 180.0 / M_PI, step);
+    mat4Multiply(res, step, res);
+    mat4Translation(- org[0], - org[1], org[2], step);
+    mat4Multiply(res, step, res);
+
+    for (unsigned idx = 0; idx < 16; idx++)
+        matrix[idx] = res[idx];
+    return true;
+}
+
 /**
  * Sets the material for the figure using a pointer to a material class.
  * @param   Material    mat     The material to use.
@@ -125,29 +336,76 @@ Figure::setMaterialFromRGB(GLubyte red, GLubyte green, GLubyte blue)
 /**
  * Activates the material if set, if not, it will be a wired figure that can be solid.
  * That means that the back faces will not be shown.
+ * @param   Renderer    * rend  The renderer where the figure is going to be drawn.
  */
 void
-Figure::activeMaterial()
+Figure::activeMaterial(Renderer * rend)
 {
     /* Check if the material is set or not. */
     if (material != NULL) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        material->activate();
+        rend->setPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        rend->setMaterial(material);
     } else if (solid) {
-        glPolygonMode(GL_FRONT, GL_LINE);
-        glPolygonMode(GL_BACK, GL_POINT);
+        rend->setPolygonMode(GL_FRONT, GL_LINE);
+        rend->setPolygonMode(GL_BACK, GL_POINT);
     } else
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        rend->setPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 }
 
 /**
  * Deactivates the material if it was set.
+ * @param   Renderer    * rend  The renderer where the figure was drawn.
  */
 void
-Figure::deactivateMaterial()
+Figure::deactivateMaterial(Renderer * rend)
 {
     if (material != NULL)
-        material->deactivate();
+        rend->unsetMaterial(material);
+}
+
+/**
+ * Prints the faces of the figure through a renderer, without its material. The z axis
+ * of the figures points to the viewer, so it is inverted. The faces are not rotated, the
+ * rotation of the figure is given to the renderer as a matrix.
+ * @param   Renderer    * rend  The renderer receiving the faces.
+ */
+void
+Figure::record(Renderer * rend)
+{
+    FaceList                * faces;
+    FaceList::iterator      faceIt;
+    PointList::iterator     pointIter;
+    GLfloat                 matrix[16];
+    bool                    rotated;
+
+    /* The faces printed for the bounds are the current ones. */
+    if (this->faces != NULL) {
+        faces = this->faces;
+        this->faces = NULL;
+    } else
+        faces = print();
+
+    rotated = getMatrix(matrix);
+    if (rotated)
+        rend->pushMatrix(matrix);
+
+    /* Going through each of the faces. */
+    for (faceIt = faces->begin(); faceIt != faces->end(); faceIt++) {
+        rend->begin(mode);
+
+        /* Printing the points. */
+        for (pointIter = (*faceIt)->vertex->begin(); pointIter != (*faceIt)->vertex->end(); pointIter++){
+            rend->vertex((*pointIter)->x, (*pointIter)->y, - (*pointIter)->z,
+                    (*pointIter)->s, (*pointIter)->t);
+        }
+
+        rend->end();
+        delete *faceIt;
+    }
+    delete faces;
+
+    if (rotated)
+        rend->popMatrix();
 }
 
 /**
@@ -162,6 +420,7 @@ Figure::operator = (const Figure& fig)
 	mode = fig.mode;
     memcpy(angle, fig.angle, 3 * sizeof(GLfloat));
 	memcpy(org, fig.org, 2 * sizeof(int));
+    reshape();
 
 	return * this;
 }
@@ -175,6 +434,82 @@ StaticFigure::motion(double time_stamp)
 {
 }
 
+/**
+ * Constructor of the static figures, the geometry is built when it is needed.
+ */
+StaticFigure::StaticFigure()
+{
+    geometry = NULL;
+    edited = false;
+    batch = NULL;
+}
+
+/**
+ * Copies a static figure. The copy builds its own geometry, and is in no batch.
+ * @param   StaticFigure    fig     The figure to copy.
+ */
+StaticFigure::StaticFigure(const StaticFigure& fig) : Figure(fig)
+{
+    geometry = NULL;
+    edited = false;
+    batch = NULL;
+}
+
+/**
+ * Destructor of the static figures.
+ */
+StaticFigure::~StaticFigure()
+{
+    delete geometry;
+}
+
+/**
+ * Gets the geometry of the figure. It is built from the faces the first time, and again
+ * only if the figure was edited.
+ * @return  The geometry of the figure.
+ */
+GEngine::GeometryBuffer *
+StaticFigure::getGeometry()
+{
+    CommandBuffer faces;
+
+    if (geometry != NULL && !edited)
+        return geometry;
+
+    if (geometry == NULL)
+        geometry = new GeometryBuffer();
+
+    record(&faces);
+    geometry->build(faces);
+    edited = false;
+
+    return geometry;
+}
+
+/**
+ * Marks the figure as edited, so the geometry is built and uploaded again the next time
+ * it is drawn. Once its scene is finalized, the figure is drawn from a copy of its
+ * geometry in a batch, which is marked to be joined again before the next frame.
+ */
+void
+StaticFigure::edit()
+{
+    reshape();
+    edited = true;
+    if (batch != NULL)
+        batch->dirty = true;
+}
+
+/**
+ * Sets the batch joining the figure, so it is joined again when the figure is edited.
+ * @param   StaticBatch * batch     The batch, NULL when the figure leaves it.
+ */
+void
+StaticFigure::setBatch(StaticBatch * batch)
+{
+    this->batch = batch;
+}
+
 /**
  * Constructor of the face.
  */
@@ -193,69 +528,6 @@ Face::~Face()
     delete normal;
 }
 
-/**
- * Applies the transformations to the face and returns the new one.
- * @param GLint     center[3]   The center of the face.
- * @param GLfloat   angles[3]   The angles of rotation.
- * @return  The new face.
- */
-Face *
-Face::transform(GLint center[3], GLfloat angles[3])
-{
-    PointList::iterator     iter;
-    PointList   newVert;
-    Vector<3>  in, out;
-    Matrix<3, 3>  roll, pitch, yaw, rotation;
-        
-    roll.setElement(0, 0, cos(angles[0]));
-    roll.setElement(0, 1, -sin(angles[0]));
-    roll.setElement(0, 2, 0.0);
-    roll.setElement(1, 0, sin(angles[0]));
-    roll.setElement(1, 1, cos(angles[0]));
-    roll.setElement(1, 2, 0.0);
-    roll.setElement(2, 0, 0.0);
-    roll.setElement(2, 1, 0.0);
-    roll.setElement(2, 1, 1.0);
-    pitch.setElement(0, 0, cos(angles[1]));
-    pitch.setElement(0, 1, 0.0);
-    pitch.setElement(0, 2, sin(angles[1]));
-    pitch.setElement(1, 0, 0.0);
-    pitch.setElement(1, 1, 1.0);
-    pitch.setElement(1, 2, 0.0);
-    pitch.setElement(2, 0, -sin(angles[1]));
-    pitch.setElement(2, 1, 0.0);
-    pitch.setElement(2, 2, cos(angles[1]));
-    yaw.setElement(0, 0, 1.0);
-    yaw.setElement(0, 1, 0.0);
-    yaw.setElement(0, 2, 0.0);
-    yaw.setElement(1, 0, 0.0);
-    yaw.setElement(1, 1, cos(angles[2]));
-    yaw.setElement(1, 2, -sin(angles[2]));
-    yaw.setElement(2, 0, 0.0);
-    yaw.setElement(2, 1, sin(angles[2])); 
-    yaw.setElement(2, 2, cos(angles[2]));
-                    
-
-    /* Setting the rotation matrix. */
-    rotation = roll * yaw * pitch;
-#ifdef DEBUG
-//    rotation.print();
-#endif
-    /* Going through all the points of the face. */
-    for (iter = vertex->begin(); iter != vertex->end(); iter++) {
-        in = Vector<3>();
-        in.setElement(0, (*iter)->x - center[0]);
-        in.setElement(1, (*iter)->y - center[1]);
-        in.setElement(2, (*iter)->z - center[2]);
-        out = rotation * in;
-
-        newVert.push_back(new Point(out[0] + center[0], out[1] + center[1], 
-                    out[2] + center[2], (*iter)->s, (*iter)->t));
-    }
-    out = rotation * (*normal);
-
-    return new Face(&newVert, &out);
-}
 /**
  * Constructor of the 2D Point class.
  *
@@ -386,10 +658,12 @@ Arc::Arc(Point c, Point s, GLfloat a)
 FaceList *
 Arc::print()
 {
+    PROFILE_SCOPE("Arc::print");
+
     Vector<3> dir((double *)Z_dir);
     FaceList * list = new FaceList();
 
-    list->push_back(Face(&vertices, &dir).transform(org, angle));
+    list->push_back(new Face(&vertices, &dir));
 
     return list;
 }
@@ -447,10 +721,12 @@ Segment::Segment(Point sp, Point ep)
 FaceList *
 Segment::print()
 {
+    PROFILE_SCOPE("Segment::print");
+
     FaceList * list = new FaceList();
     Vector<3> dir((double *) Z_dir);
 
-    list->push_back(Face(&vertices, &dir).transform(org, angle));
+    list->push_back(new Face(&vertices, &dir));
 
     return list;
 }
@@ -521,10 +797,12 @@ Polygon::getOrigin()
 FaceList *
 Polygon::print()
 {
+    PROFILE_SCOPE("Polygon::print");
+
     FaceList * list = new FaceList();
     Vector<3> dir((double *) Z_dir);
 
-    list->push_back(Face(&vertices, &dir).transform(org, angle));
+    list->push_back(new Face(&vertices, &dir));
     return list;
 }
 
@@ -585,10 +863,12 @@ EllArc::EllArc(Point cen, Point st, GLfloat a, GLfloat b, GLfloat ang)
 FaceList *
 EllArc::print()
 {
+    PROFILE_SCOPE("EllArc::print");
+
     FaceList *list = new FaceList();
     Vector<3> dir((double *) Z_dir);
     
-    list->push_back(Face(&vertices, &dir).transform(org, angle));
+    list->push_back(new Face(&vertices, &dir));
 
     return list;
 }
@@ -8,6 +8,7 @@
  */
 
 #include "geometry.h"
+#include "profiler.h"
 #include <math.h>
 #include <GL/glut.h>
 #ifdef DEBUG
@@ -212,9 +213,12 @@ Polyhedron::print()
     FaceList * printing = new FaceList();
     FaceList::iterator iter;
 
-    /* Going through the list of points and copy them into the new list. */
+    PROFILE_SCOPE("Polyhedron::print");
+
+    /* Going through the list of faces and copy them into the new list, the rotation is
+     * applied by the renderer. */
     for (iter = faces.begin(); iter != faces.end(); iter++) {
-        printing->push_back((*iter)->transform(org, angle));
+        printing->push_back(new Face((*iter)->vertex, (*iter)->normal));
     }
 
     return printing;
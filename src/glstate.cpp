@@ -0,0 +1,390 @@
+/**
+ * Implementation of the cache of the state of OpenGL.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "glstate.h"
+#include "renderer.h"
+#include "stats.h"
+#include <GL/glext.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace GEngine;
+
+GLint GLState::maxLights = GLSTATE_LIGHTS;
+bool GLState::instancing = false;
+bool GLState::persistent = false;
+GLenum GLState::polyMode[2] = { 0, 0 };
+GLenum GLState::matMode = 0;
+GLfloat GLState::matParams[6][4];
+GLfloat GLState::lightParams[GLSTATE_LIGHTS][8][4];
+GLfloat GLState::ambient[4];
+unsigned GLState::known = 0;
+unsigned GLState::lightsKnown[GLSTATE_LIGHTS];
+GLenum GLState::caps[GLSTATE_CAPS];
+bool GLState::capsOn[GLSTATE_CAPS];
+unsigned GLState::numCaps = 0;
+
+/**
+ * Gets the position of a material property in the cache.
+ * @param   GLenum  pname   The property.
+ * @return  The position, or -1 if it is not cached.
+ */
+static int
+matIndex(GLenum pname)
+{
+    switch (pname) {
+        case GL_AMBIENT:        return 0;
+        case GL_DIFFUSE:        return 1;
+        case GL_SPECULAR:       return 2;
+        case GL_EMISSION:       return 3;
+        case GL_SHININESS:      return 4;
+        case GL_COLOR_INDEXES:  return 5;
+        default:                return -1;
+    }
+}
+
+/**
+ * Gets the position of a light parameter in the cache. The position and the direction of
+ * the spot are not cached, since OpenGL transforms them with the current modelview.
+ * @param   GLenum  pname   The parameter.
+ * @return  The position, or -1 if it is not cached.
+ */
+static int
+lightIndex(GLenum pname)
+{
+    switch (pname) {
+        case GL_AMBIENT:                return 0;
+        case GL_DIFFUSE:                return 1;
+        case GL_SPECULAR:               return 2;
+        case GL_SPOT_EXPONENT:          return 3;
+        case GL_SPOT_CUTOFF:            return 4;
+        case GL_CONSTANT_ATTENUATION:   return 5;
+        case GL_LINEAR_ATTENUATION:     return 6;
+        case GL_QUADRATIC_ATTENUATION:  return 7;
+        default:                        return -1;
+    }
+}
+
+/**
+ * Gets the number of values of a material property or a light parameter.
+ * @param   GLenum  pname   The property or parameter.
+ * @return  The number of values.
+ */
+static unsigned
+paramSize(GLenum pname)
+{
+    switch (pname) {
+        case GL_AMBIENT:
+        case GL_DIFFUSE:
+        case GL_SPECULAR:
+        case GL_EMISSION:
+            return 4;
+        case GL_COLOR_INDEXES:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Looks for an extension of the current context, with the list of OpenGL 3.0.
+ * @param   char    * name  The name of the extension.
+ * @return  Whether the context has it.
+ */
+static bool
+hasExtension(const char * name)
+{
+#ifndef NO_GL
+    GLint count = 0;
+
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint idx = 0; idx < count; idx++) {
+        if (strcmp((const char *) glGetStringi(GL_EXTENSIONS, idx), name) == 0)
+            return true;
+    }
+#endif
+
+    return false;
+}
+
+/**
+ * Queries the capabilities of the current context and forgets the state cached, since it
+ * belongs to a previous context. It must be called once the context is current.
+ */
+void
+GLState::init()
+{
+    const char * version = NULL;
+    int major = 0, minor = 0;
+
+    GL_CALL(version = (const char *) glGetString(GL_VERSION));
+#ifdef WITH_GL3
+    /* The core profile has no fixed lights, the renderer keeps its own. */
+    maxLights = GL3_MAX_LIGHTS;
+#else
+    GL_CALL(glGetIntegerv(GL_MAX_LIGHTS, &maxLights));
+#endif
+
+    /* The instanced draws and the divisors of the attributes are core since 3.3. */
+    if (version != NULL)
+        sscanf(version, "%d.%d", &major, &minor);
+    instancing = major > 3 || (major == 3 && minor >= 3);
+
+    /* The persistent mappings need glBufferStorage, core since 4.4, and the fences. */
+    persistent = major > 4 || (major == 4 && minor >= 4) ||
+        ((major > 3 || (major == 3 && minor >= 2)) && hasExtension("GL_ARB_buffer_storage"));
+
+    invalidate();
+}
+
+/**
+ * Forgets all the state cached, so the next calls will be issued.
+ */
+void
+GLState::invalidate()
+{
+    polyMode[0] = polyMode[1] = 0;
+    matMode = 0;
+    known = 0;
+    memset(lightsKnown, 0, sizeof(lightsKnown));
+    numCaps = 0;
+}
+
+/**
+ * Gets the number of lights supported by the context.
+ * @return  The value queried by init(), or the minimum of OpenGL before it.
+ */
+GLint
+GLState::getMaxLights()
+{
+    return maxLights;
+}
+
+/**
+ * Returns whether the buffers can be mapped while they are drawn, so the vertices are
+ * written straight into them.
+ * @return  The value queried by init(), false before it.
+ */
+bool
+GLState::hasPersistentMapping()
+{
+    return persistent;
+}
+
+/**
+ * Returns whether the context can draw instances, with glDrawElementsInstanced and the
+ * divisors of the attributes.
+ * @return  The value queried by init(), false before it.
+ */
+bool
+GLState::hasInstancing()
+{
+    return instancing;
+}
+
+/**
+ * Compares a cached value with a new one, storing it.
+ * @param   GLfloat * cached    The value in the cache.
+ * @param   GLfloat * value     The new value.
+ * @param   unsigned size       The number of values.
+ * @return  Whether the value changed.
+ */
+bool
+GLState::update(GLfloat * cached, const GLfloat * value, unsigned size)
+{
+    if (memcmp(cached, value, size * sizeof(GLfloat)) == 0)
+        return false;
+
+    memcpy(cached, value, size * sizeof(GLfloat));
+    return true;
+}
+
+/**
+ * Sets the polygon mode, unless it is already set.
+ * @param   GLenum  face    The faces affected (GL_FRONT, GL_BACK or GL_FRONT_AND_BACK).
+ * @param   GLenum  mode    The mode (GL_POINT, GL_LINE or GL_FILL).
+ * @return  Whether glPolygonMode was called.
+ */
+bool
+GLState::polygonMode(GLenum face, GLenum mode)
+{
+    bool front = face != GL_BACK, back = face != GL_FRONT;
+
+    if ((!front || polyMode[0] == mode) && (!back || polyMode[1] == mode)) {
+        RenderStats::frame.stateCallsSkipped++;
+        return false;
+    }
+
+    GL_CALL(glPolygonMode(face, mode));
+    if (front)
+        polyMode[0] = mode;
+    if (back)
+        polyMode[1] = mode;
+
+    return true;
+}
+
+/**
+ * Selects the matrix stack, unless it is already selected.
+ * @param   GLenum  mode    The stack (GL_MODELVIEW, GL_PROJECTION or GL_TEXTURE).
+ * @return  Whether glMatrixMode was called.
+ */
+bool
+GLState::matrixMode(GLenum mode)
+{
+    if (matMode == mode) {
+        RenderStats::frame.stateCallsSkipped++;
+        return false;
+    }
+
+    GL_CALL(glMatrixMode(mode));
+    matMode = mode;
+    return true;
+}
+
+/**
+ * Sets a material property for both faces, unless it is already set.
+ * @param   GLenum  pname   The property.
+ * @param   GLfloat * params    The values of the property.
+ * @return  Whether glMaterialfv was called.
+ */
+bool
+GLState::material(GLenum pname, const GLfloat * params)
+{
+    int idx = matIndex(pname);
+
+    if (idx >= 0) {
+        if (!update(matParams[idx], params, paramSize(pname)) && (known & (1 << idx))) {
+            RenderStats::frame.stateCallsSkipped++;
+            return false;
+        }
+        known |= 1 << idx;
+    }
+
+    GL_CALL(glMaterialfv(GL_FRONT_AND_BACK, pname, params));
+    return true;
+}
+
+/**
+ * Sets a parameter of a light, unless it is already set.
+ * @param   GLenum  light   The light (GL_LIGHT0 + i).
+ * @param   GLenum  pname   The parameter.
+ * @param   GLfloat * params    The values of the parameter.
+ * @return  Whether glLightfv was called.
+ */
+bool
+GLState::light(GLenum light, GLenum pname, const GLfloat * params)
+{
+    unsigned num = light - GL_LIGHT0;
+    int idx = lightIndex(pname);
+
+    if (num < GLSTATE_LIGHTS && idx >= 0) {
+        if (!update(lightParams[num][idx], params, paramSize(pname)) &&
+                (lightsKnown[num] & (1 << idx))) {
+            RenderStats::frame.stateCallsSkipped++;
+            return false;
+        }
+        lightsKnown[num] |= 1 << idx;
+    }
+
+    GL_CALL(glLightfv(light, pname, params));
+    return true;
+}
+
+/**
+ * Sets the ambient light of the light model, unless it is already set.
+ * @param   GLfloat * params    The RGBA ambient light.
+ * @return  Whether glLightModelfv was called.
+ */
+bool
+GLState::lightAmbient(const GLfloat * params)
+{
+    if (!update(ambient, params, 4) && (known & (1 << 6))) {
+        RenderStats::frame.stateCallsSkipped++;
+        return false;
+    }
+    known |= 1 << 6;
+
+    GL_CALL(glLightModelfv(GL_LIGHT_MODEL_AMBIENT, params));
+    return true;
+}
+
+/**
+ * Enables a capability, unless it is already enabled.
+ * @param   GLenum  cap     The capability.
+ * @return  Whether glEnable was called.
+ */
+bool
+GLState::enable(GLenum cap)
+{
+    unsigned idx;
+
+    for (idx = 0; idx < numCaps && caps[idx] != cap; idx++);
+
+    if (idx < numCaps && capsOn[idx]) {
+        RenderStats::frame.stateCallsSkipped++;
+        return false;
+    }
+
+    if (idx == numCaps && numCaps < GLSTATE_CAPS)
+        caps[numCaps++] = cap;
+    if (idx < numCaps)
+        capsOn[idx] = true;
+
+    GL_CALL(glEnable(cap));
+    return true;
+}
+
+/**
+ * Disables a capability, unless it is already disabled.
+ * @param   GLenum  cap     The capability.
+ * @return  Whether glDisable was called.
+ */
+bool
+GLState::disable(GLenum cap)
+{
+    unsigned idx;
+
+    for (idx = 0; idx < numCaps && caps[idx] != cap; idx++);
+
+    if (idx < numCaps && !capsOn[idx]) {
+        RenderStats::frame.stateCallsSkipped++;
+        return false;
+    }
+
+    if (idx == numCaps && numCaps < GLSTATE_CAPS)
+        caps[numCaps++] = cap;
+    if (idx < numCaps)
+        capsOn[idx] = false;
+
+    GL_CALL(glDisable(cap));
+    return true;
+}
+
+/**
+ * Returns whether a capability is enabled, asking the context only if it is not cached.
+ * @param   GLenum  cap     The capability.
+ * @return  Whether it is enabled.
+ */
+bool
+GLState::isEnabled(GLenum cap)
+{
+    unsigned idx;
+
+    for (idx = 0; idx < numCaps && caps[idx] != cap; idx++);
+
+    if (idx < numCaps)
+        return capsOn[idx];
+
+#ifdef NO_GL
+    return false;
+#else
+    return glIsEnabled(cap) == GL_TRUE;
+#endif
+}
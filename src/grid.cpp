@@ -0,0 +1,410 @@
+/**
+ * Implementation of the loose grids.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "grid.h"
+#include "camera.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace GEngine;
+
+/**
+ * Returns whether two boxes overlap.
+ * @param   GLfloat a[6], b[6]  The minimum and maximum x, y and z of the boxes.
+ * @return  Whether they overlap.
+ */
+static bool
+overlaps(const GLfloat a[6], const GLfloat b[6])
+{
+    for (unsigned axis = 0; axis < 3; axis++) {
+        if (a[axis] > b[axis + 3] || a[axis + 3] < b[axis])
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Constructor, a single cell holding everything until the limits are set.
+ */
+Grid::Grid()
+{
+    GLfloat limits[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+    items = 0;
+    setLimits(limits, 1.0f);
+}
+
+/**
+ * Splits a box into cells. The side of the cells is doubled until there are no more than
+ * GRID_MAX_CELLS of them. The items already added are put into their new cells.
+ * @param   GLfloat limits[6]   The minimum and maximum x, y and z of the box.
+ * @param   GLfloat cell        The side of the cells.
+ */
+void
+Grid::setLimits(const GLfloat limits[6], GLfloat cell)
+{
+    unsigned long long total;
+
+    side = cell > 0.0f ? cell : 1.0f;
+    do {
+        total = 1;
+        for (unsigned axis = 0; axis < 3; axis++) {
+            GLfloat extent = limits[axis + 3] - limits[axis];
+
+            origin[axis] = limits[axis];
+            dims[axis] = extent > side ? (unsigned) ceil(extent / side) : 1;
+            total *= dims[axis];
+        }
+        if (total > GRID_MAX_CELLS)
+            side *= 2.0f;
+    } while (total > GRID_MAX_CELLS);
+
+    /* The last cell holds the items larger than a cell. */
+    heads.assign(total + 1, GRID_NONE);
+    counts.assign(total + 1, 0);
+    slots.assign(total + 1, 0);
+    occupied.clear();
+
+    for (unsigned item = 0; item < cells.size(); item++) {
+        if (cells[item] != GRID_NONE)
+            link(item, cellOf(&boxes[item * 6]));
+    }
+}
+
+/**
+ * Gets the cell of a box: the one with its center, clamped to the border of the grid, or
+ * the cell of the large items if it does not fit into a cell.
+ * @param   GLfloat box[6]  The minimum and maximum x, y and z.
+ * @return  The index of the cell.
+ */
+unsigned
+Grid::cellOf(const GLfloat box[6]) const
+{
+    unsigned coord[3];
+    GLfloat pos;
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        if (box[axis + 3] - box[axis] > side)
+            return heads.size() - 1;
+
+        pos = ((box[axis] + box[axis + 3]) / 2 - origin[axis]) / side;
+        if (pos < 0.0f)
+            coord[axis] = 0;
+        else if (pos >= dims[axis])
+            coord[axis] = dims[axis] - 1;
+        else
+            coord[axis] = (unsigned) pos;
+    }
+
+    return (coord[2] * dims[1] + coord[1]) * dims[0] + coord[0];
+}
+
+/**
+ * Gets the box of a cell, grown by half its side, which contains the boxes of all its
+ * items. The cells of the border reach the infinite on their outer side.
+ * @param   unsigned    cell    The index of the cell.
+ * @param   GLfloat     box[6]  The box of the cell.
+ */
+void
+Grid::looseBox(unsigned cell, GLfloat box[6]) const
+{
+    unsigned coord;
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        box[axis] = - GRID_FAR;
+        box[axis + 3] = GRID_FAR;
+    }
+    if (cell == heads.size() - 1)
+        return;
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        coord = cell % dims[axis];
+        cell /= dims[axis];
+
+        if (coord > 0)
+            box[axis] = origin[axis] + (coord - 0.5f) * side;
+        if (coord < dims[axis] - 1)
+            box[axis + 3] = origin[axis] + (coord + 1.5f) * side;
+    }
+}
+
+/**
+ * Gets the cells along an axis whose grown box overlaps a range.
+ * @param   unsigned    axis        The axis.
+ * @param   GLfloat     min, max    The range.
+ * @param   unsigned    range[2]    The first and the last cell.
+ */
+void
+Grid::cellRange(unsigned axis, GLfloat min, GLfloat max, unsigned range[2]) const
+{
+    GLfloat first = ceil((min - origin[axis]) / side - 1.5f);
+    GLfloat last = floor((max - origin[axis]) / side + 0.5f);
+
+    range[0] = first < 0.0f ? 0 : (first >= dims[axis] ? dims[axis] - 1 : first);
+    range[1] = last < 0.0f ? 0 : (last >= dims[axis] ? dims[axis] - 1 : last);
+}
+
+/**
+ * Puts an item at the head of the list of a cell.
+ * @param   unsigned    item    The item.
+ * @param   unsigned    cell    The cell.
+ */
+void
+Grid::link(unsigned item, unsigned cell)
+{
+    cells[item] = cell;
+    prev[item] = GRID_NONE;
+    next[item] = heads[cell];
+    if (heads[cell] != GRID_NONE)
+        prev[heads[cell]] = item;
+    heads[cell] = item;
+
+    if (counts[cell]++ == 0) {
+        slots[cell] = occupied.size();
+        occupied.push_back(cell);
+    }
+}
+
+/**
+ * Takes an item out of the list of its cell.
+ * @param   unsigned    item    The item.
+ */
+void
+Grid::unlink(unsigned item)
+{
+    unsigned cell = cells[item];
+
+    if (prev[item] != GRID_NONE)
+        next[prev[item]] = next[item];
+    else
+        heads[cell] = next[item];
+    if (next[item] != GRID_NONE)
+        prev[next[item]] = prev[item];
+
+    if (--counts[cell] == 0) {
+        occupied[slots[cell]] = occupied.back();
+        slots[occupied.back()] = slots[cell];
+        occupied.pop_back();
+    }
+}
+
+/**
+ * Calls a function for each cell with items which overlaps a region. The cells are taken
+ * from the ones with items when they are fewer than the cells of the region.
+ * @param   GLfloat region[6]   The minimum and maximum x, y and z of the region.
+ * @param   F       func        The function, receiving the index of the cell.
+ */
+template <typename F> void
+Grid::forCells(const GLfloat region[6], F func) const
+{
+    unsigned range[3][2], coord[3], cell, large = heads.size() - 1;
+    unsigned long long total = 1;
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        cellRange(axis, region[axis], region[axis + 3], range[axis]);
+        total *= range[axis][1] - range[axis][0] + 1;
+    }
+
+    if (total > occupied.size()) {
+        for (unsigned idx = 0; idx < occupied.size(); idx++) {
+            cell = occupied[idx];
+            if (cell != large) {
+                coord[0] = cell % dims[0];
+                coord[1] = cell / dims[0] % dims[1];
+                coord[2] = cell / dims[0] / dims[1];
+                if (coord[0] < range[0][0] || coord[0] > range[0][1] ||
+                        coord[1] < range[1][0] || coord[1] > range[1][1] ||
+                        coord[2] < range[2][0] || coord[2] > range[2][1])
+                    continue;
+            }
+            func(cell);
+        }
+        return;
+    }
+
+    for (coord[2] = range[2][0]; coord[2] <= range[2][1]; coord[2]++) {
+        for (coord[1] = range[1][0]; coord[1] <= range[1][1]; coord[1]++) {
+            cell = (coord[2] * dims[1] + coord[1]) * dims[0] + range[0][0];
+            for (coord[0] = range[0][0]; coord[0] <= range[0][1]; coord[0]++, cell++) {
+                if (counts[cell] > 0)
+                    func(cell);
+            }
+        }
+    }
+    if (counts[large] > 0)
+        func(large);
+}
+
+/**
+ * Adds a box to the grid.
+ * @param   GLfloat box[6]  The minimum and maximum x, y and z, or NULL if the item has
+ *                          no box yet; it is found by every query until it is moved.
+ * @return  The handle of the item.
+ */
+unsigned
+Grid::insert(const GLfloat box[6])
+{
+    unsigned item;
+
+    if (!freed.empty()) {
+        item = freed.back();
+        freed.pop_back();
+    } else {
+        item = cells.size();
+        boxes.resize(boxes.size() + 6);
+        cells.push_back(GRID_NONE);
+        next.push_back(GRID_NONE);
+        prev.push_back(GRID_NONE);
+    }
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        boxes[item * 6 + axis] = box != NULL ? box[axis] : - GRID_FAR;
+        boxes[item * 6 + axis + 3] = box != NULL ? box[axis + 3] : GRID_FAR;
+    }
+    link(item, cellOf(&boxes[item * 6]));
+    items++;
+
+    return item;
+}
+
+/**
+ * Changes the box of an item, moving it to another cell only if its center left the one
+ * it was in.
+ * @param   unsigned    item    The handle of the item.
+ * @param   GLfloat     box[6]  The new box.
+ */
+void
+Grid::move(unsigned item, const GLfloat box[6])
+{
+    unsigned cell;
+
+    for (unsigned axis = 0; axis < 6; axis++)
+        boxes[item * 6 + axis] = box[axis];
+
+    cell = cellOf(box);
+    if (cell != cells[item]) {
+        unlink(item);
+        link(item, cell);
+    }
+}
+
+/**
+ * Removes an item.
+ * @param   unsigned    item    The handle of the item.
+ */
+void
+Grid::remove(unsigned item)
+{
+    unlink(item);
+    cells[item] = GRID_NONE;
+    freed.push_back(item);
+    items--;
+}
+
+/**
+ * Removes all the items, keeping the cells.
+ */
+void
+Grid::clear()
+{
+    heads.assign(heads.size(), GRID_NONE);
+    counts.assign(counts.size(), 0);
+    occupied.clear();
+    boxes.clear();
+    cells.clear();
+    next.clear();
+    prev.clear();
+    freed.clear();
+    items = 0;
+}
+
+/**
+ * Gets the items which can be seen through a frustum. Only the cells with items are
+ * tested, and the items of the cells entirely inside it are taken without testing them.
+ * @param   Frustum     frustum     The frustum.
+ * @param   unsigned    * found     The list receiving the handles of the items.
+ */
+void
+Grid::cull(const Frustum& frustum, std::vector<unsigned> * found) const
+{
+    GLfloat box[6];
+    unsigned item;
+    bool inside;
+
+    for (unsigned idx = 0; idx < occupied.size(); idx++) {
+        looseBox(occupied[idx], box);
+        if (!frustum.isBoxVisible(box))
+            continue;
+
+        inside = frustum.isBoxInside(box);
+        for (item = heads[occupied[idx]]; item != GRID_NONE; item = next[item]) {
+            if (inside || frustum.isBoxVisible(&boxes[item * 6]))
+                found->push_back(item);
+        }
+    }
+}
+
+/**
+ * Gets the items whose box overlaps a region.
+ * @param   GLfloat     region[6]   The minimum and maximum x, y and z of the region.
+ * @param   unsigned    * found     The list receiving the handles of the items.
+ */
+void
+Grid::query(const GLfloat region[6], std::vector<unsigned> * found) const
+{
+    forCells(region, [&](unsigned cell) {
+        for (unsigned item = heads[cell]; item != GRID_NONE; item = next[item]) {
+            if (overlaps(&boxes[item * 6], region))
+                found->push_back(item);
+        }
+    });
+}
+
+/**
+ * Gets the items whose box is closer to a point than a radius.
+ * @param   GLfloat     center[3]   The point.
+ * @param   GLfloat     radius      The radius.
+ * @param   unsigned    * found     The list receiving the handles of the items.
+ */
+void
+Grid::queryRadius(const GLfloat center[3], GLfloat radius,
+        std::vector<unsigned> * found) const
+{
+    GLfloat region[6];
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        region[axis] = center[axis] - radius;
+        region[axis + 3] = center[axis] + radius;
+    }
+
+    forCells(region, [&](unsigned cell) {
+        for (unsigned item = heads[cell]; item != GRID_NONE; item = next[item]) {
+            const GLfloat * box = &boxes[item * 6];
+            GLfloat dist = 0.0f, gap;
+
+            for (unsigned axis = 0; axis < 3; axis++) {
+                gap = std::max(box[axis] - center[axis], center[axis] - box[axis + 3]);
+                if (gap > 0.0f)
+                    dist += gap * gap;
+            }
+            if (dist <= radius * radius)
+                found->push_back(item);
+        }
+    });
+}
+
+/**
+ * Gets the number of items in the grid.
+ * @return  The number of items.
+ */
+unsigned
+Grid::size() const
+{
+    return items;
+}
@@ -0,0 +1,127 @@
+/**
+ * Implementation of the mesh assets and their instances.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "instance.h"
+#include "command.h"
+#include "matrix.h"
+
+using namespace GEngine;
+using namespace GEngine::Geometry;
+
+/**
+ * Builds the mesh from the faces of a figure. The instances place the mesh, so the figure
+ * should be at the origin and unrotated; it is not needed after the mesh is built.
+ * @param   Figure  * prototype     The figure with the faces of the mesh.
+ */
+MeshAsset::MeshAsset(Figure * prototype)
+{
+    CommandBuffer cmds;
+
+    prototype->record(&cmds);
+    geometry.build(cmds);
+    solid = prototype->isSolid();
+}
+
+/**
+ * Gets the geometry of the mesh.
+ * @return  The geometry.
+ */
+GeometryBuffer *
+MeshAsset::getGeometry()
+{
+    return &geometry;
+}
+
+/**
+ * Returns whether the prototype of the mesh was solid, the instances without material are
+ * drawn in its polygon mode.
+ * @return  Whether the mesh is solid.
+ */
+bool
+MeshAsset::isSolid() const
+{
+    return solid;
+}
+
+/**
+ * Constructor of an instance at the origin, unrotated.
+ * @param   MeshAsset   * mesh  The mesh of the instance.
+ * @param   Material    * mat   The material of the instance, NULL for none.
+ */
+Instance::Instance(MeshAsset * mesh, Material * mat)
+{
+    this->mesh = mesh;
+    material = mat;
+
+    for (unsigned idx = 0; idx < 3; idx++)
+        org[idx] = angle[idx] = 0.0f;
+}
+
+/**
+ * Rotates the instance, as Figure::rotate() rotates a figure.
+ * @param   GLfloat yaw     The angle around the z axis, in degrees.
+ * @param   GLfloat pitch   The angle around the y axis, in degrees.
+ * @param   GLfloat roll    The angle around the x axis, in degrees.
+ */
+void
+Instance::rotate(GLfloat yaw, GLfloat pitch, GLfloat roll)
+{
+    angle[0] = yaw;
+    angle[1] = pitch;
+    angle[2] = roll;
+}
+
+/**
+ * Sets the material of the instance.
+ * @param   Material    * mat   The material, NULL for none.
+ */
+void
+Instance::setMaterial(Material * mat)
+{
+    material = mat;
+}
+
+/**
+ * Gets the mesh of the instance.
+ * @return  The mesh.
+ */
+MeshAsset *
+Instance::getMesh() const
+{
+    return mesh;
+}
+
+/**
+ * Gets the material of the instance.
+ * @return  The material, or NULL.
+ */
+Material *
+Instance::getMaterial() const
+{
+    return material;
+}
+
+/**
+ * Gets the matrix placing the mesh in the scene: the rotation of a figure with the same
+ * angles, around the origin of the mesh, then the translation to its position. The z axis
+ * of the scene points away from the camera, as in the figures, so it is negated.
+ * @param   GLfloat matrix[16]  The matrix, stored by columns.
+ */
+void
+Instance::getMatrix(GLfloat matrix[16]) const
+{
+    double res[16], rot[16];
+
+    mat4Translation(org[0], org[1], - org[2], res);
+    mat4Orientation(angle[0], angle[1], angle[2], rot);
+    mat4Multiply(res, rot, res);
+
+    for (unsigned idx = 0; idx < 16; idx++)
+        matrix[idx] = res[idx];
+}
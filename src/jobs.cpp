@@ -0,0 +1,236 @@
+/**
+ * Implementation of the pool of worker threads.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "jobs.h"
+#include "profiler.h"
+#include <atomic>
+#include <memory>
+#include <stdio.h>
+
+using namespace GEngine;
+
+JobPool * JobPool::shared = NULL;
+
+/**
+ * Constructor of the pool, starting the workers.
+ * @param   unsigned    threads     The number of workers, 0 to use one less than the
+ *                                  number of hardware threads.
+ */
+JobPool::JobPool(unsigned threads)
+{
+    unsigned idx;
+
+    pending = 0;
+    stopping = false;
+
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        threads = threads > 1 ? threads - 1 : 1;
+    }
+
+    for (idx = 0; idx < threads; idx++)
+        workers.push_back(std::thread(&JobPool::work, this, idx));
+}
+
+/**
+ * Destructor of the pool, it finishes the queued jobs and stops the workers.
+ */
+JobPool::~JobPool()
+{
+    std::vector<std::thread>::iterator iter;
+
+    wait();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+
+    for (iter = workers.begin(); iter != workers.end(); iter++)
+        iter->join();
+}
+
+/**
+ * The loop of the workers, running jobs until the pool is stopped.
+ * @param   unsigned    idx     The index of the worker.
+ */
+void
+JobPool::work(unsigned idx)
+{
+    char name[32];
+    Job job;
+
+    snprintf(name, sizeof(name), "Worker %u", idx);
+    Profiler::setThreadName(name);
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while (jobs.empty() && !stopping)
+                ready.wait(guard);
+
+            if (jobs.empty())
+                return;
+
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        job();
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (--pending == 0)
+            idle.notify_all();
+    }
+}
+
+/**
+ * Queues a job.
+ * @param   Job     job     The function to run.
+ */
+void
+JobPool::submit(Job job)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push_back(job);
+        pending++;
+    }
+    ready.notify_one();
+}
+
+/**
+ * Waits until all the queued jobs, and the ones queued meanwhile, are done.
+ */
+void
+JobPool::wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    while (pending > 0)
+        idle.wait(guard);
+}
+
+/**
+ * The indices of a range, shared with its helpers. A helper can start after the range was
+ * joined, when it was queued behind other jobs; it finds no index left then, so it never
+ * runs the body, whose captures belong to the caller.
+ */
+struct GEngine::JobRange {
+    std::atomic<unsigned>   next;   /* The first index not taken yet. */
+    unsigned                count;
+    unsigned                done;   /* The indices finished, with the lock held. */
+    std::function<void (unsigned)>  body;
+    std::mutex              lock;
+    std::condition_variable finished;
+};
+
+/**
+ * Runs the indices of a range not taken yet, until there are no more.
+ * @param   JobRange    * range The range.
+ */
+static void
+runRange(JobRange * range)
+{
+    unsigned current, finished = 0;
+
+    while ((current = range->next.fetch_add(1)) < range->count) {
+        range->body(current);
+        finished++;
+    }
+
+    if (finished == 0)
+        return;
+
+    std::lock_guard<std::mutex> guard(range->lock);
+    range->done += finished;
+    if (range->done == range->count)
+        range->finished.notify_all();
+}
+
+/**
+ * Runs a function for each index of a range, splitting the indices among the workers and
+ * the calling thread. It returns when all the indices are done.
+ * @param   unsigned    count   The number of indices.
+ * @param   function    body    The function to run for each index.
+ */
+void
+JobPool::parallelFor(unsigned count, std::function<void (unsigned)> body)
+{
+    join(start(count, body));
+}
+
+/**
+ * Starts running a function for each index of a range in the workers, so the calling
+ * thread can do something else until it joins the range.
+ * @param   unsigned    count   The number of indices.
+ * @param   function    body    The function to run for each index, kept until the range
+ *                              is joined.
+ * @return  The range, to be given to join().
+ */
+JobHandle
+JobPool::start(unsigned count, std::function<void (unsigned)> body)
+{
+    JobHandle range = std::make_shared<JobRange>();
+    unsigned helpers, idx;
+
+    range->next = 0;
+    range->count = count;
+    range->done = 0;
+    range->body = body;
+    if (count == 0)
+        return range;
+
+    /* Each helper takes indices until there are no more; the joining thread is one of
+     * them. */
+    helpers = count - 1 < workers.size() ? count - 1 : workers.size();
+    for (idx = 0; idx < helpers; idx++)
+        submit([range]() { runRange(range.get()); });
+
+    return range;
+}
+
+/**
+ * Finishes a range started: the calling thread runs the indices not taken yet, and then
+ * waits for the ones taken by the helpers running. It runs no other job of the pool
+ * meanwhile, so it can be called from a job too.
+ * @param   JobHandle   range   The range.
+ */
+void
+JobPool::join(JobHandle range)
+{
+    runRange(range.get());
+
+    std::unique_lock<std::mutex> guard(range->lock);
+    while (range->done < range->count)
+        range->finished.wait(guard);
+}
+
+/**
+ * Gets the number of workers of the pool.
+ * @return  The number of workers.
+ */
+unsigned
+JobPool::size() const
+{
+    return workers.size();
+}
+
+/**
+ * Gets the pool shared by all the engine, creating it on the first call.
+ * @return  The shared pool.
+ */
+JobPool *
+JobPool::instance()
+{
+    static std::once_flag created;
+
+    std::call_once(created, []() { shared = new JobPool(); });
+    return shared;
+}
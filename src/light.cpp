@@ -7,6 +7,9 @@
 
 #include <GL/gl.h>
 #include "light.h"
+#include "profiler.h"
+#include "stats.h"
+#include "glstate.h"
 //#include <string.h>
 
 using namespace GEngine;
@@ -113,17 +116,20 @@ Light::setAttenuation(float constant, float linear, float cuadratic)
 void
 Light::activate()
 {
-    glLightfv(GL_LIGHT0 + idx, GL_AMBIENT, intA);
-    glLightfv(GL_LIGHT0 + idx, GL_DIFFUSE, intD);
-    glLightfv(GL_LIGHT0 + idx, GL_SPECULAR, intSP);
-    glLightfv(GL_LIGHT0 + idx, GL_POSITION, position);
-    glLightfv(GL_LIGHT0 + idx, GL_SPOT_CUTOFF, &spAng);
-    glLightfv(GL_LIGHT0 + idx, GL_SPOT_DIRECTION, spDir);
-    glLightfv(GL_LIGHT0 + idx, GL_SPOT_EXPONENT, &spExp);
-    glLightfv(GL_LIGHT0 + idx, GL_CONSTANT_ATTENUATION, &atten[0]);
-    glLightfv(GL_LIGHT0 + idx, GL_LINEAR_ATTENUATION, &atten[1]);
-    glLightfv(GL_LIGHT0 + idx, GL_QUADRATIC_ATTENUATION, &atten[2]);
-    glEnable(GL_LIGHT0 + idx);
+    PROFILE_SCOPE("Light::activate");
+
+    GLState::light(GL_LIGHT0 + idx, GL_AMBIENT, intA);
+    GLState::light(GL_LIGHT0 + idx, GL_DIFFUSE, intD);
+    GLState::light(GL_LIGHT0 + idx, GL_SPECULAR, intSP);
+    GLState::light(GL_LIGHT0 + idx, GL_POSITION, position);
+    GLState::light(GL_LIGHT0 + idx, GL_SPOT_CUTOFF, &spAng);
+    GLState::light(GL_LIGHT0 + idx, GL_SPOT_DIRECTION, spDir);
+    GLState::light(GL_LIGHT0 + idx, GL_SPOT_EXPONENT, &spExp);
+    GLState::light(GL_LIGHT0 + idx, GL_CONSTANT_ATTENUATION, &atten[0]);
+    GLState::light(GL_LIGHT0 + idx, GL_LINEAR_ATTENUATION, &atten[1]);
+    GLState::light(GL_LIGHT0 + idx, GL_QUADRATIC_ATTENUATION, &atten[2]);
+    GLState::enable(GL_LIGHT0 + idx);
+    RenderStats::frame.lightUploads++;
 }
 
 /**
@@ -132,6 +138,6 @@ Light::activate()
 void 
 Light::deactivate()
 {
-    glDisable(GL_LIGHT0 + idx);
+    GLState::disable(GL_LIGHT0 + idx);
 }
 
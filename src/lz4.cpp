@@ -0,0 +1,244 @@
+/**
+ * Implementation of the compression of blocks with LZ4.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "lz4.h"
+#include <string.h>
+
+/**
+ * Reads four bytes from anywhere.
+ * @param   unsigned char   * ptr   The bytes.
+ * @return  The bytes as a word.
+ */
+static unsigned
+read32(const unsigned char * ptr)
+{
+    unsigned word;
+
+    memcpy(&word, ptr, sizeof(word));
+    return word;
+}
+
+/**
+ * Gets the entry of the table of the compressor for four bytes.
+ * @param   unsigned    word    The bytes.
+ * @return  The entry.
+ */
+static unsigned
+hash(unsigned word)
+{
+    return (word * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/**
+ * Writes the bytes after a token for a length which does not fit in it.
+ * @param   unsigned char   * out   Where to write them.
+ * @param   size_t          length  The length minus 15.
+ * @return  The end of the bytes written.
+ */
+static unsigned char *
+writeLength(unsigned char * out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = length;
+    return out;
+}
+
+/**
+ * Reads the bytes after a token for a length which does not fit in it.
+ * @param   unsigned char   ** in   The bytes, moved past them.
+ * @param   unsigned char   * end   The end of the block.
+ * @param   size_t          * length    The length, increased by them.
+ * @return  Whether the bytes ended before the block.
+ */
+static bool
+readLength(const unsigned char ** in, const unsigned char * end, size_t * length)
+{
+    unsigned char byte;
+
+    do {
+        if (*in >= end)
+            return false;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+/**
+ * Writes a sequence: its token, its literals and its match, which the last one has not.
+ * @param   unsigned char   * out       Where to write it.
+ * @param   unsigned char   * end       The end of the room to write it.
+ * @param   unsigned char   * literals  The literals.
+ * @param   size_t          litLength   The number of literals.
+ * @param   size_t          offset      How far back the match is, 0 for the last one.
+ * @param   size_t          matchLength The length of the match.
+ * @return  The end of the sequence written, or NULL if it does not fit.
+ */
+static unsigned char *
+writeSequence(unsigned char * out, unsigned char * end, const unsigned char * literals,
+        size_t litLength, size_t offset, size_t matchLength)
+{
+    size_t extra = offset == 0 ? 0 : matchLength - LZ4_MIN_MATCH;
+    unsigned char * token = out;
+
+    if (1 + litLength / 255 + 1 + litLength + 2 + extra / 255 + 1 > (size_t) (end - out))
+        return NULL;
+
+    *out++ = (litLength < 15 ? litLength : 15) << 4;
+    if (litLength >= 15)
+        out = writeLength(out, litLength - 15);
+    memcpy(out, literals, litLength);
+    out += litLength;
+
+    if (offset == 0)
+        return out;
+
+    *out++ = offset & 0xFF;
+    *out++ = offset >> 8;
+    *token |= extra < 15 ? extra : 15;
+    if (extra >= 15)
+        out = writeLength(out, extra - 15);
+    return out;
+}
+
+/**
+ * Gets the largest size a block can take once compressed, when nothing matches.
+ * @param   size_t  size    The size of the block.
+ * @return  The room to compress it.
+ */
+size_t
+lz4Bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+/**
+ * Compresses a block. Each place is looked for in a table of the last place of its first
+ * four bytes; the steps grow the longer nothing matches, so data which does not compress
+ * is gone through quickly.
+ * @param   void    * source    The block, smaller than 4 GiB.
+ * @param   size_t  size        Its size.
+ * @param   void    * dest      Where to write it compressed.
+ * @param   size_t  capacity    The room there, lz4Bound(size) to always fit.
+ * @return  The size of the block compressed, or 0 if it does not fit.
+ */
+size_t
+lz4Compress(const void * source, size_t size, void * dest, size_t capacity)
+{
+    const unsigned char * src = (const unsigned char *) source, * end = src + size;
+    const unsigned char * pos = src, * anchor = src, * ref, * match;
+    unsigned char * out = (unsigned char *) dest, * outEnd = out + capacity;
+    unsigned table[1 << LZ4_HASH_BITS], word, entry;
+
+    memset(table, 0, sizeof(table));
+
+    if (size > LZ4_MF_LIMIT) {
+        const unsigned char * mfLimit = end - LZ4_MF_LIMIT;
+        const unsigned char * matchLimit = end - LZ4_LAST_LITERALS;
+
+        while (pos < mfLimit) {
+            word = read32(pos);
+            entry = hash(word);
+            ref = src + table[entry];
+            table[entry] = pos - src;
+
+            if (ref >= pos || pos - ref > LZ4_MAX_OFFSET || read32(ref) != word) {
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            while (pos > anchor && ref > src && pos[-1] == ref[-1]) {
+                pos--;
+                ref--;
+            }
+            for (match = pos + LZ4_MIN_MATCH, ref += LZ4_MIN_MATCH;
+                    match < matchLimit && *match == *ref; match++, ref++);
+
+            out = writeSequence(out, outEnd, anchor, pos - anchor, match - ref,
+                    match - pos);
+            if (out == NULL)
+                return 0;
+
+            table[hash(read32(match - 2))] = match - 2 - src;
+            anchor = pos = match;
+        }
+    }
+
+    out = writeSequence(out, outEnd, anchor, end - anchor, 0, 0);
+    return out == NULL ? 0 : out - (unsigned char *) dest;
+}
+
+/**
+ * Decompresses a block, checking every length and offset against the block and the room
+ * to write it, so a damaged block gives an error and never writes out of the room.
+ * @param   void    * source    The block compressed.
+ * @param   size_t  size        Its size.
+ * @param   void    * dest      Where to write it.
+ * @param   size_t  capacity    The room there.
+ * @return  The size of the block, or -1 if it is malformed or does not fit.
+ */
+long
+lz4Decompress(const void * source, size_t size, void * dest, size_t capacity)
+{
+    const unsigned char * in = (const unsigned char *) source, * end = in + size;
+    unsigned char * out = (unsigned char *) dest, * outEnd = out + capacity;
+    const unsigned char * match;
+    size_t length, offset;
+    unsigned char token;
+
+    while (in < end) {
+        token = *in++;
+
+        length = token >> 4;
+        if (length == 15 && !readLength(&in, end, &length))
+            return -1;
+        if (length > (size_t) (end - in) || length > (size_t) (outEnd - out))
+            return -1;
+        memcpy(out, in, length);
+        in += length;
+        out += length;
+
+        if (in == end)
+            break;
+
+        if (end - in < 2)
+            return -1;
+        offset = in[0] | in[1] << 8;
+        in += 2;
+        if (offset == 0 || offset > (size_t) (out - (unsigned char *) dest))
+            return -1;
+
+        length = token & 15;
+        if (length == 15 && !readLength(&in, end, &length))
+            return -1;
+        length += LZ4_MIN_MATCH;
+        if (length > (size_t) (outEnd - out))
+            return -1;
+
+        /* The match overlaps what it writes when it is closer than its length, which
+         * repeats its bytes; copying by words is still right if they are 8 apart. */
+        match = out - offset;
+        if (offset >= length) {
+            memcpy(out, match, length);
+            out += length;
+        } else if (offset >= 8) {
+            for (; length >= 8; length -= 8, out += 8, match += 8)
+                memcpy(out, match, 8);
+            while (length-- > 0)
+                *out++ = *match++;
+        } else {
+            while (length-- > 0)
+                *out++ = *match++;
+        }
+    }
+
+    return out - (unsigned char *) dest;
+}
@@ -9,9 +9,14 @@
 
 #include <GL/gl.h>
 #include "material.h"
+#include "profiler.h"
+#include "stats.h"
+#include "glstate.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <atomic>
+#include <mutex>
 
 using namespace GEngine;
 
@@ -41,8 +46,19 @@ static const GLenum matProps[] = {
     GL_SHININESS
 };
 
+/* The initial values of the material properties defined by OpenGL, in the same order as
+ * matProps. They are not queried, so materials can be created without a context. */
+static const GLfloat matValues[][4] = {
+    { 0.2, 0.2, 0.2, 1.0 },
+    { 0.8, 0.8, 0.8, 1.0 },
+    { 0.0, 0.0, 0.0, 1.0 },
+    { 0.0, 0.0, 0.0, 1.0 },
+    { 0.0, 0.0, 0.0, 0.0 }
+};
+
 TextureMap * Texture::texDefs = NULL;
 MaterialMap * Material::matDefs = NULL;
+std::atomic<unsigned> Material::nextId(1);
 
 /**
  * Constructor for the material class.
@@ -50,26 +66,49 @@ MaterialMap * Material::matDefs = NULL;
 Material::Material()
 {
     float * value;
+    int size;
+    MaterialMap::iterator it;
 
-    /* Setting the default material properties. */
-    if (matDefs == NULL) {
-        matDefs = new MaterialMap();
+    /* Setting the default material properties, once: the loaders create materials from
+     * their threads. */
+    static std::once_flag defined;
+
+    std::call_once(defined, []() {
+        float * value;
+        int size;
 
+        matDefs = new MaterialMap();
         for (unsigned idx = 0; idx < (sizeof( matProps ) / sizeof(GLenum)); idx++) {
-            if (matProps[idx] == GL_SHININESS)
-                value = new float[1];
-            else
-                value = new float[4];
+            size = matProps[idx] == GL_SHININESS ? 1 : 4;
+            value = new float[size];
 
             if (value != NULL) {
-                glGetMaterialfv(GL_FRONT, matProps[idx], value);
+                memcpy(value, matValues[idx], size * sizeof(float));
                 (*matDefs)[matProps[idx]] = value;
             }
         }
-    }
+    });
     
-	/* Setting a copy of the default properties for this material. */
+	/* Setting a copy of the default properties for this material. The values are copied
+     * too, since setMatProperty() frees the ones it replaces. */
     material = MaterialMap( *matDefs);
+    for (it = material.begin(); it != material.end(); it++) {
+        size = it->first == GL_SHININESS ? 1 : 4;
+        value = new float[size];
+        memcpy(value, it->second, size * sizeof(float));
+        it->second = value;
+    }
+    id = nextId.fetch_add(1);
+}
+
+/**
+ * Gets the identifier of the material, unique for each material created.
+ * @return  The identifier, starting at 1.
+ */
+unsigned
+Material::getId() const
+{
+    return id;
 }
 
 /**
@@ -81,9 +120,12 @@ Material::activate()
 	TextureMap::iterator props;
     MaterialMap::iterator mats;
 
+    PROFILE_SCOPE("Material::activate");
+
     for (mats = material.begin(); mats != material.end(); mats++) {
-        glMaterialfv(GL_FRONT_AND_BACK, mats->first, mats->second);
+        GLState::material(mats->first, mats->second);
     }
+    RenderStats::frame.materialChanges++;
 }
 
 /**
@@ -95,9 +137,9 @@ Material::deactivate()
 	TextureMap::iterator props;
     GLfloat defs[4] = {0.0, 0.0, 0.0, 1.0};
 
-    glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, defs);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, defs);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_COLOR_INDEXES, defs);
+    GLState::material(GL_SHININESS, defs);
+    GLState::material(GL_EMISSION, defs);
+    GLState::material(GL_COLOR_INDEXES, defs);
 }
 /**
  * Sets the properties of the material derivated from light reflexion and so on.
@@ -128,6 +170,22 @@ Material::setMatProperty(GLenum prop, float * value)
     material[prop] = mat;
 }
 
+/**
+ * Gets the values of a property of the material.
+ * @param   GLenum  prop    The property to get.
+ * @return  The values of the property or NULL if it is not a material property.
+ */
+const GLfloat *
+Material::getMatProperty(GLenum prop) const
+{
+    MaterialMap::const_iterator it = material.find(prop);
+
+    if (it == material.end())
+        return NULL;
+
+    return it->second;
+}
+
 Texture::Texture()
 {
     float * value;
@@ -138,12 +196,12 @@ Texture::Texture()
 
 		for (unsigned idx = 0; idx < (sizeof( props ) / sizeof(GLenum)); idx++) {
 			if (props[idx] == GL_TEXTURE_BORDER_COLOR)
-				value = new float[4];
+				value = new float[4]();
 			else
-				value = new float[1];
+				value = new float[1]();
 
 			if (value != NULL) {
-				glGetTexParameterfv(GL_TEXTURE_2D, props[idx], value);
+				GL_CALL(glGetTexParameterfv(GL_TEXTURE_2D, props[idx], value));
 				(*texDefs)[props[idx]] = value;
 			}
 		}
@@ -153,7 +211,8 @@ Texture::Texture()
 	properties = TextureMap(*texDefs);
 
     /* Generating the texture pointer. */
-	glGenTextures(1, &buffer);
+    buffer = 0;
+	GL_CALL(glGenTextures(1, &buffer));
 }
 
 /**
@@ -194,7 +253,7 @@ Texture::~Texture()
 	if (texture.data != NULL)
 		free( texture.data );
 #endif
-    glDeleteTextures(1, &buffer);
+    GL_CALL(glDeleteTextures(1, &buffer));
 }
 
 /**
@@ -0,0 +1,147 @@
+/**
+ * This file contains the operations over 4x4 matrices stored by columns.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "matrix.h"
+#include <math.h>
+#include <string.h>
+
+/**
+ * Sets the identity matrix.
+ * @param   double  out[16]     The matrix to set.
+ */
+void
+mat4Identity(double out[16])
+{
+    memset(out, 0, 16 * sizeof(double));
+    out[0] = out[5] = out[10] = out[15] = 1.0;
+}
+
+/**
+ * Multiplies two matrices.
+ * @param   double  a[16]   The left matrix.
+ * @param   double  b[16]   The right matrix.
+ * @param   double  out[16] The result of a * b, it can be any of the operands.
+ */
+void
+mat4Multiply(const double a[16], const double b[16], double out[16])
+{
+    double res[16];
+    int row, col;
+
+    for (col = 0; col < 4; col++)
+        for (row = 0; row < 4; row++)
+            res[col * 4 + row] = a[row] * b[col * 4] + a[4 + row] * b[col * 4 + 1] +
+                a[8 + row] * b[col * 4 + 2] + a[12 + row] * b[col * 4 + 3];
+
+    memcpy(out, res, sizeof(res));
+}
+
+/**
+ * Multiplies a matrix by a homogeneous vector.
+ * @param   double  m[16]   The matrix.
+ * @param   double  in[4]   The vector.
+ * @param   double  out[4]  The result of m * in, it can be the input vector.
+ */
+void
+mat4Transform(const double m[16], const double in[4], double out[4])
+{
+    double res[4];
+    int row;
+
+    for (row = 0; row < 4; row++)
+        res[row] = m[row] * in[0] + m[4 + row] * in[1] + m[8 + row] * in[2] + m[12 + row] * in[3];
+
+    memcpy(out, res, sizeof(res));
+}
+
+/**
+ * Builds a translation matrix, as glTranslated.
+ * @param   double  x, y, z     The translation.
+ * @param   double  out[16]     The resulting matrix.
+ */
+void
+mat4Translation(double x, double y, double z, double out[16])
+{
+    mat4Identity(out);
+    out[12] = x;
+    out[13] = y;
+    out[14] = z;
+}
+
+/**
+ * Builds a rotation matrix around an axis, as glRotated.
+ * @param   double  angle       The angle in degrees.
+ * @param   double  x, y, z     The axis of the rotation.
+ * @param   double  out[16]     The resulting matrix.
+ */
+void
+mat4Rotation(double angle, double x, double y, double z, double out[16])
+{
+    double c, s, ic, mod = sqrt(x * x + y * y + z * z);
+
+    mat4Identity(out);
+    if (mod == 0.0)
+        return;
+
+    x /= mod; y /= mod; z /= mod;
+    c = cos(angle * M_PI / 180.0);
+    s = sin(angle * M_PI / 180.0);
+    ic = 1.0 - c;
+
+    out[0] = x * x * ic + c;
+    out[1] = y * x * ic + z * s;
+    out[2] = x * z * ic - y * s;
+    out[4] = x * y * ic - z * s;
+    out[5] = y * y * ic + c;
+    out[6] = y * z * ic + x * s;
+    out[8] = x * z * ic + y * s;
+    out[9] = y * z * ic - x * s;
+    out[10] = z * z * ic + c;
+}
+
+/**
+ * Builds the rotation of a figure: the yaw around the z axis, the pitch around the y
+ * axis and the roll around the x axis. The z axis of the renderers is inverted, so the
+ * rotations around the x and y axes go the other way.
+ * @param   double  yaw, pitch, roll    The angles, in degrees.
+ * @param   double  out[16]     The resulting matrix.
+ */
+void
+mat4Orientation(double yaw, double pitch, double roll, double out[16])
+{
+    double step[16];
+
+    mat4Rotation(yaw, 0.0, 0.0, 1.0, out);
+    mat4Rotation(- roll, 1.0, 0.0, 0.0, step);
+    mat4Multiply(out, step, out);
+    mat4Rotation(- pitch, 0.0, 1.0, 0.0, step);
+    mat4Multiply(out, step, out);
+}
+
+/**
+ * Builds a perspective projection matrix, as glFrustum.
+ * @param   double  left, right     The horizontal limits of the near plane.
+ * @param   double  bottom, top     The vertical limits of the near plane.
+ * @param   double  near, far       The distances to the near and far planes.
+ * @param   double  out[16]         The resulting matrix.
+ */
+void
+mat4Frustum(double left, double right, double bottom, double top,
+        double near, double far, double out[16])
+{
+    memset(out, 0, 16 * sizeof(double));
+
+    out[0] = 2.0 * near / (right - left);
+    out[5] = 2.0 * near / (top - bottom);
+    out[8] = (right + left) / (right - left);
+    out[9] = (top + bottom) / (top - bottom);
+    out[10] = - (far + near) / (far - near);
+    out[11] = -1.0;
+    out[14] = - 2.0 * far * near / (far - near);
+}
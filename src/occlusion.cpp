@@ -0,0 +1,402 @@
+/**
+ * Implementation of the occlusion culling.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "occlusion.h"
+#include "camera.h"
+#include "buffer.h"
+#include "matrix.h"
+#include "jobs.h"
+#include "profiler.h"
+#include <algorithm>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace GEngine;
+
+/**
+ * Gets the width of a level of the chain.
+ * @param   unsigned    level   The level, 0 for the depth buffer.
+ * @return  The pixels of a row.
+ */
+static inline unsigned
+levelWidth(unsigned level)
+{
+    return std::max(OCCLUSION_WIDTH >> level, 1);
+}
+
+/**
+ * Gets the height of a level of the chain.
+ * @param   unsigned    level   The level, 0 for the depth buffer.
+ * @return  The rows.
+ */
+static inline unsigned
+levelHeight(unsigned level)
+{
+    return std::max(OCCLUSION_HEIGHT >> level, 1);
+}
+
+/**
+ * Constructor, without occluders.
+ */
+Occlusion::Occlusion()
+{
+    for (unsigned level = 0; level < OCCLUSION_LEVELS; level++)
+        levels[level].resize(levelWidth(level) * levelHeight(level));
+
+    mat4Identity(clip);
+    active = false;
+}
+
+/**
+ * Destructor, waiting for the occluders being rasterized.
+ */
+Occlusion::~Occlusion()
+{
+    wait();
+}
+
+/**
+ * Starts a frame, forgetting the occluders of the last one, once they are rasterized.
+ * @param   Camera  * cam   The camera whose view is rasterized.
+ */
+void
+Occlusion::begin(const Camera * cam)
+{
+    double view[16], proj[16];
+
+    wait();
+    cam->getModelview(view);
+    cam->getProjection(proj);
+    mat4Multiply(proj, view, clip);
+
+    tris.clear();
+    active = false;
+}
+
+/**
+ * Adds the faces of a geometry as an occluder. The faces are split into triangles and
+ * clipped by the near plane; the points and the lines hide nothing.
+ * @param   GeometryBuffer  * geometry  The geometry, in the coordinates of the camera.
+ */
+void
+Occlusion::addOccluder(const GeometryBuffer * geometry)
+{
+    const BufferVertex * vertices = geometry->getVertices();
+    BufferIndexList faces;
+    std::vector<double> coords(geometry->getVertexCount() * 4);
+    const double * corner[3], * in, * out;
+    double poly[4][4], dist[3], t;
+    unsigned idx, count;
+
+    geometry->getFaces(&faces);
+    for (idx = 0; idx < geometry->getVertexCount(); idx++) {
+        double pos[4] = {vertices[idx].x, vertices[idx].y, vertices[idx].z, 1.0};
+
+        mat4Transform(clip, pos, &coords[idx * 4]);
+    }
+
+    for (idx = 0; idx + 2 < faces.size(); idx += 3) {
+        for (unsigned vert = 0; vert < 3; vert++) {
+            corner[vert] = &coords[faces[idx + vert] * 4];
+            dist[vert] = corner[vert][2] + corner[vert][3];
+        }
+
+        if (dist[0] >= 0.0 && dist[1] >= 0.0 && dist[2] >= 0.0) {
+            addTriangle(corner[0], corner[1], corner[2]);
+            continue;
+        }
+
+        /* The part in front of the near plane, up to four corners. */
+        count = 0;
+        for (unsigned vert = 0; vert < 3; vert++) {
+            unsigned next = (vert + 1) % 3;
+
+            in = corner[vert];
+            out = corner[next];
+            if (dist[vert] >= 0.0)
+                std::copy(in, in + 4, poly[count++]);
+            if ((dist[vert] >= 0.0) != (dist[next] >= 0.0)) {
+                t = dist[vert] / (dist[vert] - dist[next]);
+                for (unsigned comp = 0; comp < 4; comp++)
+                    poly[count][comp] = in[comp] + (out[comp] - in[comp]) * t;
+                count++;
+            }
+        }
+
+        for (unsigned vert = 2; vert < count; vert++)
+            addTriangle(poly[0], poly[vert - 1], poly[vert]);
+    }
+}
+
+/**
+ * Projects a triangle to the depth buffer. The edges are moved inwards half a pixel, so
+ * only the pixels it covers entirely pass, and the depth is moved to the farthest corner
+ * of each pixel, so the depth buffer is never in front of the occluder.
+ * @param   double  a[4], b[4], c[4]    The corners in clip coordinates, with w > 0.
+ */
+void
+Occlusion::addTriangle(const double * a, const double * b, const double * c)
+{
+    const double * corners[3] = {a, b, c};
+    float v[3][3], area;
+    OccluderTri tri;
+
+    for (unsigned vert = 0; vert < 3; vert++) {
+        const double * in = corners[vert];
+
+        v[vert][0] = (in[0] / in[3] * 0.5 + 0.5) * OCCLUSION_WIDTH;
+        v[vert][1] = (in[1] / in[3] * 0.5 + 0.5) * OCCLUSION_HEIGHT;
+        v[vert][2] = in[2] / in[3] * 0.5 + 0.5;
+    }
+
+    area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) - (v[2][0] - v[0][0]) * (v[1][1] - v[0][1]);
+    if (area == 0.0f)
+        return;
+
+    /* Both sides hide, so the triangle is turned counter-clockwise. */
+    if (area < 0.0f) {
+        std::swap(v[1], v[2]);
+        area = -area;
+    }
+
+    tri.A[0] = v[1][1] - v[2][1]; tri.B[0] = v[2][0] - v[1][0];
+    tri.A[1] = v[2][1] - v[0][1]; tri.B[1] = v[0][0] - v[2][0];
+    tri.A[2] = v[0][1] - v[1][1]; tri.B[2] = v[1][0] - v[0][0];
+    tri.C[0] = -(tri.A[0] * v[1][0] + tri.B[0] * v[1][1]);
+    tri.C[1] = -(tri.A[1] * v[2][0] + tri.B[1] * v[2][1]);
+    tri.C[2] = -(tri.A[2] * v[0][0] + tri.B[2] * v[0][1]);
+
+    tri.zA = (tri.A[0] * v[0][2] + tri.A[1] * v[1][2] + tri.A[2] * v[2][2]) / area;
+    tri.zB = (tri.B[0] * v[0][2] + tri.B[1] * v[1][2] + tri.B[2] * v[2][2]) / area;
+    tri.zC = (tri.C[0] * v[0][2] + tri.C[1] * v[1][2] + tri.C[2] * v[2][2]) / area;
+    tri.zC += (fabsf(tri.zA) + fabsf(tri.zB)) * 0.5f;
+
+    for (unsigned edge = 0; edge < 3; edge++)
+        tri.C[edge] -= (fabsf(tri.A[edge]) + fabsf(tri.B[edge])) * 0.5f;
+
+    tri.minx = std::max(0, (int) floorf(std::min(std::min(v[0][0], v[1][0]), v[2][0])));
+    tri.maxx = std::min(OCCLUSION_WIDTH - 1,
+            (int) floorf(std::max(std::max(v[0][0], v[1][0]), v[2][0])));
+    tri.miny = std::max(0, (int) floorf(std::min(std::min(v[0][1], v[1][1]), v[2][1])));
+    tri.maxy = std::min(OCCLUSION_HEIGHT - 1,
+            (int) floorf(std::max(std::max(v[0][1], v[1][1]), v[2][1])));
+    if (tri.minx > tri.maxx || tri.miny > tri.maxy)
+        return;
+
+    /* The rows are processed by groups of four pixels. */
+    tri.minx &= ~3;
+    tris.push_back(tri);
+}
+
+/**
+ * Rasterizes the rows of a triangle between two ones, keeping the nearest depth.
+ * @param   OccluderTri tri     The triangle.
+ * @param   int         y0, y1  The first and the last row.
+ */
+void
+Occlusion::drawTriangle(const OccluderTri& tri, int y0, int y1)
+{
+    std::vector<float>& depth = levels[0];
+    int x, y;
+
+#ifdef __SSE2__
+    const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 vA0 = _mm_set1_ps(tri.A[0]), vA1 = _mm_set1_ps(tri.A[1]);
+    const __m128 vA2 = _mm_set1_ps(tri.A[2]), vzA = _mm_set1_ps(tri.zA);
+    const __m128 vmax = _mm_set1_ps(tri.maxx + 0.5f);
+
+    for (y = y0; y <= y1; y++) {
+        float py = y + 0.5f;
+        const __m128 r0 = _mm_set1_ps(tri.B[0] * py + tri.C[0]);
+        const __m128 r1 = _mm_set1_ps(tri.B[1] * py + tri.C[1]);
+        const __m128 r2 = _mm_set1_ps(tri.B[2] * py + tri.C[2]);
+        const __m128 rz = _mm_set1_ps(tri.zB * py + tri.zC);
+        float * row = &depth[y * OCCLUSION_WIDTH];
+
+        for (x = tri.minx; x <= tri.maxx; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+            __m128 mask, z, old;
+
+            mask = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vA0, px), r0), zero),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vA1, px), r1), zero));
+            mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vA2, px), r2), zero));
+            mask = _mm_and_ps(mask, _mm_cmple_ps(px, vmax));
+            if (_mm_movemask_ps(mask) == 0)
+                continue;
+
+            z = _mm_add_ps(_mm_mul_ps(vzA, px), rz);
+            old = _mm_loadu_ps(row + x);
+            z = _mm_min_ps(z, old);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, old)));
+        }
+    }
+#else
+    for (y = y0; y <= y1; y++) {
+        float py = y + 0.5f;
+        float * row = &depth[y * OCCLUSION_WIDTH];
+
+        for (x = tri.minx; x <= tri.maxx; x++) {
+            float px = x + 0.5f, z;
+
+            if (tri.A[0] * px + tri.B[0] * py + tri.C[0] < 0.0f ||
+                    tri.A[1] * px + tri.B[1] * py + tri.C[1] < 0.0f ||
+                    tri.A[2] * px + tri.B[2] * py + tri.C[2] < 0.0f)
+                continue;
+
+            z = tri.zA * px + tri.zB * py + tri.zC;
+            if (z < row[x])
+                row[x] = z;
+        }
+    }
+#endif
+}
+
+/**
+ * Rasterizes all the triangles touching a band of rows of the depth buffer.
+ * @param   unsigned    band    The band, between 0 and OCCLUSION_BANDS.
+ */
+void
+Occlusion::rasterBand(unsigned band)
+{
+    int y0 = band * OCCLUSION_HEIGHT / OCCLUSION_BANDS;
+    int y1 = (band + 1) * OCCLUSION_HEIGHT / OCCLUSION_BANDS - 1;
+
+    std::fill(levels[0].begin() + y0 * OCCLUSION_WIDTH,
+            levels[0].begin() + (y1 + 1) * OCCLUSION_WIDTH, 1.0f);
+
+    for (unsigned idx = 0; idx < tris.size(); idx++) {
+        const OccluderTri& tri = tris[idx];
+
+        if (tri.maxy >= y0 && tri.miny <= y1)
+            drawTriangle(tri, std::max(tri.miny, y0), std::min(tri.maxy, y1));
+    }
+}
+
+/**
+ * Starts rasterizing the occluders of the frame, each band of rows in a job, so the
+ * calling thread can go on until wait().
+ */
+void
+Occlusion::end()
+{
+    active = !tris.empty();
+    if (!active)
+        return;
+
+    raster = JobPool::instance()->start(OCCLUSION_BANDS, [this](unsigned band) {
+        rasterBand(band);
+    });
+}
+
+/**
+ * Waits for the bands started by end(), rasterizing the ones no worker took yet, and
+ * builds the chain: each pixel of a level keeps the farthest of the four pixels below it.
+ */
+void
+Occlusion::wait()
+{
+    PROFILE_SCOPE("Occlusion::wait");
+
+    if (raster == NULL)
+        return;
+
+    JobPool::instance()->join(raster);
+    raster = NULL;
+
+    for (unsigned level = 1; level < OCCLUSION_LEVELS; level++) {
+        const float * src = levels[level - 1].data();
+        float * dst = levels[level].data();
+        unsigned width = levelWidth(level), height = levelHeight(level);
+        unsigned srcWidth = levelWidth(level - 1), srcHeight = levelHeight(level - 1);
+        unsigned x, y;
+
+        for (y = 0; y < height; y++) {
+            const float * row0 = src + 2 * y * srcWidth;
+            const float * row1 = src + std::min(2 * y + 1, srcHeight - 1) * srcWidth;
+
+            x = 0;
+#ifdef __SSE2__
+            for (; x + 4 <= width; x += 4) {
+                __m128 a = _mm_max_ps(_mm_loadu_ps(row0 + 2 * x), _mm_loadu_ps(row1 + 2 * x));
+                __m128 b = _mm_max_ps(_mm_loadu_ps(row0 + 2 * x + 4),
+                        _mm_loadu_ps(row1 + 2 * x + 4));
+
+                _mm_storeu_ps(dst + y * width + x,
+                        _mm_max_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+                            _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+            }
+#endif
+            for (; x < width; x++)
+                dst[y * width + x] = std::max(std::max(row0[2 * x], row0[2 * x + 1]),
+                        std::max(row1[2 * x], row1[2 * x + 1]));
+        }
+    }
+}
+
+/**
+ * Returns whether a box can be seen. The box is projected to a rectangle of the screen
+ * and its nearest depth, and it is hidden when the farthest depth of the occluders over
+ * the whole rectangle is nearer. The level tested is the first one where the rectangle
+ * covers at most two pixels on each side.
+ * @param   GLfloat box[6]  The minimum and maximum x, y and z.
+ * @return  Whether it can be seen.
+ */
+bool
+Occlusion::isBoxVisible(const GLfloat box[6]) const
+{
+    double pos[4], out[4], min[3], max[3];
+    int x0, x1, y0, y1, x, y;
+    unsigned level, width;
+    float far = 0.0f;
+
+    if (!active)
+        return true;
+
+    for (unsigned corner = 0; corner < 8; corner++) {
+        pos[0] = box[corner & 1 ? 3 : 0];
+        pos[1] = box[corner & 2 ? 4 : 1];
+        pos[2] = box[corner & 4 ? 5 : 2];
+        pos[3] = 1.0;
+        mat4Transform(clip, pos, out);
+
+        /* The boxes reaching the camera are never hidden. */
+        if (out[3] <= 0.0)
+            return true;
+
+        for (unsigned axis = 0; axis < 3; axis++) {
+            out[axis] /= out[3];
+            min[axis] = corner == 0 ? out[axis] : std::min(min[axis], out[axis]);
+            max[axis] = corner == 0 ? out[axis] : std::max(max[axis], out[axis]);
+        }
+    }
+
+    if (min[2] <= -1.0 || min[0] > 1.0 || max[0] < -1.0 || min[1] > 1.0 || max[1] < -1.0)
+        return true;
+
+    x0 = std::max(0, (int) floor((min[0] * 0.5 + 0.5) * OCCLUSION_WIDTH));
+    x1 = std::min(OCCLUSION_WIDTH - 1, (int) floor((max[0] * 0.5 + 0.5) * OCCLUSION_WIDTH));
+    y0 = std::max(0, (int) floor((min[1] * 0.5 + 0.5) * OCCLUSION_HEIGHT));
+    y1 = std::min(OCCLUSION_HEIGHT - 1, (int) floor((max[1] * 0.5 + 0.5) * OCCLUSION_HEIGHT));
+
+    for (level = 0; level + 1 < OCCLUSION_LEVELS; level++) {
+        if ((x1 >> level) - (x0 >> level) <= 1 && (y1 >> level) - (y0 >> level) <= 1)
+            break;
+    }
+
+    width = levelWidth(level);
+    for (y = y0 >> level; y <= y1 >> level; y++) {
+        for (x = x0 >> level; x <= x1 >> level; x++)
+            far = std::max(far, levels[level][y * width + x]);
+    }
+
+    return far >= min[2] * 0.5 + 0.5;
+}
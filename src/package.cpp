@@ -0,0 +1,545 @@
+/**
+ * Implementation of the packages.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "package.h"
+#include "jobs.h"
+#include "lz4.h"
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace GEngine;
+
+/**
+ * An entry being loaded through a reader, freed by the last of its blocks.
+ */
+struct PackageLoad {
+    std::atomic<unsigned>   remaining;  /* The blocks not decompressed yet. */
+    std::atomic<bool>       ok;
+    std::vector<unsigned char>  packed; /* The compressed blocks, as they are read. */
+    PackageCallback         done;
+};
+
+/**
+ * Reads a whole range of a file, going on after the reads cut short.
+ * @param   int     fd      The file.
+ * @param   void    * buffer    Where to read it.
+ * @param   size_t  length  The size of the range.
+ * @param   off_t   offset  Its start.
+ * @return  Whether it was read.
+ */
+static bool
+readAll(int fd, void * buffer, size_t length, off_t offset)
+{
+    unsigned char * out = (unsigned char *) buffer;
+    ssize_t got;
+
+    while (length > 0) {
+        got = pread(fd, out, length, offset);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        out += got;
+        offset += got;
+        length -= got;
+    }
+
+    return true;
+}
+
+/**
+ * Decompresses a block into its place.
+ * @param   PackageBlock    block   The block.
+ * @param   unsigned char   * in    Its bytes in the file.
+ * @param   unsigned char   * out   Its place in the entry.
+ * @return  Whether it was whole.
+ */
+static bool
+unpack(const PackageBlock& block, const unsigned char * in, unsigned char * out)
+{
+    return lz4Decompress(in, block.size, out, block.raw) == (long) block.raw;
+}
+
+/**
+ * Counts a block of a load as done, finishing the load with the last one.
+ * @param   PackageLoad * job   The load.
+ * @param   bool        ok      Whether the block was read.
+ */
+static void
+finish(PackageLoad * job, bool ok)
+{
+    if (!ok)
+        job->ok = false;
+
+    if (--job->remaining == 0) {
+        job->done(job->ok);
+        delete job;
+    }
+}
+
+/**
+ * Constructor, without a file.
+ */
+Package::Package()
+{
+    fd = -1;
+    fileSize = 0;
+}
+
+/**
+ * Destructor, closing the file.
+ */
+Package::~Package()
+{
+    close();
+}
+
+/**
+ * Opens a package, reading its header, its entries, its blocks and its names, which are
+ * next to each other at its start.
+ * @param   char    * path  The path of the package.
+ * @return  Whether it is a package of this version whose blocks are all in the file.
+ */
+bool
+Package::open(const char * path)
+{
+    PackageHeader head;
+    unsigned long long tables;
+    struct stat info;
+
+    PROFILE_SCOPE("Package::open");
+
+    close();
+
+    if ((fd = ::open(path, O_RDONLY)) < 0)
+        return false;
+
+    if (fstat(fd, &info) < 0 || !readAll(fd, &head, sizeof(head), 0) ||
+            head.magic != PACKAGE_MAGIC || head.version != PACKAGE_VERSION) {
+        close();
+        return false;
+    }
+
+    fileSize = info.st_size;
+    tables = sizeof(head) + (unsigned long long) head.entries * sizeof(PackageEntry) +
+        (unsigned long long) head.blocks * sizeof(PackageBlock);
+    if (tables > fileSize || head.names > fileSize || head.namesSize > fileSize -
+            head.names) {
+        close();
+        return false;
+    }
+
+    entries.resize(head.entries);
+    blocks.resize(head.blocks);
+    names.resize(head.namesSize);
+    if (!readAll(fd, entries.data(), entries.size() * sizeof(PackageEntry), sizeof(head)) ||
+            !readAll(fd, blocks.data(), blocks.size() * sizeof(PackageBlock),
+                sizeof(head) + entries.size() * sizeof(PackageEntry)) ||
+            !readAll(fd, names.data(), names.size(), head.names) || !check()) {
+        close();
+        return false;
+    }
+
+    for (unsigned idx = 0; idx < entries.size(); idx++)
+        index[getName(idx)] = idx;
+
+    return true;
+}
+
+/**
+ * Closes the file and forgets its tables.
+ */
+void
+Package::close()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    fileSize = 0;
+    entries.clear();
+    blocks.clear();
+    names.clear();
+    index.clear();
+}
+
+/**
+ * Checks the tables: the names end inside theirs, the blocks of each entry are in the
+ * table, there are as many as its size needs and each one is in the file.
+ * @return  Whether they are right.
+ */
+bool
+Package::check() const
+{
+    unsigned long long count, left;
+
+    if (!names.empty() && names.back() != '\0')
+        return false;
+
+    for (unsigned idx = 0; idx < entries.size(); idx++) {
+        const PackageEntry& entry = entries[idx];
+
+        count = (entry.size + PACKAGE_BLOCK - 1) / PACKAGE_BLOCK;
+        if (entry.name >= names.size() || entry.blockCount != count ||
+                (unsigned long long) entry.firstBlock + count > blocks.size())
+            return false;
+
+        left = entry.size;
+        for (unsigned blk = 0; blk < count; blk++) {
+            const PackageBlock& block = blocks[entry.firstBlock + blk];
+            GLuint size = block.size & ~PACKAGE_STORED;
+
+            if (block.raw != (left < PACKAGE_BLOCK ? left : PACKAGE_BLOCK) ||
+                    (block.size & PACKAGE_STORED && size != block.raw) ||
+                    block.offset > fileSize || size > fileSize - block.offset)
+                return false;
+            left -= block.raw;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Finds an entry by its name.
+ * @param   char    * name  The name.
+ * @return  The entry, or -1 if there is none with that name.
+ */
+int
+Package::find(const char * name) const
+{
+    std::map<std::string, unsigned>::const_iterator it = index.find(name);
+
+    return it == index.end() ? -1 : (int) it->second;
+}
+
+/**
+ * Gets the number of entries.
+ * @return  The entries.
+ */
+unsigned
+Package::getEntries() const
+{
+    return entries.size();
+}
+
+/**
+ * Gets the description of an entry: its size, type and info.
+ * @param   unsigned    entry   The entry.
+ * @return  The description.
+ */
+const PackageEntry&
+Package::getEntry(unsigned entry) const
+{
+    return entries[entry];
+}
+
+/**
+ * Gets the name of an entry.
+ * @param   unsigned    entry   The entry.
+ * @return  The name.
+ */
+const char *
+Package::getName(unsigned entry) const
+{
+    return names.data() + entries[entry].name;
+}
+
+/**
+ * Reads an entry. Each block is read and decompressed by a different iteration of a
+ * parallel loop, in which the calling thread takes part, so it is done even if the
+ * workers are busy.
+ * @param   unsigned    entry   The entry.
+ * @param   void        * dest  Where to write it, with room for its size.
+ * @return  Whether it was read.
+ */
+bool
+Package::read(unsigned entry, void * dest) const
+{
+    const PackageEntry& desc = entries[entry];
+    std::atomic<bool> ok(true);
+
+    PROFILE_SCOPE("Package::read");
+
+    JobPool::instance()->parallelFor(desc.blockCount, [&](unsigned idx) {
+        static thread_local std::vector<unsigned char> packed;
+        const PackageBlock& block = blocks[desc.firstBlock + idx];
+        unsigned char * out = (unsigned char *) dest + (size_t) idx * PACKAGE_BLOCK;
+
+        if (block.size & PACKAGE_STORED) {
+            if (!readAll(fd, out, block.raw, block.offset))
+                ok = false;
+            return;
+        }
+
+        packed.resize(block.size);
+        if (!readAll(fd, packed.data(), block.size, block.offset) ||
+                !unpack(block, packed.data(), out))
+            ok = false;
+    });
+
+    return ok;
+}
+
+/**
+ * Loads an entry through a reader. The blocks kept as they are go straight into the
+ * buffer; the compressed ones into a buffer of the load, each one decompressed by its own
+ * job as soon as it is read, while the others are still being read.
+ * @param   unsigned        entry   The entry.
+ * @param   void            * dest  Where to write it, with room for its size.
+ * @param   PackageCallback done    The function called when it is loaded.
+ * @param   FileReader      * reader    The reader, NULL for the shared one.
+ */
+void
+Package::load(unsigned entry, void * dest, PackageCallback done, FileReader * reader) const
+{
+    const PackageEntry& desc = entries[entry];
+    PackageLoad * job;
+    size_t staged = 0;
+
+    if (desc.blockCount == 0) {
+        JobPool::instance()->submit([done]() { done(true); });
+        return;
+    }
+
+    if (reader == NULL)
+        reader = FileReader::instance();
+
+    job = new PackageLoad();
+    job->remaining = desc.blockCount;
+    job->ok = true;
+    job->done = done;
+    for (unsigned idx = 0; idx < desc.blockCount; idx++) {
+        if (!(blocks[desc.firstBlock + idx].size & PACKAGE_STORED))
+            staged += blocks[desc.firstBlock + idx].size;
+    }
+    job->packed.resize(staged);
+
+    staged = 0;
+    for (unsigned idx = 0; idx < desc.blockCount; idx++) {
+        const PackageBlock& block = blocks[desc.firstBlock + idx];
+        unsigned char * out = (unsigned char *) dest + (size_t) idx * PACKAGE_BLOCK;
+        unsigned char * in = job->packed.data() + staged;
+
+        if (block.size & PACKAGE_STORED) {
+            reader->read(fd, out, block.raw, block.offset, [job, block](long got) {
+                finish(job, got == (long) block.raw);
+            });
+        } else {
+            reader->read(fd, in, block.size, block.offset, [job, block, in, out](long got) {
+                finish(job, got == (long) block.size && unpack(block, in, out));
+            });
+            staged += block.size;
+        }
+    }
+    reader->submit();
+}
+
+/**
+ * Reads a pixmap entry.
+ * @param   unsigned    entry   The entry.
+ * @param   Pixmap      * pixmap    The pixmap, whose data is allocated with malloc.
+ * @return  Whether it was read; if not, the pixmap is left as it was.
+ */
+bool
+Package::readPixmap(unsigned entry, Pixmap * pixmap) const
+{
+    const PackageEntry& desc = entries[entry];
+    unsigned char * data;
+
+    if (desc.type != PACKAGE_PIXMAP ||
+            desc.size != (unsigned long long) desc.info[0] * desc.info[1] * 3 ||
+            (data = (unsigned char *) malloc(desc.size)) == NULL)
+        return false;
+
+    if (!read(entry, data)) {
+        free(data);
+        return false;
+    }
+
+    pixmap->data = data;
+    pixmap->width = desc.info[0];
+    pixmap->height = desc.info[1];
+    return true;
+}
+
+/**
+ * Adds an entry to be written.
+ * @param   char    * name  The name of the entry.
+ * @param   void    * data  Its bytes, kept by the caller until the package is written.
+ * @param   size_t  size    Their size.
+ * @param   GLuint  type    What it keeps, a PACKAGE_* value.
+ * @param   GLuint  info0, info1    What describes it.
+ */
+void
+PackageWriter::add(const char * name, const void * data, size_t size, GLuint type,
+        GLuint info0, GLuint info1)
+{
+    PackageItem item;
+
+    item.name = name;
+    item.type = type;
+    item.info[0] = info0;
+    item.info[1] = info1;
+    item.data = (const unsigned char *) data;
+    item.size = size;
+    items.push_back(item);
+}
+
+/**
+ * Adds the pixels of a pixmap, three bytes each.
+ * @param   char    * name  The name of the entry.
+ * @param   Pixmap  * pixmap    The pixmap, kept by the caller until it is written.
+ */
+void
+PackageWriter::addPixmap(const char * name, const Pixmap * pixmap)
+{
+    add(name, pixmap->data, (size_t) pixmap->width * pixmap->height * 3, PACKAGE_PIXMAP,
+            pixmap->width, pixmap->height);
+}
+
+/**
+ * Adds the bytes of a file, such as a scene file.
+ * @param   char    * name  The name of the entry.
+ * @param   char    * path  The path of the file.
+ * @param   GLuint  type    What it keeps, a PACKAGE_* value.
+ * @return  Whether the file was read.
+ */
+bool
+PackageWriter::addFile(const char * name, const char * path, GLuint type)
+{
+    PackageItem item;
+    struct stat info;
+    int fd;
+    bool done;
+
+    if ((fd = ::open(path, O_RDONLY)) < 0)
+        return false;
+
+    done = fstat(fd, &info) == 0;
+    if (done) {
+        item.copy.resize(info.st_size);
+        done = readAll(fd, item.copy.data(), item.copy.size(), 0);
+    }
+    ::close(fd);
+    if (!done)
+        return false;
+
+    item.name = name;
+    item.type = type;
+    item.info[0] = item.info[1] = 0;
+    item.data = NULL;
+    item.size = item.copy.size();
+    items.push_back(item);
+    return true;
+}
+
+/**
+ * Writes the package. The blocks of all the entries are compressed at once by a parallel
+ * loop, then the tables are laid out and everything is written in order; a block which
+ * does not get smaller is written as it is.
+ * @param   char    * path  The path of the package.
+ * @return  Whether it was written.
+ */
+bool
+PackageWriter::write(const char * path) const
+{
+    std::vector<std::vector<unsigned char> > packed;
+    std::vector<std::pair<unsigned, size_t> > origins; /* The item and start of each block. */
+    std::vector<PackageEntry> entries(items.size());
+    std::vector<PackageBlock> blocks;
+    std::vector<char> names;
+    PackageHeader head;
+    unsigned long long offset;
+    FILE * file;
+    bool done;
+
+    PROFILE_SCOPE("PackageWriter::write");
+
+    auto bytes = [&](const PackageItem& item) {
+        return item.data != NULL ? item.data : item.copy.data();
+    };
+
+    for (unsigned idx = 0; idx < items.size(); idx++) {
+        entries[idx].size = items[idx].size;
+        entries[idx].type = items[idx].type;
+        entries[idx].info[0] = items[idx].info[0];
+        entries[idx].info[1] = items[idx].info[1];
+        entries[idx].name = names.size();
+        entries[idx].firstBlock = origins.size();
+        names.insert(names.end(), items[idx].name.begin(), items[idx].name.end());
+        names.push_back('\0');
+
+        for (size_t start = 0; start < items[idx].size; start += PACKAGE_BLOCK)
+            origins.push_back(std::make_pair(idx, start));
+        entries[idx].blockCount = origins.size() - entries[idx].firstBlock;
+    }
+
+    packed.resize(origins.size());
+    JobPool::instance()->parallelFor(origins.size(), [&](unsigned idx) {
+        const PackageItem& item = items[origins[idx].first];
+        size_t raw = std::min((size_t) PACKAGE_BLOCK, item.size - origins[idx].second);
+        size_t size;
+
+        packed[idx].resize(lz4Bound(raw));
+        size = lz4Compress(bytes(item) + origins[idx].second, raw, packed[idx].data(),
+                packed[idx].size());
+        packed[idx].resize(size > 0 && size < raw ? size : 0);
+    });
+
+    memset(&head, 0, sizeof(head));
+    head.magic = PACKAGE_MAGIC;
+    head.version = PACKAGE_VERSION;
+    head.entries = entries.size();
+    head.blocks = origins.size();
+    head.names = sizeof(head) + entries.size() * sizeof(PackageEntry) +
+        origins.size() * sizeof(PackageBlock);
+    head.namesSize = names.size();
+
+    offset = head.names + head.namesSize;
+    blocks.resize(origins.size());
+    for (unsigned idx = 0; idx < origins.size(); idx++) {
+        const PackageItem& item = items[origins[idx].first];
+
+        blocks[idx].offset = offset;
+        blocks[idx].raw = std::min((size_t) PACKAGE_BLOCK, item.size - origins[idx].second);
+        blocks[idx].size = packed[idx].empty() ? blocks[idx].raw | PACKAGE_STORED :
+            packed[idx].size();
+        offset += blocks[idx].size & ~PACKAGE_STORED;
+    }
+
+    if ((file = fopen(path, "wb")) == NULL)
+        return false;
+
+    done = fwrite(&head, sizeof(head), 1, file) == 1 &&
+        fwrite(entries.data(), sizeof(PackageEntry), entries.size(), file) ==
+            entries.size() &&
+        fwrite(blocks.data(), sizeof(PackageBlock), blocks.size(), file) == blocks.size() &&
+        fwrite(names.data(), 1, names.size(), file) == names.size();
+
+    for (unsigned idx = 0; idx < origins.size() && done; idx++) {
+        const PackageItem& item = items[origins[idx].first];
+
+        if (packed[idx].empty())
+            done = fwrite(bytes(item) + origins[idx].second, 1, blocks[idx].raw, file) ==
+                blocks[idx].raw;
+        else
+            done = fwrite(packed[idx].data(), 1, packed[idx].size(), file) ==
+                packed[idx].size();
+    }
+
+    return fclose(file) == 0 && done;
+}
@@ -0,0 +1,245 @@
+/**
+ * Implementation of the CPU profiler and the Chrome trace exporter.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace GEngine;
+
+/**
+ * An event recorded by a thread.
+ */
+struct ProfileEvent {
+    const char  * name;
+    long long   start;
+    long long   end;
+};
+
+/**
+ * The buffer of events of a thread. The buffers are never freed, so the events of the
+ * threads which have finished can still be dumped.
+ */
+struct ProfileBuffer {
+    std::mutex                  lock;   /* Only contended while dumping. */
+    std::vector<ProfileEvent>   events;
+    std::string                 name;   /* The name of the track. */
+    unsigned                    tid;    /* The identifier of the track. */
+};
+
+#define ProfileBufferList   std::vector<ProfileBuffer *>
+
+std::atomic<bool> Profiler::enabled(false);
+
+static std::mutex           registry;   /* Protects the list of buffers and the capture. */
+static ProfileBufferList    buffers;    /* The buffers of all the threads. */
+static unsigned             remaining;  /* The frames left in the capture. */
+static std::string          output;     /* The file where the capture will be dumped. */
+static long long            lastFrame;  /* The moment of the last frame mark. */
+
+static thread_local ProfileBuffer * local = NULL;
+
+/**
+ * Gets the buffer of the calling thread, registering it on the first call.
+ * @return  The buffer of the thread.
+ */
+static ProfileBuffer *
+threadBuffer()
+{
+    char name[32];
+
+    if (local != NULL)
+        return local;
+
+    local = new ProfileBuffer();
+
+    std::lock_guard<std::mutex> guard(registry);
+    local->tid = buffers.size() + 1;
+    snprintf(name, sizeof(name), "Thread %u", local->tid);
+    local->name = name;
+    buffers.push_back(local);
+
+    return local;
+}
+
+/**
+ * Writes a string into the JSON file, escaping the characters that need it.
+ * @param   FILE    * file  The file where the string is written.
+ * @param   char    * str   The string to write.
+ */
+static void
+writeString(FILE * file, const char * str)
+{
+    fputc('"', file);
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', file);
+        if ((unsigned char) *str >= 0x20)
+            fputc(*str, file);
+    }
+    fputc('"', file);
+}
+
+/**
+ * Stores a finished scope into the buffer of the calling thread.
+ * @param   char        * name  The name of the scope.
+ * @param   long long   start   The moment the scope was entered, in nanoseconds.
+ * @param   long long   end     The moment the scope was left, in nanoseconds.
+ */
+void
+Profiler::record(const char * name, long long start, long long end)
+{
+    ProfileBuffer * buffer = threadBuffer();
+    ProfileEvent event = { name, start, end };
+
+    std::lock_guard<std::mutex> guard(buffer->lock);
+    buffer->events.push_back(event);
+}
+
+/**
+ * Starts the capture of the events of the next frames. The previous events are discarded.
+ * @param   unsigned    frames  The number of frames to capture.
+ * @param   char        * file  The file where the trace will be written.
+ * @return  Whether the capture could be started or not.
+ */
+bool
+Profiler::capture(unsigned frames, const char * file)
+{
+    ProfileBufferList::iterator iter;
+
+    if (frames == 0 || file == NULL || enabled.load())
+        return false;
+
+    /* The calling thread is the one marking the frames. */
+    setThreadName("Main");
+
+    std::lock_guard<std::mutex> guard(registry);
+    for (iter = buffers.begin(); iter != buffers.end(); iter++) {
+        std::lock_guard<std::mutex> bufGuard((*iter)->lock);
+        (*iter)->events.clear();
+    }
+
+    remaining = frames;
+    output = file;
+    lastFrame = Clock::now();
+    enabled.store(true);
+
+    return true;
+}
+
+/**
+ * Checks if there is a capture running.
+ * @return  True if the scopes are being recorded.
+ */
+bool
+Profiler::isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Marks the end of a frame. It records the frame as an event and, when the last
+ * frame of the capture is reached, it dumps the trace.
+ */
+void
+Profiler::frameMark()
+{
+    long long now;
+    bool finished;
+    std::string file;
+
+    if (!enabled.load(std::memory_order_relaxed))
+        return;
+
+    now = Clock::now();
+    record("Frame", lastFrame, now);
+    lastFrame = now;
+
+    {
+        std::lock_guard<std::mutex> guard(registry);
+        finished = --remaining == 0;
+        file = output;
+    }
+
+    if (finished) {
+        enabled.store(false);
+        dump(file.c_str());
+    }
+}
+
+/**
+ * Sets the name of the track of the calling thread.
+ * @param   char    * name  The name to be shown in the trace.
+ */
+void
+Profiler::setThreadName(const char * name)
+{
+    ProfileBuffer * buffer = threadBuffer();
+
+    if (name == NULL)
+        return;
+
+    std::lock_guard<std::mutex> guard(registry);
+    buffer->name = name;
+}
+
+/**
+ * Writes all the recorded events into a file using the Chrome trace JSON format. Each
+ * thread is shown in its own track.
+ * @param   char    * file  The path of the file.
+ * @return  Whether the file could be written or not.
+ */
+bool
+Profiler::dump(const char * file)
+{
+    FILE * out;
+    bool first = true;
+    long long origin = -1;
+    ProfileBufferList::iterator iter;
+    std::vector<ProfileEvent>::iterator ev;
+
+    if (file == NULL || (out = fopen(file, "w")) == NULL)
+        return false;
+
+    std::lock_guard<std::mutex> guard(registry);
+
+    /* The timestamps start at the first recorded event. */
+    for (iter = buffers.begin(); iter != buffers.end(); iter++) {
+        std::lock_guard<std::mutex> bufGuard((*iter)->lock);
+        for (ev = (*iter)->events.begin(); ev != (*iter)->events.end(); ev++)
+            if (origin < 0 || ev->start < origin)
+                origin = ev->start;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (iter = buffers.begin(); iter != buffers.end(); iter++) {
+        std::lock_guard<std::mutex> bufGuard((*iter)->lock);
+
+        /* The name of the track. */
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", (*iter)->tid);
+        writeString(out, (*iter)->name.c_str());
+        fprintf(out, "}}");
+        first = false;
+
+        for (ev = (*iter)->events.begin(); ev != (*iter)->events.end(); ev++) {
+            fprintf(out, ",\n{\"name\":");
+            writeString(out, ev->name);
+            fprintf(out, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    (*iter)->tid, (ev->start - origin) / 1e3, (ev->end - ev->start) / 1e3);
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    return fclose(out) == 0;
+}
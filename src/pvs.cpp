@@ -0,0 +1,332 @@
+/**
+ * Implementation of the potentially visible sets.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "pvs.h"
+#include "bvh.h"
+#include "jobs.h"
+#include "profiler.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+using namespace GEngine;
+
+/**
+ * Returns whether a segment crosses a triangle, away from its ends.
+ * @param   GLfloat origin[3]   The start of the segment.
+ * @param   GLfloat dir[3]      The segment, from its start to its end.
+ * @param   GLfloat tri[9]      The corners of the triangle.
+ * @return  Whether the triangle stops the segment.
+ */
+static bool
+crosses(const GLfloat origin[3], const GLfloat dir[3], const GLfloat tri[9])
+{
+    GLfloat edge1[3], edge2[3], pvec[3], tvec[3], qvec[3], det, u, v, t;
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        edge1[axis] = tri[3 + axis] - tri[axis];
+        edge2[axis] = tri[6 + axis] - tri[axis];
+        tvec[axis] = origin[axis] - tri[axis];
+    }
+
+    pvec[0] = dir[1] * edge2[2] - dir[2] * edge2[1];
+    pvec[1] = dir[2] * edge2[0] - dir[0] * edge2[2];
+    pvec[2] = dir[0] * edge2[1] - dir[1] * edge2[0];
+    det = edge1[0] * pvec[0] + edge1[1] * pvec[1] + edge1[2] * pvec[2];
+    if (det == 0.0f)
+        return false;
+
+    u = (tvec[0] * pvec[0] + tvec[1] * pvec[1] + tvec[2] * pvec[2]) / det;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    qvec[0] = tvec[1] * edge1[2] - tvec[2] * edge1[1];
+    qvec[1] = tvec[2] * edge1[0] - tvec[0] * edge1[2];
+    qvec[2] = tvec[0] * edge1[1] - tvec[1] * edge1[0];
+    v = (dir[0] * qvec[0] + dir[1] * qvec[1] + dir[2] * qvec[2]) / det;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = (edge2[0] * qvec[0] + edge2[1] * qvec[1] + edge2[2] * qvec[2]) / det;
+    return t > PVS_EPSILON && t < 1.0f - PVS_EPSILON;
+}
+
+/**
+ * Constructor, a single cell which sees everything until it is baked.
+ */
+PVS::PVS()
+{
+    GLfloat limits[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+    setCells(limits, 1.0f);
+}
+
+/**
+ * Splits a box into cells. The side of the cells is doubled until there are no more than
+ * PVS_MAX_CELLS of them.
+ * @param   GLfloat limits[6]   The minimum and maximum x, y and z of the box.
+ * @param   GLfloat cell        The side of the cells.
+ */
+void
+PVS::setCells(const GLfloat limits[6], GLfloat cell)
+{
+    unsigned long long total;
+
+    side = cell > 0.0f ? cell : 1.0f;
+    do {
+        total = 1;
+        for (unsigned axis = 0; axis < 3; axis++) {
+            GLfloat extent = limits[axis + 3] - limits[axis];
+
+            origin[axis] = limits[axis];
+            dims[axis] = extent > side ? (unsigned) ceil(extent / side) : 1;
+            total *= dims[axis];
+        }
+        if (total > PVS_MAX_CELLS)
+            side *= 2.0f;
+    } while (total > PVS_MAX_CELLS);
+
+    clear();
+}
+
+/**
+ * Bakes the sets, one cell in each job. The rays go from the centers of the eighths of
+ * each cell to each point of a target, until one of them is not stopped by the faces of
+ * the occluders, found through a tree of their boxes.
+ * @param   GLfloat     triangles   The corners of the faces of the occluders.
+ * @param   GLfloat     points      The points of all the targets.
+ * @param   unsigned    firsts      The first point of each target, and the end.
+ */
+void
+PVS::bake(const std::vector<GLfloat>& triangles, const std::vector<GLfloat>& points,
+        const std::vector<unsigned>& firsts)
+{
+    std::vector<GLfloat> boxes(triangles.size() / 9 * 6);
+    unsigned cells = dims[0] * dims[1] * dims[2];
+    BVH tree;
+
+    PROFILE_SCOPE("PVS::bake");
+
+    for (unsigned tri = 0; tri < triangles.size() / 9; tri++) {
+        for (unsigned axis = 0; axis < 3; axis++) {
+            boxes[tri * 6 + axis] = std::min(std::min(triangles[tri * 9 + axis],
+                        triangles[tri * 9 + 3 + axis]), triangles[tri * 9 + 6 + axis]);
+            boxes[tri * 6 + axis + 3] = std::max(std::max(triangles[tri * 9 + axis],
+                        triangles[tri * 9 + 3 + axis]), triangles[tri * 9 + 6 + axis]);
+        }
+    }
+    tree.build(boxes.data(), boxes.size() / 6);
+
+    targets = firsts.size() - 1;
+    words = (targets + 63) / 64;
+    bits.assign(cells * words, 0);
+
+    JobPool::instance()->parallelFor(cells, [&](unsigned cell) {
+        GLfloat samples[PVS_CELL_SAMPLES][3], dir[3];
+        std::vector<unsigned> found;
+        unsigned coord[3] = {cell % dims[0], cell / dims[0] % dims[1],
+            cell / dims[0] / dims[1]};
+        bool seen;
+
+        for (unsigned sample = 0; sample < PVS_CELL_SAMPLES; sample++) {
+            for (unsigned axis = 0; axis < 3; axis++)
+                samples[sample][axis] = origin[axis] +
+                    (coord[axis] + (sample >> axis & 1 ? 0.75f : 0.25f)) * side;
+        }
+
+        for (unsigned target = 0; target < targets; target++) {
+            seen = false;
+            for (unsigned point = firsts[target]; point < firsts[target + 1] && !seen;
+                    point++) {
+                for (unsigned sample = 0; sample < PVS_CELL_SAMPLES && !seen; sample++) {
+                    for (unsigned axis = 0; axis < 3; axis++)
+                        dir[axis] = points[point * 3 + axis] - samples[sample][axis];
+
+                    found.clear();
+                    tree.intersect(samples[sample], dir, 1.0f, &found);
+                    seen = true;
+                    for (unsigned idx = 0; idx < found.size() && seen; idx++)
+                        seen = !crosses(samples[sample], dir, &triangles[found[idx] * 9]);
+                }
+            }
+
+            if (seen)
+                bits[cell * words + target / 64] |= 1ULL << (target % 64);
+        }
+    });
+}
+
+/**
+ * Forgets the sets.
+ */
+void
+PVS::clear()
+{
+    bits.clear();
+    targets = words = 0;
+}
+
+/**
+ * Returns whether the sets are baked.
+ * @return  Whether they are.
+ */
+bool
+PVS::isBaked() const
+{
+    return !bits.empty();
+}
+
+/**
+ * Gets the cell containing a point.
+ * @param   GLfloat pos[3]  The point.
+ * @return  The index of the cell, or -1 if the point is out of the cells.
+ */
+int
+PVS::getCell(const GLfloat pos[3]) const
+{
+    unsigned coord[3];
+    GLfloat cell;
+
+    for (unsigned axis = 0; axis < 3; axis++) {
+        cell = floor((pos[axis] - origin[axis]) / side);
+        if (cell < 0.0f || cell >= dims[axis])
+            return -1;
+        coord[axis] = (unsigned) cell;
+    }
+
+    return (coord[2] * dims[1] + coord[1]) * dims[0] + coord[0];
+}
+
+/**
+ * Returns whether a target can be seen from a cell. Everything is seen until the sets
+ * are baked.
+ * @param   unsigned    cell    The cell.
+ * @param   unsigned    target  The target.
+ * @return  Whether it can be seen.
+ */
+bool
+PVS::isVisible(unsigned cell, unsigned target) const
+{
+    if (bits.empty())
+        return true;
+
+    return bits[cell * words + target / 64] >> (target % 64) & 1;
+}
+
+/**
+ * Gets the number of targets of the sets.
+ * @return  The targets, 0 if they are not baked.
+ */
+unsigned
+PVS::getTargets() const
+{
+    return targets;
+}
+
+/**
+ * Gets the cells of the sets along each axis.
+ * @param   unsigned    cells[3]    The cells along x, y and z.
+ */
+void
+PVS::getDims(unsigned cells[3]) const
+{
+    std::copy(dims, dims + 3, cells);
+}
+
+/**
+ * Gets the sets, as many words for each cell as needed for the targets.
+ * @return  The sets, empty if they are not baked.
+ */
+const PVSBits&
+PVS::getSets() const
+{
+    return bits;
+}
+
+/**
+ * Copies the sets baked for the same cells, as given by getSets().
+ * @param   unsigned            cells[3]    The cells of the sets along each axis.
+ * @param   unsigned            count       The number of targets.
+ * @param   unsigned long long  * sets      The sets.
+ * @return  Whether they were copied, that is, the cells are the same ones.
+ */
+bool
+PVS::setSets(const unsigned cells[3], unsigned count, const unsigned long long * sets)
+{
+    if (!std::equal(cells, cells + 3, dims) || count == 0) {
+        clear();
+        return false;
+    }
+
+    targets = count;
+    words = (targets + 63) / 64;
+    bits.assign(sets, sets + dims[0] * dims[1] * dims[2] * words);
+    return true;
+}
+
+/**
+ * Writes the sets into a file: the magic number, the cells and the number of targets,
+ * then the bits.
+ * @param   char    * path  The path of the file.
+ * @return  Whether the sets were written.
+ */
+bool
+PVS::save(const char * path) const
+{
+    unsigned header[5] = {PVS_MAGIC, dims[0], dims[1], dims[2], targets};
+    FILE * file = fopen(path, "wb");
+    bool done;
+
+    if (file == NULL)
+        return false;
+
+    done = fwrite(header, sizeof(header), 1, file) == 1 &&
+        fwrite(origin, sizeof(origin), 1, file) == 1 &&
+        fwrite(&side, sizeof(side), 1, file) == 1 &&
+        fwrite(bits.data(), sizeof(unsigned long long), bits.size(), file) == bits.size();
+
+    return fclose(file) == 0 && done;
+}
+
+/**
+ * Reads the sets from a file written by save(). The cells must be the same ones; the
+ * targets are the ones of the file.
+ * @param   char    * path  The path of the file.
+ * @return  Whether the sets were read.
+ */
+bool
+PVS::load(const char * path)
+{
+    unsigned header[5], cells = dims[0] * dims[1] * dims[2];
+    GLfloat start[3], size;
+    FILE * file = fopen(path, "rb");
+    bool done;
+
+    if (file == NULL)
+        return false;
+
+    done = fread(header, sizeof(header), 1, file) == 1 &&
+        fread(start, sizeof(start), 1, file) == 1 &&
+        fread(&size, sizeof(size), 1, file) == 1 && header[0] == PVS_MAGIC &&
+        header[1] == dims[0] && header[2] == dims[1] && header[3] == dims[2] &&
+        std::equal(start, start + 3, origin) && size == side;
+
+    if (done) {
+        targets = header[4];
+        words = (targets + 63) / 64;
+        bits.resize(cells * words);
+        done = fread(bits.data(), sizeof(unsigned long long), bits.size(), file) ==
+            bits.size();
+    }
+    fclose(file);
+
+    if (!done)
+        clear();
+    return done;
+}
@@ -0,0 +1,764 @@
+/**
+ * Implementation of the tile-based software rasterizer.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "raster.h"
+#include "camera.h"
+#include "material.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "stats.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace GEngine;
+
+/**
+ * Packs a RGB color into the RGBA format of the color buffer.
+ * @param   GLfloat rgb[3]  The components of the color, between 0 and 1.
+ * @param   GLfloat alpha   The alpha component.
+ * @return  The packed color.
+ */
+static unsigned
+packColor(const GLfloat rgb[3], GLfloat alpha)
+{
+    unsigned char bytes[4];
+    unsigned value;
+    int idx;
+
+    for (idx = 0; idx < 4; idx++) {
+        GLfloat comp = idx < 3 ? rgb[idx] : alpha;
+
+        comp = comp < 0.0f ? 0.0f : (comp > 1.0f ? 1.0f : comp);
+        bytes[idx] = (unsigned char) (comp * 255.0f + 0.5f);
+    }
+
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+/**
+ * Interpolates two vertices in clip coordinates.
+ * @param   ClipVertex  a, b    The vertices.
+ * @param   double      t       The parameter, 0 for a and 1 for b.
+ * @return  The interpolated vertex.
+ */
+static ClipVertex
+lerp(const ClipVertex& a, const ClipVertex& b, double t)
+{
+    ClipVertex out;
+
+    out.x = a.x + (b.x - a.x) * t;
+    out.y = a.y + (b.y - a.y) * t;
+    out.z = a.z + (b.z - a.z) * t;
+    out.w = a.w + (b.w - a.w) * t;
+
+    return out;
+}
+
+/**
+ * Constructor of the rasterizer.
+ * @param   unsigned    w   The width of the framebuffer.
+ * @param   unsigned    h   The height of the framebuffer.
+ */
+Rasterizer::Rasterizer(unsigned w, unsigned h)
+{
+    GLfloat black[3] = { 0.0f, 0.0f, 0.0f };
+
+    width = height = 0;
+    resize(w, h);
+
+    mat4Identity(mvp);
+    polyMode[0] = polyMode[1] = GL_FILL;
+    clearColor = packColor(black, 0.0f);
+    fgColor = color = packColor(black, 1.0f);
+    primMode = GL_POINTS;
+}
+
+/**
+ * Allocates the buffers and the bins for a new size of the framebuffer.
+ * @param   unsigned    w   The width of the framebuffer.
+ * @param   unsigned    h   The height of the framebuffer.
+ */
+void
+Rasterizer::resize(unsigned w, unsigned h)
+{
+    if (w == width && h == height)
+        return;
+
+    width = w;
+    height = h;
+    stride = (w + 3) & ~3u;
+    tilesX = (w + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    tilesY = (h + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+    colorBuf.assign(stride * h, 0);
+    depthBuf.assign(stride * h, 1.0f);
+    bins.assign(tilesX * tilesY, RasterBin());
+}
+
+/**
+ * Cleans the framebuffer and forgets the primitives of the last frame.
+ * @param   GLuint  position[2]     The position of the viewport, unused.
+ * @param   GLuint  screen[3]       The dimensions of the framebuffer.
+ * @param   GLfloat bgcolor[3]      The color to clean the framebuffer.
+ * @param   GLfloat fgcolor[3]      The color for the figures without material.
+ */
+void
+Rasterizer::beginFrame(const GLuint position[2], const GLuint screen[3],
+        const GLfloat bgcolor[3], const GLfloat fgcolor[3])
+{
+    std::vector<RasterBin>::iterator iter;
+
+    resize(screen[0], screen[1]);
+
+    clearColor = packColor(bgcolor, 0.0f);
+    fgColor = color = packColor(fgcolor, 1.0f);
+    std::fill(colorBuf.begin(), colorBuf.end(), clearColor);
+    std::fill(depthBuf.begin(), depthBuf.end(), 1.0f);
+
+    prims.clear();
+    for (iter = bins.begin(); iter != bins.end(); iter++)
+        iter->clear();
+
+    mat4Identity(mvp);
+    mvpStack.clear();
+    polyMode[0] = polyMode[1] = GL_FILL;
+}
+
+/**
+ * Rasterizes the tiles of the frame in parallel.
+ */
+void
+Rasterizer::endFrame()
+{
+    PROFILE_SCOPE("Rasterizer::endFrame");
+
+    JobPool::instance()->parallelFor(tilesX * tilesY,
+            [this](unsigned tile) { rasterTile(tile); });
+}
+
+/**
+ * Uses the matrices of a camera to project the vertices.
+ * @param   Camera  * cam   The camera.
+ */
+void
+Rasterizer::activateCamera(Camera * cam)
+{
+    double modelview[16];
+
+    cam->getModelview(modelview);
+    cam->getProjection(mvp);
+    mat4Multiply(mvp, modelview, mvp);
+}
+
+/**
+ * Goes back to the identity matrices.
+ * @param   Camera  * cam   The camera, unused.
+ */
+void
+Rasterizer::deactivateCamera(Camera * cam)
+{
+    mat4Identity(mvp);
+}
+
+/**
+ * Sets the ambient light. The rasterizer draws with flat colors, so it is ignored.
+ * @param   GLfloat ambient[4]  The RGBA ambient light.
+ */
+void
+Rasterizer::setAmbient(const GLfloat ambient[4])
+{
+}
+
+/**
+ * Sets a source of light. The rasterizer draws with flat colors, so it is only counted.
+ * @param   Light   * light     The light.
+ */
+void
+Rasterizer::setLight(Light * light)
+{
+    RenderStats::frame.lightUploads++;
+}
+
+/**
+ * Sets the polygon mode.
+ * @param   GLenum  face    The faces affected (GL_FRONT, GL_BACK or GL_FRONT_AND_BACK).
+ * @param   GLenum  mode    The mode (GL_POINT, GL_LINE or GL_FILL).
+ */
+void
+Rasterizer::setPolygonMode(GLenum face, GLenum mode)
+{
+    if (face != GL_BACK)
+        polyMode[0] = mode;
+    if (face != GL_FRONT)
+        polyMode[1] = mode;
+
+    RenderStats::frame.polygonModeChanges++;
+}
+
+/**
+ * Sets the diffuse color of a material as the color of the next primitives.
+ * @param   Material    * mat   The material.
+ */
+void
+Rasterizer::setMaterial(Material * mat)
+{
+    const GLfloat * diffuse = mat->getMatProperty(GL_DIFFUSE);
+
+    if (diffuse != NULL)
+        color = packColor(diffuse, diffuse[3]);
+
+    RenderStats::frame.materialChanges++;
+}
+
+/**
+ * Goes back to the default color.
+ * @param   Material    * mat   The material, unused.
+ */
+void
+Rasterizer::unsetMaterial(Material * mat)
+{
+    color = fgColor;
+}
+
+/**
+ * Multiplies a matrix into the one projecting the vertices, saving the previous one.
+ * @param   GLfloat matrix[16]  The matrix, stored by columns.
+ */
+void
+Rasterizer::pushMatrix(const GLfloat matrix[16])
+{
+    double model[16];
+
+    for (unsigned idx = 0; idx < 16; idx++)
+        model[idx] = matrix[idx];
+
+    mvpStack.insert(mvpStack.end(), mvp, mvp + 16);
+    mat4Multiply(mvp, model, mvp);
+}
+
+/**
+ * Restores the matrix projecting the vertices saved by the last pushMatrix().
+ */
+void
+Rasterizer::popMatrix()
+{
+    if (mvpStack.size() < 16)
+        return;
+
+    std::copy(mvpStack.end() - 16, mvpStack.end(), mvp);
+    mvpStack.resize(mvpStack.size() - 16);
+}
+
+/**
+ * Starts a primitive.
+ * @param   GLenum  mode    The kind of primitive, as glBegin.
+ */
+void
+Rasterizer::begin(GLenum mode)
+{
+    primMode = mode;
+    verts.clear();
+}
+
+/**
+ * Adds a vertex to the current primitive, transforming it into clip coordinates.
+ * @param   GLdouble    x, y, z     The coordinates of the vertex.
+ * @param   GLdouble    s, t        The texture coordinates, unused.
+ */
+void
+Rasterizer::vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s, GLdouble t)
+{
+    double in[4] = { x, y, z, 1.0 }, out[4];
+    ClipVertex vert;
+
+    mat4Transform(mvp, in, out);
+    vert.x = out[0];
+    vert.y = out[1];
+    vert.z = out[2];
+    vert.w = out[3];
+    verts.push_back(vert);
+}
+
+/**
+ * Finishes the current primitive, splitting it into points, lines and polygons.
+ */
+void
+Rasterizer::end()
+{
+    unsigned idx, count = verts.size();
+    ClipVertex quad[4];
+    const ClipVertex * v = verts.data();
+
+    switch (primMode) {
+        case GL_POINTS:
+            for (idx = 0; idx < count; idx++)
+                emitPoint(v[idx]);
+            break;
+        case GL_LINES:
+            for (idx = 0; idx + 1 < count; idx += 2)
+                emitLine(v[idx], v[idx + 1]);
+            break;
+        case GL_LINE_LOOP:
+            if (count > 2)
+                emitLine(v[count - 1], v[0]);
+            /* Fall through. */
+        case GL_LINE_STRIP:
+            for (idx = 0; idx + 1 < count; idx++)
+                emitLine(v[idx], v[idx + 1]);
+            break;
+        case GL_TRIANGLES:
+            for (idx = 0; idx + 2 < count; idx += 3)
+                emitPolygon(v + idx, 3);
+            break;
+        case GL_TRIANGLE_STRIP:
+            for (idx = 0; idx + 2 < count; idx++) {
+                /* The odd triangles are reversed to keep the same orientation. */
+                quad[0] = v[idx];
+                quad[1] = v[idx % 2 ? idx + 2 : idx + 1];
+                quad[2] = v[idx % 2 ? idx + 1 : idx + 2];
+                emitPolygon(quad, 3);
+            }
+            break;
+        case GL_TRIANGLE_FAN:
+            for (idx = 1; idx + 1 < count; idx++) {
+                quad[0] = v[0];
+                quad[1] = v[idx];
+                quad[2] = v[idx + 1];
+                emitPolygon(quad, 3);
+            }
+            break;
+        case GL_QUADS:
+            for (idx = 0; idx + 3 < count; idx += 4)
+                emitPolygon(v + idx, 4);
+            break;
+        case GL_QUAD_STRIP:
+            for (idx = 0; idx + 3 < count; idx += 2) {
+                quad[0] = v[idx];
+                quad[1] = v[idx + 1];
+                quad[2] = v[idx + 3];
+                quad[3] = v[idx + 2];
+                emitPolygon(quad, 4);
+            }
+            break;
+        case GL_POLYGON:
+            if (count > 2)
+                emitPolygon(v, count);
+            break;
+    }
+
+    verts.clear();
+}
+
+/**
+ * Projects a vertex in clip coordinates into the screen.
+ * @param   ClipVertex  in      The vertex, in front of the near plane.
+ * @param   float       out[3]  The x and y in pixels and the depth.
+ */
+void
+Rasterizer::project(const ClipVertex& in, float out[3])
+{
+    out[0] = (in.x / in.w * 0.5 + 0.5) * width;
+    out[1] = (in.y / in.w * 0.5 + 0.5) * height;
+    out[2] = in.z / in.w * 0.5 + 0.5;
+}
+
+/**
+ * Adds a point if it is in front of the near plane.
+ * @param   ClipVertex  p   The point.
+ */
+void
+Rasterizer::emitPoint(const ClipVertex& p)
+{
+    RasterPrim prim;
+
+    if (p.z + p.w < 0.0 || p.w <= 0.0)
+        return;
+
+    prim.type = RasterPrim::POINT;
+    prim.color = color;
+    project(p, prim.v[0]);
+    bin(prim);
+}
+
+/**
+ * Adds a line, clipped by the near plane.
+ * @param   ClipVertex  a, b    The ends of the line.
+ */
+void
+Rasterizer::emitLine(const ClipVertex& a, const ClipVertex& b)
+{
+    RasterPrim prim;
+    ClipVertex ca = a, cb = b;
+    double da = a.z + a.w, db = b.z + b.w;
+
+    if (da < 0.0 && db < 0.0)
+        return;
+    if (da < 0.0)
+        ca = lerp(a, b, da / (da - db));
+    else if (db < 0.0)
+        cb = lerp(a, b, da / (da - db));
+
+    prim.type = RasterPrim::LINE;
+    prim.color = color;
+    project(ca, prim.v[0]);
+    project(cb, prim.v[1]);
+    bin(prim);
+}
+
+/**
+ * Adds a polygon, clipped by the near plane, following the polygon mode of the side
+ * facing the camera.
+ * @param   ClipVertex  * poly      The vertices of the polygon, counter-clockwise for the front.
+ * @param   unsigned    count       The number of vertices.
+ */
+void
+Rasterizer::emitPolygon(const ClipVertex * poly, unsigned count)
+{
+    ClipVertexList clipped;
+    std::vector<float> screen;
+    RasterPrim prim;
+    unsigned idx, next, size;
+    double da, db, area = 0.0;
+    GLenum mode;
+
+    /* Clipping against the near plane (z >= -w). */
+    for (idx = 0; idx < count; idx++) {
+        next = (idx + 1) % count;
+        da = poly[idx].z + poly[idx].w;
+        db = poly[next].z + poly[next].w;
+
+        if (da >= 0.0)
+            clipped.push_back(poly[idx]);
+        if ((da >= 0.0) != (db >= 0.0))
+            clipped.push_back(lerp(poly[idx], poly[next], da / (da - db)));
+    }
+
+    size = clipped.size();
+    if (size < 3)
+        return;
+
+    screen.resize(3 * size);
+    for (idx = 0; idx < size; idx++)
+        project(clipped[idx], &screen[3 * idx]);
+
+    /* The orientation on the screen tells the visible side. */
+    for (idx = 0; idx < size; idx++) {
+        next = (idx + 1) % size;
+        area += screen[3 * idx] * screen[3 * next + 1] - screen[3 * next] * screen[3 * idx + 1];
+    }
+    mode = polyMode[area >= 0.0 ? 0 : 1];
+
+    if (mode == GL_LINE) {
+        for (idx = 0; idx < count; idx++)
+            emitLine(poly[idx], poly[(idx + 1) % count]);
+    } else if (mode == GL_POINT) {
+        for (idx = 0; idx < count; idx++)
+            emitPoint(poly[idx]);
+    } else {
+        prim.type = RasterPrim::TRIANGLE;
+        prim.color = color;
+        memcpy(prim.v[0], &screen[0], 3 * sizeof(float));
+        for (idx = 1; idx + 1 < size; idx++) {
+            memcpy(prim.v[1], &screen[3 * idx], 3 * sizeof(float));
+            memcpy(prim.v[2], &screen[3 * (idx + 1)], 3 * sizeof(float));
+            bin(prim);
+        }
+    }
+}
+
+/**
+ * Stores a primitive and adds it to the bins of all the tiles touched by its bounding box.
+ * @param   RasterPrim  prim    The primitive.
+ */
+void
+Rasterizer::bin(const RasterPrim& prim)
+{
+    unsigned nverts = prim.type == RasterPrim::TRIANGLE ? 3 : (prim.type == RasterPrim::LINE ? 2 : 1);
+    float minx, maxx, miny, maxy;
+    unsigned idx, tx, ty, tx0, tx1, ty0, ty1;
+
+    minx = maxx = prim.v[0][0];
+    miny = maxy = prim.v[0][1];
+    for (idx = 1; idx < nverts; idx++) {
+        minx = std::min(minx, prim.v[idx][0]);
+        maxx = std::max(maxx, prim.v[idx][0]);
+        miny = std::min(miny, prim.v[idx][1]);
+        maxy = std::max(maxy, prim.v[idx][1]);
+    }
+
+    /* Discarding the primitives out of the screen (or with invalid coordinates). */
+    if (!(maxx >= 0.0f && minx < width && maxy >= 0.0f && miny < height))
+        return;
+
+    minx = std::max(minx, 0.0f);
+    miny = std::max(miny, 0.0f);
+    maxx = std::min(maxx, (float) (width - 1));
+    maxy = std::min(maxy, (float) (height - 1));
+
+    tx0 = (unsigned) minx / RASTER_TILE_SIZE;
+    tx1 = (unsigned) maxx / RASTER_TILE_SIZE;
+    ty0 = (unsigned) miny / RASTER_TILE_SIZE;
+    ty1 = (unsigned) maxy / RASTER_TILE_SIZE;
+
+    prims.push_back(prim);
+    for (ty = ty0; ty <= ty1; ty++)
+        for (tx = tx0; tx <= tx1; tx++)
+            bins[ty * tilesX + tx].push_back(prims.size() - 1);
+}
+
+/**
+ * Rasterizes the primitives of a tile in the order they were submitted.
+ * @param   unsigned    tile    The index of the tile.
+ */
+void
+Rasterizer::rasterTile(unsigned tile)
+{
+    RasterBin::iterator iter;
+    int x0, y0, x1, y1;
+
+    x0 = (tile % tilesX) * RASTER_TILE_SIZE;
+    y0 = (tile / tilesX) * RASTER_TILE_SIZE;
+    x1 = std::min(x0 + RASTER_TILE_SIZE, (int) width);
+    y1 = std::min(y0 + RASTER_TILE_SIZE, (int) height);
+
+    for (iter = bins[tile].begin(); iter != bins[tile].end(); iter++) {
+        const RasterPrim& prim = prims[*iter];
+
+        switch (prim.type) {
+            case RasterPrim::TRIANGLE:
+                drawTriangle(prim, x0, y0, x1, y1);
+                break;
+            case RasterPrim::LINE:
+                drawLine(prim, x0, y0, x1, y1);
+                break;
+            case RasterPrim::POINT:
+                drawPoint(prim, x0, y0, x1, y1);
+                break;
+        }
+    }
+}
+
+/**
+ * Rasterizes the part of a triangle inside a tile, using edge functions evaluated for
+ * four pixels at the same time.
+ * @param   RasterPrim  prim    The triangle.
+ * @param   int         x0, y0  The first pixel of the tile.
+ * @param   int         x1, y1  The end of the tile (excluded).
+ */
+void
+Rasterizer::drawTriangle(const RasterPrim& prim, int x0, int y0, int x1, int y1)
+{
+    const float * a = prim.v[0], * b = prim.v[1], * c = prim.v[2], * tmp;
+    float area, A[3], B[3], C[3], zA, zB, zC;
+    int minx, maxx, miny, maxy, x, y;
+
+    area = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+    if (area == 0.0f)
+        return;
+
+    /* Both sides are drawn, so the triangle is turned counter-clockwise. */
+    if (area < 0.0f) {
+        tmp = b; b = c; c = tmp;
+        area = -area;
+    }
+
+    /* The edge functions E(x, y) = A * x + B * y + C, positive inside. */
+    A[0] = b[1] - c[1]; B[0] = c[0] - b[0]; C[0] = -(A[0] * b[0] + B[0] * b[1]);
+    A[1] = c[1] - a[1]; B[1] = a[0] - c[0]; C[1] = -(A[1] * c[0] + B[1] * c[1]);
+    A[2] = a[1] - b[1]; B[2] = b[0] - a[0]; C[2] = -(A[2] * a[0] + B[2] * a[1]);
+
+    /* The depth plane, from the barycentric coordinates. */
+    zA = (A[0] * a[2] + A[1] * b[2] + A[2] * c[2]) / area;
+    zB = (B[0] * a[2] + B[1] * b[2] + B[2] * c[2]) / area;
+    zC = (C[0] * a[2] + C[1] * b[2] + C[2] * c[2]) / area;
+
+    minx = std::max(x0, (int) floorf(std::max(std::min(std::min(a[0], b[0]), c[0]), (float) x0)));
+    maxx = std::min(x1 - 1, (int) floorf(std::min(std::max(std::max(a[0], b[0]), c[0]), (float) x1)));
+    miny = std::max(y0, (int) floorf(std::max(std::min(std::min(a[1], b[1]), c[1]), (float) y0)));
+    maxy = std::min(y1 - 1, (int) floorf(std::min(std::max(std::max(a[1], b[1]), c[1]), (float) y1)));
+
+    /* The rows are processed by groups of four pixels, aligned with the tile. */
+    minx &= ~3;
+
+#ifdef __SSE2__
+    const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 vA0 = _mm_set1_ps(A[0]), vA1 = _mm_set1_ps(A[1]), vA2 = _mm_set1_ps(A[2]);
+    const __m128 vzA = _mm_set1_ps(zA), vmax = _mm_set1_ps(maxx + 0.5f);
+    const __m128i vcolor = _mm_set1_epi32(prim.color);
+
+    for (y = miny; y <= maxy; y++) {
+        float py = y + 0.5f;
+        const __m128 r0 = _mm_set1_ps(B[0] * py + C[0]);
+        const __m128 r1 = _mm_set1_ps(B[1] * py + C[1]);
+        const __m128 r2 = _mm_set1_ps(B[2] * py + C[2]);
+        const __m128 rz = _mm_set1_ps(zB * py + zC);
+        unsigned * row = &colorBuf[y * stride];
+        float * drow = &depthBuf[y * stride];
+
+        for (x = minx; x <= maxx; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+            __m128 mask, z, old;
+            __m128i imask, oldc;
+
+            mask = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vA0, px), r0), zero),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vA1, px), r1), zero));
+            mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vA2, px), r2), zero));
+            mask = _mm_and_ps(mask, _mm_cmple_ps(px, vmax));
+            if (_mm_movemask_ps(mask) == 0)
+                continue;
+
+            /* Depth test (GL_LESS) and depth range. */
+            z = _mm_add_ps(_mm_mul_ps(vzA, px), rz);
+            old = _mm_loadu_ps(drow + x);
+            mask = _mm_and_ps(mask, _mm_cmplt_ps(z, old));
+            mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(z, zero), _mm_cmple_ps(z, one)));
+            if (_mm_movemask_ps(mask) == 0)
+                continue;
+
+            _mm_storeu_ps(drow + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, old)));
+
+            imask = _mm_castps_si128(mask);
+            oldc = _mm_loadu_si128((const __m128i *) (row + x));
+            _mm_storeu_si128((__m128i *) (row + x),
+                    _mm_or_si128(_mm_and_si128(imask, vcolor), _mm_andnot_si128(imask, oldc)));
+        }
+    }
+#else
+    for (y = miny; y <= maxy; y++) {
+        float py = y + 0.5f;
+        unsigned * row = &colorBuf[y * stride];
+        float * drow = &depthBuf[y * stride];
+
+        for (x = minx; x <= maxx; x++) {
+            float px = x + 0.5f, z;
+
+            if (A[0] * px + B[0] * py + C[0] < 0.0f || A[1] * px + B[1] * py + C[1] < 0.0f ||
+                    A[2] * px + B[2] * py + C[2] < 0.0f)
+                continue;
+
+            z = zA * px + zB * py + zC;
+            if (z < drow[x] && z >= 0.0f && z <= 1.0f) {
+                drow[x] = z;
+                row[x] = prim.color;
+            }
+        }
+    }
+#endif
+}
+
+/**
+ * Rasterizes the part of a line inside a tile. The line is walked along its major axis,
+ * and each step is drawn by the tile owning its pixel.
+ * @param   RasterPrim  prim    The line.
+ * @param   int         x0, y0  The first pixel of the tile.
+ * @param   int         x1, y1  The end of the tile (excluded).
+ */
+void
+Rasterizer::drawLine(const RasterPrim& prim, int x0, int y0, int x1, int y1)
+{
+    const float * a = prim.v[0], * b = prim.v[1];
+    float dx = b[0] - a[0], dy = b[1] - a[1], dz = b[2] - a[2];
+    float t0 = 0.0f, t1 = 1.0f, p[4], q[4], start[3], r, t, z;
+    int idx, steps, px, py;
+
+    /* Clipping the parameter of the line to the tile (Liang-Barsky). */
+    p[0] = -dx; q[0] = a[0] - x0;
+    p[1] = dx;  q[1] = x1 - a[0];
+    p[2] = -dy; q[2] = a[1] - y0;
+    p[3] = dy;  q[3] = y1 - a[1];
+    for (idx = 0; idx < 4; idx++) {
+        if (p[idx] == 0.0f) {
+            if (q[idx] < 0.0f)
+                return;
+        } else {
+            r = q[idx] / p[idx];
+            if (p[idx] < 0.0f) {
+                if (r > t1)
+                    return;
+                t0 = std::max(t0, r);
+            } else {
+                if (r < t0)
+                    return;
+                t1 = std::min(t1, r);
+            }
+        }
+    }
+
+    /* The steps come from the part inside the tile, as the ends of a line clipped near
+     * the camera can be far out of the screen; it is walked from its clipped start. */
+    start[0] = a[0] + dx * t0;
+    start[1] = a[1] + dy * t0;
+    start[2] = a[2] + dz * t0;
+    dx *= t1 - t0;
+    dy *= t1 - t0;
+    dz *= t1 - t0;
+    steps = std::max(1, (int) ceilf(std::max(fabsf(dx), fabsf(dy))));
+
+    for (idx = 0; idx <= steps; idx++) {
+        t = (float) idx / steps;
+        px = (int) floorf(start[0] + dx * t);
+        py = (int) floorf(start[1] + dy * t);
+        if (px < x0 || px >= x1 || py < y0 || py >= y1)
+            continue;
+
+        z = start[2] + dz * t;
+        if (z < depthBuf[py * stride + px] && z >= 0.0f && z <= 1.0f) {
+            depthBuf[py * stride + px] = z;
+            colorBuf[py * stride + px] = prim.color;
+        }
+    }
+}
+
+/**
+ * Draws a point if it is inside the tile.
+ * @param   RasterPrim  prim    The point.
+ * @param   int         x0, y0  The first pixel of the tile.
+ * @param   int         x1, y1  The end of the tile (excluded).
+ */
+void
+Rasterizer::drawPoint(const RasterPrim& prim, int x0, int y0, int x1, int y1)
+{
+    int px = (int) floorf(prim.v[0][0]), py = (int) floorf(prim.v[0][1]);
+    float z = prim.v[0][2];
+
+    if (px < x0 || px >= x1 || py < y0 || py >= y1)
+        return;
+
+    if (z < depthBuf[py * stride + px] && z >= 0.0f && z <= 1.0f) {
+        depthBuf[py * stride + px] = z;
+        colorBuf[py * stride + px] = prim.color;
+    }
+}
+
+/**
+ * Copies the framebuffer.
+ * @param   GLuint          w       The width of the frame, it must be the one of the framebuffer.
+ * @param   GLuint          h       The height of the frame, it must be the one of the framebuffer.
+ * @param   unsigned char   * pixels    The buffer of w * h * 4 bytes.
+ * @return  Whether the pixels could be copied.
+ */
+bool
+Rasterizer::readPixels(GLuint w, GLuint h, unsigned char * pixels)
+{
+    unsigned row;
+
+    if (pixels == NULL || w != width || h != height)
+        return false;
+
+    for (row = 0; row < height; row++)
+        memcpy(pixels + row * width * 4, &colorBuf[row * stride], width * 4);
+
+    return true;
+}
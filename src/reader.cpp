@@ -0,0 +1,489 @@
+/**
+ * Implementation of the file reader.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "reader.h"
+#include "profiler.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define READER_RING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+using namespace GEngine;
+
+FileReader * FileReader::shared = NULL;
+
+#ifdef READER_RING
+/* The user data of the entry waking the reaper up to stop it. */
+#define READER_STOP     0
+
+/**
+ * The system calls of the ring, which the C library does not wrap.
+ */
+static int
+ringSetup(unsigned entries, struct io_uring_params * params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int
+ringEnter(int ring, unsigned submit, unsigned complete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, ring, submit, complete, flags, NULL, 0);
+}
+
+static int
+ringRegister(int ring, unsigned opcode, const void * args, unsigned count)
+{
+    return syscall(__NR_io_uring_register, ring, opcode, args, count);
+}
+
+/**
+ * Asks the ring whether it can read into any buffer: IORING_OP_READ came after the ring,
+ * so the kernels before 5.6 create it but fail those reads, and do not have the probe.
+ * @param   int     ring    The ring.
+ * @return  Whether the reads which are not fixed are supported.
+ */
+static bool
+ringReads(int ring)
+{
+    unsigned char buffer[sizeof(struct io_uring_probe) +
+        (IORING_OP_READ + 1) * sizeof(struct io_uring_probe_op)];
+    struct io_uring_probe * probe = (struct io_uring_probe *) buffer;
+
+    memset(buffer, 0, sizeof(buffer));
+    if (ringRegister(ring, IORING_REGISTER_PROBE, probe, IORING_OP_READ + 1) < 0)
+        return false;
+
+    return probe->ops_len > IORING_OP_READ &&
+        (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+#endif
+
+/**
+ * Constructor of the reader.
+ * @param   JobPool * pool  The pool calling the functions of the reads, NULL for the
+ *                          shared one.
+ * @param   bool    ring    Whether to read through a ring, if it can be created.
+ */
+FileReader::FileReader(JobPool * pool, bool ring)
+{
+    this->pool = pool != NULL ? pool : JobPool::instance();
+    outstanding = 0;
+    this->ring = -1;
+    depth = inFlight = unsent = registered = 0;
+    sqMap = cqMap = sqes = cqes = NULL;
+    threads = NULL;
+
+    if (!ring || !openRing())
+        threads = new JobPool(READER_THREADS);
+}
+
+/**
+ * Destructor of the reader. The reads queued and not submitted are dropped.
+ */
+FileReader::~FileReader()
+{
+    wait();
+    for (unsigned idx = 0; idx < queued.size(); idx++)
+        delete queued[idx];
+
+    closeRing();
+    delete threads;
+}
+
+/**
+ * Creates the ring and maps its queues, then starts the reaper.
+ * @return  Whether the ring was created, false if the kernel does not have it or cannot
+ *          read through it.
+ */
+bool
+FileReader::openRing()
+{
+#ifdef READER_RING
+    struct io_uring_params params;
+    unsigned char * sq, * cq;
+
+    memset(&params, 0, sizeof(params));
+    if ((ring = ringSetup(READER_DEPTH, &params)) < 0) {
+        ring = -1;
+        return false;
+    }
+    if (!ringReads(ring)) {
+        ::close(ring);
+        ring = -1;
+        return false;
+    }
+
+    sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        sqSize = cqSize = std::max(sqSize, cqSize);
+
+    sqMap = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+            IORING_OFF_SQ_RING);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        cqMap = sqMap;
+    else
+        cqMap = mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+                IORING_OFF_CQ_RING);
+    sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+            IORING_OFF_SQES);
+
+    if (sqMap == MAP_FAILED || cqMap == MAP_FAILED || sqes == MAP_FAILED) {
+        sqMap = sqMap == MAP_FAILED ? NULL : sqMap;
+        cqMap = cqMap == MAP_FAILED ? NULL : cqMap;
+        sqes = sqes == MAP_FAILED ? NULL : sqes;
+        closeRing();
+        return false;
+    }
+
+    sq = (unsigned char *) sqMap;
+    cq = (unsigned char *) cqMap;
+    sqHead = (unsigned *) (sq + params.sq_off.head);
+    sqTail = (unsigned *) (sq + params.sq_off.tail);
+    sqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+    sqArray = (unsigned *) (sq + params.sq_off.array);
+    cqHead = (unsigned *) (cq + params.cq_off.head);
+    cqTail = (unsigned *) (cq + params.cq_off.tail);
+    cqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+
+    /* The completion queue is twice as large, so it never overflows. */
+    depth = params.sq_entries;
+    reaper = std::thread(&FileReader::reap, this);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Stops the reaper, unmaps the queues and destroys the ring. There must be no read in
+ * the ring.
+ */
+void
+FileReader::closeRing()
+{
+#ifdef READER_RING
+    struct io_uring_sqe * sqe;
+    unsigned tail;
+
+    if (ring < 0)
+        return;
+
+    if (reaper.joinable()) {
+        std::unique_lock<std::mutex> guard(lock);
+
+        tail = *sqTail;
+        sqe = (struct io_uring_sqe *) sqes + (tail & *sqMask);
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = READER_STOP;
+        sqArray[tail & *sqMask] = tail & *sqMask;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ringEnter(ring, ++unsent, 0, 0);
+        guard.unlock();
+
+        reaper.join();
+    }
+
+    if (sqes != NULL)
+        munmap(sqes, sqesSize);
+    if (cqMap != NULL && cqMap != sqMap)
+        munmap(cqMap, cqSize);
+    if (sqMap != NULL)
+        munmap(sqMap, sqSize);
+    ::close(ring);
+    ring = -1;
+#endif
+}
+
+/**
+ * Sends the reads waiting to the ring, as many as there is room for, with a single call.
+ * The reads into registered buffers use them. It must be called with the lock held.
+ */
+void
+FileReader::push()
+{
+#ifdef READER_RING
+    struct io_uring_sqe * sqe;
+    unsigned tail = *sqTail, slot;
+    int sent;
+    FileRead * req;
+
+    while (!waiting.empty() && inFlight < depth) {
+        req = waiting.front();
+        waiting.pop_front();
+
+        slot = tail & *sqMask;
+        sqe = (struct io_uring_sqe *) sqes + slot;
+        memset(sqe, 0, sizeof(*sqe));
+        if (req->registered >= 0 && (unsigned) req->registered < registered) {
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->buf_index = req->registered;
+        } else
+            sqe->opcode = IORING_OP_READ;
+        sqe->fd = req->fd;
+        sqe->addr = (unsigned long) (req->buffer + req->done);
+        sqe->len = std::min(req->length - req->done, (size_t) 1 << 30);
+        sqe->off = req->offset + req->done;
+        sqe->user_data = (unsigned long) req;
+        sqArray[slot] = slot;
+
+        tail++;
+        unsent++;
+        inFlight++;
+    }
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+    /* The entries the kernel did not take are sent with the next call. */
+    if (unsent > 0 && (sent = ringEnter(ring, unsent, 0, 0)) > 0)
+        unsent -= sent;
+#endif
+}
+
+/**
+ * The loop of the reaper: it waits for reads done, sends again the ones which read only a
+ * part of their range, and queues the functions of the others into the pool.
+ */
+void
+FileReader::reap()
+{
+#ifdef READER_RING
+    struct io_uring_cqe * cqe;
+    std::vector<std::pair<FileRead *, long>> reaped, done;
+    FileReadQueue again;
+    unsigned head, tail;
+    bool stopping = false;
+    FileRead * req;
+    long res;
+
+    Profiler::setThreadName("File reader");
+
+    while (!stopping) {
+        ringEnter(ring, 0, 1, IORING_ENTER_GETEVENTS);
+
+        head = *cqHead;
+        tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            cqe = (struct io_uring_cqe *) cqes + (head & *cqMask);
+            if (cqe->user_data == READER_STOP)
+                stopping = true;
+            else
+                reaped.push_back(std::make_pair((FileRead *) (unsigned long) cqe->user_data,
+                            (long) cqe->res));
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            for (unsigned idx = 0; idx < reaped.size(); idx++) {
+                req = reaped[idx].first;
+                res = reaped[idx].second;
+
+                if (res == -EINTR || res == -EAGAIN ||
+                        (res > 0 && req->done + res < req->length)) {
+                    req->done += std::max(res, 0L);
+                    again.push_back(req);
+                } else
+                    done.push_back(std::make_pair(req, res < 0 ? res : req->done + res));
+            }
+
+            inFlight -= reaped.size();
+            waiting.insert(waiting.begin(), again.begin(), again.end());
+            push();
+        }
+
+        for (unsigned idx = 0; idx < done.size(); idx++)
+            complete(done[idx].first, done[idx].second);
+        reaped.clear();
+        again.clear();
+        done.clear();
+    }
+#endif
+}
+
+/**
+ * Reads a whole range with pread, until it is read or the file ends.
+ * @param   FileRead    * req   The read.
+ */
+void
+FileReader::readRange(FileRead * req)
+{
+    ssize_t count = 0;
+
+    while (req->done < req->length) {
+        count = pread(req->fd, req->buffer + req->done, req->length - req->done,
+                req->offset + req->done);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        req->done += count;
+    }
+
+    complete(req, count < 0 ? - (long) errno : (long) req->done);
+}
+
+/**
+ * Queues the function of a read done into the pool, which frees the read after it.
+ * @param   FileRead    * req       The read.
+ * @param   long        result      The bytes read, or -errno.
+ */
+void
+FileReader::complete(FileRead * req, long result)
+{
+    pool->submit([this, req, result]() {
+        req->callback(result);
+        delete req;
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (--outstanding == 0)
+            finished.notify_all();
+    });
+}
+
+/**
+ * Registers buffers with the kernel. Without the ring it does nothing, and the reads into
+ * them are like the other ones.
+ * @param   void        * buffers   The buffers.
+ * @param   size_t      * sizes     The size of each buffer.
+ * @param   unsigned    count       The number of buffers.
+ * @return  Whether they were registered; if not, reading into them still works.
+ */
+bool
+FileReader::registerBuffers(void * const * buffers, const size_t * sizes, unsigned count)
+{
+#ifdef READER_RING
+    std::vector<struct iovec> vecs(count);
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (ring < 0)
+        return true;
+
+    if (registered > 0)
+        ringRegister(ring, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    registered = 0;
+
+    for (unsigned idx = 0; idx < count; idx++) {
+        vecs[idx].iov_base = buffers[idx];
+        vecs[idx].iov_len = sizes[idx];
+    }
+    if (ringRegister(ring, IORING_REGISTER_BUFFERS, vecs.data(), count) < 0)
+        return false;
+
+    registered = count;
+    return true;
+#else
+    return true;
+#endif
+}
+
+/**
+ * Queues a read.
+ * @param   int         fd          The file.
+ * @param   void        * buffer    The buffer receiving the bytes.
+ * @param   size_t      length      The bytes to read.
+ * @param   off_t       offset      The position of the first byte in the file.
+ * @param   ReadCallback    done    The function called with the bytes read, fewer than
+ *                                  length if the file ends before, or -errno.
+ * @param   int         fixed       The registered buffer containing the bytes, or -1.
+ */
+void
+FileReader::read(int fd, void * buffer, size_t length, off_t offset, ReadCallback done,
+        int fixed)
+{
+    FileRead * req = new FileRead();
+
+    req->fd = fd;
+    req->buffer = (unsigned char *) buffer;
+    req->length = length;
+    req->offset = offset;
+    req->done = 0;
+    req->registered = fixed;
+    req->callback = done;
+
+    std::lock_guard<std::mutex> guard(lock);
+    queued.push_back(req);
+    outstanding++;
+}
+
+/**
+ * Sends the reads queued, with a single call to the kernel for the ones fitting in the
+ * ring, or to the threads of the reader without it.
+ * @return  The number of reads sent.
+ */
+unsigned
+FileReader::submit()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    unsigned count = queued.size();
+
+    PROFILE_SCOPE("FileReader::submit");
+
+    if (ring >= 0) {
+        waiting.insert(waiting.end(), queued.begin(), queued.end());
+        push();
+    } else {
+        for (unsigned idx = 0; idx < queued.size(); idx++) {
+            FileRead * req = queued[idx];
+
+            threads->submit([this, req]() { readRange(req); });
+        }
+    }
+    queued.clear();
+
+    return count;
+}
+
+/**
+ * Waits for the reads submitted and their functions.
+ */
+void
+FileReader::wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    while (outstanding > queued.size())
+        finished.wait(guard);
+}
+
+/**
+ * Returns whether the reads go through the ring of the kernel.
+ * @return  True with the ring, false with the threads.
+ */
+bool
+FileReader::isRing() const
+{
+    return ring >= 0;
+}
+
+/**
+ * Gets the reader shared by all the engine, creating it on the first call.
+ * @return  The shared reader.
+ */
+FileReader *
+FileReader::instance()
+{
+    static std::once_flag created;
+
+    std::call_once(created, []() { shared = new FileReader(); });
+    return shared;
+}
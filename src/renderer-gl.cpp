@@ -0,0 +1,527 @@
+/**
+ * Implementation of the renderer using the fixed function pipeline of OpenGL.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "renderer.h"
+#include "camera.h"
+#include "light.h"
+#include "material.h"
+#include "stats.h"
+#include "glstate.h"
+#include <GL/glext.h>
+#include <stddef.h>
+#include <string.h>
+
+using namespace GEngine;
+
+/* The first location of the matrix of the instances, which takes four of them. The
+ * location 0 is the one of gl_Vertex. */
+#define INSTANCE_LOCATION   4
+
+/* Writes the value of a macro as a string, to give the number of lights to the shader. */
+#define STRING(x)           #x
+#define MACRO_STRING(x)     STRING(x)
+
+/**
+ * The vertex shader drawing the instances. It places each vertex with the matrix of its
+ * instance and lights it as the fixed function pipeline does with the light model set by
+ * the display: local viewer, both faces lit and separate specular color. The fragments
+ * are still shaded by the fixed function pipeline.
+ */
+static const char * instanceShader =
+    "#version 120\n"
+    "attribute mat4 instance;\n"
+    "uniform float lighting;\n"
+    "uniform float lights[" MACRO_STRING(GLSTATE_LIGHTS) "];\n"
+    "void shade(vec3 eye, vec3 normal, out vec4 color, out vec4 spec)\n"
+    "{\n"
+    "    color = gl_FrontLightModelProduct.sceneColor;\n"
+    "    spec = vec4(0.0);\n"
+    "    for (int i = 0; i < " MACRO_STRING(GLSTATE_LIGHTS) "; i++) {\n"
+    "        if (lights[i] == 0.0)\n"
+    "            continue;\n"
+    "        vec4 pos = gl_LightSource[i].position;\n"
+    "        vec3 dir = pos.xyz;\n"
+    "        float att = 1.0;\n"
+    "        if (pos.w != 0.0) {\n"
+    "            dir = pos.xyz / pos.w - eye;\n"
+    "            float dist = length(dir);\n"
+    "            att = 1.0 / (gl_LightSource[i].constantAttenuation +\n"
+    "                gl_LightSource[i].linearAttenuation * dist +\n"
+    "                gl_LightSource[i].quadraticAttenuation * dist * dist);\n"
+    "            if (gl_LightSource[i].spotCutoff != 180.0) {\n"
+    "                float spot = dot(normalize(-dir),\n"
+    "                    normalize(gl_LightSource[i].spotDirection));\n"
+    "                att *= spot < gl_LightSource[i].spotCosCutoff ? 0.0 :\n"
+    "                    pow(spot, gl_LightSource[i].spotExponent);\n"
+    "            }\n"
+    "        }\n"
+    "        dir = normalize(dir);\n"
+    "        float diffuse = max(dot(normal, dir), 0.0);\n"
+    "        color += att * (gl_FrontLightProduct[i].ambient +\n"
+    "            diffuse * gl_FrontLightProduct[i].diffuse);\n"
+    "        if (diffuse > 0.0)\n"
+    "            spec += att * gl_FrontLightProduct[i].specular * pow(max(dot(normal,\n"
+    "                normalize(dir - normalize(eye))), 0.0), gl_FrontMaterial.shininess);\n"
+    "    }\n"
+    "    color.a = gl_FrontMaterial.diffuse.a;\n"
+    "}\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 eye = gl_ModelViewMatrix * (instance * gl_Vertex);\n"
+    "    vec3 normal = normalize(gl_NormalMatrix * (mat3(instance) * gl_Normal));\n"
+    "    gl_Position = gl_ProjectionMatrix * eye;\n"
+    "    gl_ClipVertex = eye;\n"
+    "    gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+    "    if (lighting == 0.0) {\n"
+    "        gl_FrontColor = gl_BackColor = gl_Color;\n"
+    "        gl_FrontSecondaryColor = gl_BackSecondaryColor = vec4(0.0);\n"
+    "    } else {\n"
+    "        shade(eye.xyz, normal, gl_FrontColor, gl_FrontSecondaryColor);\n"
+    "        shade(eye.xyz, -normal, gl_BackColor, gl_BackSecondaryColor);\n"
+    "    }\n"
+    "}\n";
+
+/**
+ * Destructor of the renderers.
+ */
+Renderer::~Renderer()
+{
+}
+
+/**
+ * Draws the geometry of a static figure as immediate primitives, for the renderers
+ * without buffer objects.
+ * @param   GeometryBuffer  * geometry  The geometry to draw.
+ */
+void
+Renderer::drawStatic(GeometryBuffer * geometry)
+{
+    const BufferDraw * draw, * last = geometry->getDraws() + geometry->getDrawCount();
+    const BufferVertex * vert;
+    unsigned idx;
+
+    for (draw = geometry->getDraws(); draw != last; draw++) {
+        begin(draw->mode);
+        for (idx = draw->first; idx < draw->first + draw->count; idx++) {
+            vert = &geometry->getVertices()[geometry->getIndices()[idx]];
+            vertex(vert->x, vert->y, vert->z, vert->s, vert->t);
+        }
+        end();
+    }
+}
+
+/**
+ * Draws the geometry once for each matrix, transforming its vertices here, for the
+ * renderers without instancing.
+ * @param   GeometryBuffer  * geometry  The geometry to draw.
+ * @param   GLfloat     * matrices  The matrices of the instances, 16 floats by columns each.
+ * @param   unsigned    count       The number of instances.
+ */
+void
+Renderer::drawInstanced(GeometryBuffer * geometry, const GLfloat * matrices, unsigned count)
+{
+    const BufferDraw * draw, * last = geometry->getDraws() + geometry->getDrawCount();
+    const BufferVertex * vert;
+    const GLfloat * mat;
+    unsigned idx;
+
+    for (mat = matrices; mat != matrices + count * 16; mat += 16) {
+        for (draw = geometry->getDraws(); draw != last; draw++) {
+            begin(draw->mode);
+            for (idx = draw->first; idx < draw->first + draw->count; idx++) {
+                vert = &geometry->getVertices()[geometry->getIndices()[idx]];
+                vertex(mat[0] * vert->x + mat[4] * vert->y + mat[8] * vert->z + mat[12],
+                        mat[1] * vert->x + mat[5] * vert->y + mat[9] * vert->z + mat[13],
+                        mat[2] * vert->x + mat[6] * vert->y + mat[10] * vert->z + mat[14],
+                        vert->s, vert->t);
+            }
+            end();
+        }
+    }
+}
+
+/**
+ * Constructor of the renderer. The program drawing the instances is built the first time
+ * it is needed, with the context current.
+ */
+GLRenderer::GLRenderer()
+{
+    program = instanceVbo = 0;
+    lightingLoc = lightsLoc = -1;
+    programTried = false;
+
+    stream = NULL;
+    batchMode = GL_POINTS;
+    primFirst = 0;
+}
+
+/**
+ * Destructor of the renderer, freeing the program and the buffers.
+ */
+GLRenderer::~GLRenderer()
+{
+    delete stream;
+    if (program != 0)
+        glDeleteProgram(program);
+    if (instanceVbo != 0)
+        glDeleteBuffers(1, &instanceVbo);
+}
+
+/**
+ * Builds the program drawing the instances, only the vertex stage.
+ * @return  Whether the program could be built.
+ */
+bool
+GLRenderer::buildProgram()
+{
+    GLuint shader;
+    GLint ok;
+
+    programTried = true;
+
+    shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(shader, 1, &instanceShader, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        glDeleteShader(shader);
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, shader);
+    glBindAttribLocation(program, INSTANCE_LOCATION, "instance");
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    lightingLoc = glGetUniformLocation(program, "lighting");
+    lightsLoc = glGetUniformLocation(program, "lights");
+    glGenBuffers(1, &instanceVbo);
+
+    return true;
+}
+
+/**
+ * Draws the primitives written since the last flush from the stream buffer, with a single
+ * call for all of them.
+ */
+void
+GLRenderer::flush()
+{
+    if (firsts.empty())
+        return;
+
+    stream->bind();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(BufferVertex), (void *) offsetof(BufferVertex, x));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(BufferVertex), (void *) offsetof(BufferVertex, s));
+
+    if (firsts.size() == 1)
+        glDrawArrays(batchMode, firsts[0], counts[0]);
+    else
+        glMultiDrawArrays(batchMode, firsts.data(), counts.data(), firsts.size());
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    firsts.clear();
+    counts.clear();
+}
+
+/**
+ * Cleans the screen and sets the viewport and the default color.
+ * @param   GLuint  position[2]     The position of the viewport.
+ * @param   GLuint  screen[3]       The dimensions of the viewport.
+ * @param   GLfloat bgcolor[3]      The color to clean the screen.
+ * @param   GLfloat fgcolor[3]      The color for the figures without material.
+ */
+void
+GLRenderer::beginFrame(const GLuint position[2], const GLuint screen[3],
+        const GLfloat bgcolor[3], const GLfloat fgcolor[3])
+{
+    glClearColor(bgcolor[0], bgcolor[1], bgcolor[2], 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(position[0], position[1], screen[0], screen[1]);
+    glColor3f(fgcolor[0], fgcolor[1], fgcolor[2]);
+}
+
+/**
+ * Finishes the frame, drawing what is left. The buffers are swapped by the display.
+ */
+void
+GLRenderer::endFrame()
+{
+    flush();
+
+    if (stream != NULL)
+        stream->endFrame();
+}
+
+/**
+ * Loads the modelview and projection matrices of the camera.
+ * @param   Camera  * cam   The camera to activate.
+ */
+void
+GLRenderer::activateCamera(Camera * cam)
+{
+    flush();
+    cam->activate();
+}
+
+/**
+ * Restores the matrices previous to the camera.
+ * @param   Camera  * cam   The camera to deactivate.
+ */
+void
+GLRenderer::deactivateCamera(Camera * cam)
+{
+    flush();
+    cam->deactivate();
+}
+
+/**
+ * Sets the ambient light of the light model.
+ * @param   GLfloat ambient[4]  The RGBA ambient light.
+ */
+void
+GLRenderer::setAmbient(const GLfloat ambient[4])
+{
+    flush();
+    GLState::lightAmbient(ambient);
+}
+
+/**
+ * Uploads and enables a source of light.
+ * @param   Light   * light     The light to upload.
+ */
+void
+GLRenderer::setLight(Light * light)
+{
+    flush();
+    light->activate();
+}
+
+/**
+ * Sets the polygon mode.
+ * @param   GLenum  face    The faces affected (GL_FRONT, GL_BACK or GL_FRONT_AND_BACK).
+ * @param   GLenum  mode    The mode (GL_POINT, GL_LINE or GL_FILL).
+ */
+void
+GLRenderer::setPolygonMode(GLenum face, GLenum mode)
+{
+    flush();
+    if (GLState::polygonMode(face, mode))
+        RenderStats::frame.polygonModeChanges++;
+}
+
+/**
+ * Activates a material.
+ * @param   Material    * mat   The material to activate.
+ */
+void
+GLRenderer::setMaterial(Material * mat)
+{
+    flush();
+    mat->activate();
+}
+
+/**
+ * Deactivates a material.
+ * @param   Material    * mat   The material to deactivate.
+ */
+void
+GLRenderer::unsetMaterial(Material * mat)
+{
+    flush();
+    mat->deactivate();
+}
+
+/**
+ * Multiplies a matrix into the modelview, saving the previous one.
+ * @param   GLfloat matrix[16]  The matrix, stored by columns.
+ */
+void
+GLRenderer::pushMatrix(const GLfloat matrix[16])
+{
+    flush();
+    GLState::matrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glMultMatrixf(matrix);
+}
+
+/**
+ * Restores the modelview saved by the last pushMatrix().
+ */
+void
+GLRenderer::popMatrix()
+{
+    flush();
+    GLState::matrixMode(GL_MODELVIEW);
+    glPopMatrix();
+}
+
+/**
+ * Starts a primitive. The ones of another kind written before are drawn first.
+ * @param   GLenum  mode    The kind of primitive, as glBegin.
+ */
+void
+GLRenderer::begin(GLenum mode)
+{
+    if (stream == NULL)
+        stream = new StreamBuffer(GL_ARRAY_BUFFER, STREAM_VERTICES * sizeof(BufferVertex));
+
+    if (mode != batchMode)
+        flush();
+
+    batchMode = mode;
+    primFirst = stream->getOffset() / sizeof(BufferVertex);
+}
+
+/**
+ * Adds a vertex to the current primitive.
+ * @param   GLdouble    x, y, z     The coordinates of the vertex.
+ * @param   GLdouble    s, t        The texture coordinates of the vertex.
+ */
+void
+GLRenderer::vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s, GLdouble t)
+{
+    BufferVertex vert = { (GLfloat) x, (GLfloat) y, (GLfloat) z, (GLfloat) s, (GLfloat) t };
+    GLsizeiptr written;
+
+    /* With the region full, the primitives written are drawn and the current one goes on
+     * at the start of the next region. */
+    if (stream->getSpace() < (GLsizeiptr) sizeof(BufferVertex)) {
+        written = stream->getOffset() - primFirst * sizeof(BufferVertex);
+
+        flush();
+        stream->wrap(written);
+        primFirst = (stream->getOffset() - written) / sizeof(BufferVertex);
+        if (stream->getSpace() < (GLsizeiptr) sizeof(BufferVertex))
+            return;
+    }
+
+    memcpy(stream->getPointer(), &vert, sizeof(vert));
+    stream->commit(sizeof(vert));
+}
+
+/**
+ * Finishes the current primitive, adding it to the ones to draw. The primitives which are
+ * independent lists, as GL_TRIANGLES, are joined with the previous one.
+ */
+void
+GLRenderer::end()
+{
+    GLsizei count = stream->getOffset() / sizeof(BufferVertex) - primFirst;
+
+    if (count == 0)
+        return;
+
+    if (!firsts.empty() && (GLuint) (firsts.back() + counts.back()) == primFirst &&
+            (batchMode == GL_POINTS || batchMode == GL_LINES ||
+             batchMode == GL_TRIANGLES || batchMode == GL_QUADS)) {
+        counts.back() += count;
+        return;
+    }
+
+    firsts.push_back(primFirst);
+    counts.push_back(count);
+}
+
+/**
+ * Draws the geometry of a static figure from its buffer objects.
+ * @param   GeometryBuffer  * geometry  The geometry to draw.
+ */
+void
+GLRenderer::drawStatic(GeometryBuffer * geometry)
+{
+    flush();
+    geometry->draw();
+}
+
+/**
+ * Draws the instances of a geometry. With OpenGL 3.3 they are drawn at once: the matrices
+ * are streamed into a buffer read once per instance by the shader. Otherwise, each one is
+ * drawn from the buffer objects of the geometry with its matrix multiplied into the
+ * modelview.
+ * @param   GeometryBuffer  * geometry  The geometry to draw.
+ * @param   GLfloat     * matrices  The matrices of the instances, 16 floats by columns each.
+ * @param   unsigned    count       The number of instances.
+ */
+void
+GLRenderer::drawInstanced(GeometryBuffer * geometry, const GLfloat * matrices, unsigned count)
+{
+    GLfloat lights[GLSTATE_LIGHTS];
+    unsigned col, idx;
+
+    flush();
+
+    if (!programTried && GLState::hasInstancing())
+        buildProgram();
+
+    if (program == 0) {
+        for (idx = 0; idx < count; idx++) {
+            pushMatrix(matrices + idx * 16);
+            geometry->draw();
+            popMatrix();
+        }
+        return;
+    }
+
+    for (idx = 0; idx < GLSTATE_LIGHTS; idx++)
+        lights[idx] = GLState::isEnabled(GL_LIGHT0 + idx) ? 1.0f : 0.0f;
+
+    glUseProgram(program);
+    glUniform1f(lightingLoc, GLState::isEnabled(GL_LIGHTING) ? 1.0f : 0.0f);
+    glUniform1fv(lightsLoc, GLSTATE_LIGHTS, lights);
+    GLState::enable(GL_VERTEX_PROGRAM_TWO_SIDE);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, count * 16 * sizeof(GLfloat), matrices, GL_STREAM_DRAW);
+    for (col = 0; col < 4; col++) {
+        glEnableVertexAttribArray(INSTANCE_LOCATION + col);
+        glVertexAttribPointer(INSTANCE_LOCATION + col, 4, GL_FLOAT, GL_FALSE,
+                16 * sizeof(GLfloat), (void *) (col * 4 * sizeof(GLfloat)));
+        glVertexAttribDivisor(INSTANCE_LOCATION + col, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    geometry->drawInstanced(count);
+
+    for (col = 0; col < 4; col++) {
+        glVertexAttribDivisor(INSTANCE_LOCATION + col, 0);
+        glDisableVertexAttribArray(INSTANCE_LOCATION + col);
+    }
+    glUseProgram(0);
+}
+
+/**
+ * Reads the back buffer of the current context.
+ * @param   GLuint          width   The width of the frame.
+ * @param   GLuint          height  The height of the frame.
+ * @param   unsigned char   * pixels    The buffer of width * height * 4 bytes.
+ * @return  Whether the pixels could be read.
+ */
+bool
+GLRenderer::readPixels(GLuint width, GLuint height, unsigned char * pixels)
+{
+    flush();
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    return glGetError() == GL_NO_ERROR;
+}
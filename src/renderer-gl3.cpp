@@ -0,0 +1,727 @@
+/**
+ * Implementation of the renderer using the core profile of OpenGL 3.3.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "renderer.h"
+#include "camera.h"
+#include "light.h"
+#include "material.h"
+#include "matrix.h"
+#include "stats.h"
+#include <GL/glext.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+using namespace GEngine;
+
+/* The attributes of the vertices: the position, the texture coordinates, the normal and
+ * the matrix of the instance, which takes four locations. */
+#define ATTR_POSITION   0
+#define ATTR_TEXCOORD   1
+#define ATTR_NORMAL     2
+#define ATTR_INSTANCE   3
+
+/* The binding points of the uniform buffers. */
+#define BIND_LIGHTS     0
+#define BIND_MATERIAL   1
+
+/* Writes the value of a macro as a string, to give the number of lights to the shader. */
+#define STRING(x)           #x
+#define MACRO_STRING(x)     STRING(x)
+
+/**
+ * The vertex shader: places the vertex with the matrix of its instance, the identity when
+ * the figure is not instanced, and the modelview.
+ */
+static const char * vertexShader =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 1) in vec2 texCoord;\n"
+    "layout(location = 2) in vec3 normal;\n"
+    "layout(location = 3) in mat4 instance;\n"
+    "uniform mat4 modelview;\n"
+    "uniform mat4 projection;\n"
+    "out vec3 eyePos;\n"
+    "out vec3 eyeNormal;\n"
+    "out vec2 uv;\n"
+    "void main()\n"
+    "{\n"
+    "    mat4 model = modelview * instance;\n"
+    "    vec4 eye = model * vec4(position, 1.0);\n"
+    "    eyePos = eye.xyz;\n"
+    "    eyeNormal = mat3(model) * normal;\n"
+    "    uv = texCoord;\n"
+    "    gl_Position = projection * eye;\n"
+    "}\n";
+
+/**
+ * The fragment shader: the lighting of the fixed function pipeline with a local viewer,
+ * both faces lit and the specular color added after the clamp, evaluated per fragment.
+ */
+static const char * fragmentShader =
+    "#version 330 core\n"
+    "struct LightSource {\n"
+    "    vec4 ambient;\n"
+    "    vec4 diffuse;\n"
+    "    vec4 specular;\n"
+    "    vec4 position;\n"
+    "    vec4 spotDirection;\n"     /* w: cosine of the cutoff. */
+    "    vec4 params;\n"            /* x: spot exponent, y: spot cutoff, z: enabled. */
+    "    vec4 attenuation;\n"
+    "};\n"
+    "layout(std140) uniform Lights {\n"
+    "    vec4 sceneAmbient;\n"
+    "    vec4 info;\n"              /* x: the number of lights used. */
+    "    LightSource lights[" MACRO_STRING(GL3_MAX_LIGHTS) "];\n"
+    "};\n"
+    "layout(std140) uniform Material {\n"
+    "    vec4 ambient;\n"
+    "    vec4 diffuse;\n"
+    "    vec4 specular;\n"
+    "    vec4 emission;\n"
+    "    vec4 shininess;\n"
+    "} material;\n"
+    "in vec3 eyePos;\n"
+    "in vec3 eyeNormal;\n"
+    "in vec2 uv;\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 normal = normalize(gl_FrontFacing ? eyeNormal : -eyeNormal);\n"
+    "    vec3 view = normalize(-eyePos);\n"
+    "    vec4 color = material.emission + material.ambient * sceneAmbient;\n"
+    "    vec3 spec = vec3(0.0);\n"
+    "    for (int i = 0; i < int(info.x); i++) {\n"
+    "        if (lights[i].params.z == 0.0)\n"
+    "            continue;\n"
+    "        vec3 dir = lights[i].position.xyz;\n"
+    "        float att = 1.0;\n"
+    "        if (lights[i].position.w != 0.0) {\n"
+    "            dir = lights[i].position.xyz / lights[i].position.w - eyePos;\n"
+    "            float dist = length(dir);\n"
+    "            att = 1.0 / dot(lights[i].attenuation.xyz, vec3(1.0, dist, dist * dist));\n"
+    "            if (lights[i].params.y != 180.0) {\n"
+    "                float spot = dot(normalize(-dir), normalize(lights[i].spotDirection.xyz));\n"
+    "                att *= spot < lights[i].spotDirection.w ? 0.0 :\n"
+    "                    pow(spot, lights[i].params.x);\n"
+    "            }\n"
+    "        }\n"
+    "        dir = normalize(dir);\n"
+    "        float diffuse = max(dot(normal, dir), 0.0);\n"
+    "        color += att * (lights[i].ambient * material.ambient +\n"
+    "            diffuse * lights[i].diffuse * material.diffuse);\n"
+    "        if (diffuse > 0.0)\n"
+    "            spec += att * lights[i].specular.rgb * material.specular.rgb *\n"
+    "                pow(max(dot(normal, normalize(dir + view)), 0.0), material.shininess.x);\n"
+    "    }\n"
+    "    color = clamp(color, 0.0, 1.0);\n"
+    "    fragColor = vec4(min(color.rgb + spec, vec3(1.0)), material.diffuse.a);\n"
+    "}\n";
+
+/* The default material of OpenGL: ambient, diffuse, specular, emission and shininess. */
+static const GLfloat defaultMaterial[5][4] = {
+    { 0.2f, 0.2f, 0.2f, 1.0f },
+    { 0.8f, 0.8f, 0.8f, 1.0f },
+    { 0.0f, 0.0f, 0.0f, 1.0f },
+    { 0.0f, 0.0f, 0.0f, 1.0f },
+    { 0.0f, 0.0f, 0.0f, 0.0f }
+};
+
+/* The properties of a material in the order of its uniform buffer. */
+static const GLenum materialProps[5] = {
+    GL_AMBIENT, GL_DIFFUSE, GL_SPECULAR, GL_EMISSION, GL_SHININESS
+};
+
+/**
+ * Compiles a shader, printing the log if it fails.
+ * @param   GLenum  type    The kind of shader.
+ * @param   char    * source    The source of the shader.
+ * @return  The shader, or 0 if it did not compile.
+ */
+static GLuint
+compileShader(GLenum type, const char * source)
+{
+    GLuint shader = glCreateShader(type);
+    GLchar log[1024];
+    GLint ok;
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "GL3: cannot compile a shader:\n%s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+/**
+ * Constructor of the renderer. The program and the buffers are built by the first frame,
+ * with the context current.
+ */
+GL3Renderer::GL3Renderer()
+{
+    program = vao = instanceVbo = 0;
+    vertexStream = indexStream = NULL;
+    lightUbo = materialUbo = 0;
+    modelviewLoc = projectionLoc = -1;
+
+    mat4Identity(modelview);
+    mat4Identity(projection);
+    polyMode = GL_FILL;
+
+    memset(lightBlock, 0, sizeof(lightBlock));
+    memcpy(materialBlock, defaultMaterial, sizeof(materialBlock));
+    matricesDirty = lightsDirty = materialDirty = true;
+
+    primMode = GL_POINTS;
+    primFirst = 0;
+}
+
+/**
+ * Destructor of the renderer, freeing the program and the buffers.
+ */
+GL3Renderer::~GL3Renderer()
+{
+    GLuint buffers[3] = { instanceVbo, lightUbo, materialUbo };
+
+    if (program == 0)
+        return;
+
+    delete vertexStream;
+    delete indexStream;
+    glDeleteProgram(program);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(3, buffers);
+}
+
+/**
+ * Builds the program, the vertex array and the buffers.
+ * @return  Whether the program could be built.
+ */
+bool
+GL3Renderer::init()
+{
+    GLuint vert, frag;
+    GLint ok;
+
+    vert = compileShader(GL_VERTEX_SHADER, vertexShader);
+    frag = compileShader(GL_FRAGMENT_SHADER, fragmentShader);
+    if (vert == 0 || frag == 0) {
+        glDeleteShader(vert);
+        glDeleteShader(frag);
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vert);
+    glAttachShader(program, frag);
+    glLinkProgram(program);
+    glDeleteShader(vert);
+    glDeleteShader(frag);
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        fprintf(stderr, "GL3: cannot link the program\n");
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    modelviewLoc = glGetUniformLocation(program, "modelview");
+    projectionLoc = glGetUniformLocation(program, "projection");
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Lights"), BIND_LIGHTS);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Material"),
+            BIND_MATERIAL);
+
+    /* The buffer of the indices is bound to the vertex array, so it is created with it
+     * bound. Each vertex gives at most three indices, as the corners of a triangle. */
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    vertexStream = new StreamBuffer(GL_ARRAY_BUFFER, STREAM_VERTICES * sizeof(BufferVertex));
+    indexStream = new StreamBuffer(GL_ELEMENT_ARRAY_BUFFER,
+            3 * STREAM_VERTICES * sizeof(GLuint));
+    glBindVertexArray(0);
+    glGenBuffers(1, &instanceVbo);
+    glGenBuffers(1, &lightUbo);
+    glGenBuffers(1, &materialUbo);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, lightUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(lightBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, materialUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(materialBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    matricesDirty = lightsDirty = materialDirty = true;
+    return true;
+}
+
+/**
+ * Uploads the matrices and the uniform buffers changed since the last draw. The figures
+ * are not instanced unless drawInstanced() says it, so the matrix of the instance is the
+ * identity, given as the constant value of its attributes.
+ */
+void
+GL3Renderer::applyState()
+{
+    GLfloat matrix[16];
+    unsigned idx;
+
+    if (matricesDirty) {
+        for (idx = 0; idx < 16; idx++)
+            matrix[idx] = modelview[idx];
+        glUniformMatrix4fv(modelviewLoc, 1, GL_FALSE, matrix);
+        for (idx = 0; idx < 16; idx++)
+            matrix[idx] = projection[idx];
+        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, matrix);
+        matricesDirty = false;
+    }
+
+    if (lightsDirty) {
+        glBindBuffer(GL_UNIFORM_BUFFER, lightUbo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(lightBlock), lightBlock);
+        lightsDirty = false;
+    }
+
+    if (materialDirty) {
+        glBindBuffer(GL_UNIFORM_BUFFER, materialUbo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(materialBlock), materialBlock);
+        materialDirty = false;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glVertexAttrib3f(ATTR_NORMAL, 0.0f, 0.0f, 1.0f);
+    for (idx = 0; idx < 4; idx++)
+        glVertexAttrib4f(ATTR_INSTANCE + idx, idx == 0, idx == 1, idx == 2, idx == 3);
+}
+
+/**
+ * Draws the primitives written since the last flush, with a draw for the points, one for
+ * the lines and one for the triangles. Their indices are written after the ones of the
+ * previous flush in the stream of indices.
+ */
+void
+GL3Renderer::flush()
+{
+    const GLenum modes[3] = { GL_POINTS, GL_LINES, GL_TRIANGLES };
+    BufferIndexList * lists[3] = { &points, &lines, &triangles };
+    GLsizeiptr size = (points.size() + lines.size() + triangles.size()) * sizeof(GLuint);
+    GLintptr offset;
+    unsigned idx;
+
+    if (size == 0)
+        return;
+
+    applyState();
+
+    if (indexStream->getSpace() < size)
+        indexStream->wrap();
+    offset = indexStream->getOffset();
+    for (idx = 0; idx < 3; idx++) {
+        memcpy(indexStream->getPointer(), lists[idx]->data(),
+                lists[idx]->size() * sizeof(GLuint));
+        indexStream->commit(lists[idx]->size() * sizeof(GLuint));
+    }
+
+    vertexStream->bind();
+    glEnableVertexAttribArray(ATTR_POSITION);
+    glEnableVertexAttribArray(ATTR_TEXCOORD);
+    glVertexAttribPointer(ATTR_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(BufferVertex),
+            (void *) offsetof(BufferVertex, x));
+    glVertexAttribPointer(ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(BufferVertex),
+            (void *) offsetof(BufferVertex, s));
+
+    /* The three lists go one after the other. */
+    indexStream->bind();
+    for (idx = 0; idx < 3; idx++) {
+        if (lists[idx]->empty())
+            continue;
+
+        glDrawElements(modes[idx], lists[idx]->size(), GL_UNSIGNED_INT, (void *) offset);
+        offset += lists[idx]->size() * sizeof(GLuint);
+    }
+
+    glDisableVertexAttribArray(ATTR_TEXCOORD);
+    glDisableVertexAttribArray(ATTR_POSITION);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    points.clear();
+    lines.clear();
+    triangles.clear();
+}
+
+/**
+ * Cleans the screen and sets the viewport, building the program the first time.
+ * @param   GLuint  position[2]     The position of the viewport.
+ * @param   GLuint  screen[3]       The dimensions of the viewport.
+ * @param   GLfloat bgcolor[3]      The color to clean the screen.
+ * @param   GLfloat fgcolor[3]      The color for the figures without material, unused
+ *                                  since the figures are always lit.
+ */
+void
+GL3Renderer::beginFrame(const GLuint position[2], const GLuint screen[3],
+        const GLfloat bgcolor[3], const GLfloat fgcolor[3])
+{
+    if (program == 0 && !init())
+        return;
+
+    glClearColor(bgcolor[0], bgcolor[1], bgcolor[2], 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(position[0], position[1], screen[0], screen[1]);
+
+    glUseProgram(program);
+    glBindVertexArray(vao);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BIND_LIGHTS, lightUbo);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BIND_MATERIAL, materialUbo);
+}
+
+/**
+ * Draws what is left of the frame and releases the program, so the display can draw over
+ * the frame.
+ */
+void
+GL3Renderer::endFrame()
+{
+    if (program == 0)
+        return;
+
+    flush();
+    vertexStream->endFrame();
+    indexStream->endFrame();
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+/**
+ * Sets the modelview and the projection of the camera.
+ * @param   Camera  * cam   The camera to activate.
+ */
+void
+GL3Renderer::activateCamera(Camera * cam)
+{
+    flush();
+
+    cam->getModelview(modelview);
+    cam->getProjection(projection);
+    stack.clear();
+    matricesDirty = true;
+}
+
+/**
+ * Goes back to the identity matrices.
+ * @param   Camera  * cam   The camera, unused.
+ */
+void
+GL3Renderer::deactivateCamera(Camera * cam)
+{
+    flush();
+
+    mat4Identity(modelview);
+    mat4Identity(projection);
+    stack.clear();
+    matricesDirty = true;
+}
+
+/**
+ * Sets the ambient light of the scene.
+ * @param   GLfloat ambient[4]  The RGBA ambient light.
+ */
+void
+GL3Renderer::setAmbient(const GLfloat ambient[4])
+{
+    if (memcmp(lightBlock[0], ambient, 4 * sizeof(GLfloat)) == 0) {
+        RenderStats::frame.stateCallsSkipped++;
+        return;
+    }
+
+    flush();
+    memcpy(lightBlock[0], ambient, 4 * sizeof(GLfloat));
+    lightsDirty = true;
+}
+
+/**
+ * Uploads and enables a source of light. As glLightfv does, its position and the direction
+ * of the spot are transformed by the current modelview.
+ * @param   Light   * light     The light to upload.
+ */
+void
+GL3Renderer::setLight(Light * light)
+{
+    GLfloat slot[7][4];
+    double in[4], out[4];
+    unsigned idx;
+
+    if (light->idx >= GL3_MAX_LIGHTS)
+        return;
+
+    memcpy(slot[0], light->intA, sizeof(slot[0]));
+    memcpy(slot[1], light->intD, sizeof(slot[1]));
+    memcpy(slot[2], light->intSP, sizeof(slot[2]));
+
+    for (idx = 0; idx < 4; idx++)
+        in[idx] = light->position[idx];
+    mat4Transform(modelview, in, out);
+    for (idx = 0; idx < 4; idx++)
+        slot[3][idx] = out[idx];
+
+    for (idx = 0; idx < 3; idx++)
+        in[idx] = light->spDir[idx];
+    in[3] = 0.0;
+    mat4Transform(modelview, in, out);
+    for (idx = 0; idx < 3; idx++)
+        slot[4][idx] = out[idx];
+    slot[4][3] = cos(light->spAng * M_PI / 180.0);
+
+    slot[5][0] = light->spExp;
+    slot[5][1] = light->spAng;
+    slot[5][2] = 1.0f;
+    slot[5][3] = 0.0f;
+
+    memcpy(slot[6], light->atten, 3 * sizeof(GLfloat));
+    slot[6][3] = 0.0f;
+
+    RenderStats::frame.lightUploads++;
+    if (memcmp(lightBlock[2 + light->idx * 7], slot, sizeof(slot)) == 0) {
+        RenderStats::frame.stateCallsSkipped++;
+        return;
+    }
+
+    flush();
+    memcpy(lightBlock[2 + light->idx * 7], slot, sizeof(slot));
+    if (lightBlock[1][0] < light->idx + 1)
+        lightBlock[1][0] = light->idx + 1;
+    lightsDirty = true;
+}
+
+/**
+ * Sets the polygon mode. The core profile has a single mode for both faces, so the one of
+ * the front faces is used; the faces are split by it when they are gathered.
+ * @param   GLenum  face    The faces affected (GL_FRONT, GL_BACK or GL_FRONT_AND_BACK).
+ * @param   GLenum  mode    The mode (GL_POINT, GL_LINE or GL_FILL).
+ */
+void
+GL3Renderer::setPolygonMode(GLenum face, GLenum mode)
+{
+    if (face == GL_BACK)
+        return;
+
+    if (polyMode == mode) {
+        RenderStats::frame.stateCallsSkipped++;
+        return;
+    }
+
+    polyMode = mode;
+    RenderStats::frame.polygonModeChanges++;
+}
+
+/**
+ * Activates a material, copying its properties into the uniform buffer.
+ * @param   Material    * mat   The material to activate.
+ */
+void
+GL3Renderer::setMaterial(Material * mat)
+{
+    GLfloat block[5][4];
+    const GLfloat * prop;
+    unsigned idx;
+
+    memcpy(block, materialBlock, sizeof(block));
+    for (idx = 0; idx < 5; idx++) {
+        if ((prop = mat->getMatProperty(materialProps[idx])) != NULL)
+            memcpy(block[idx], prop, (idx == 4 ? 1 : 4) * sizeof(GLfloat));
+    }
+
+    RenderStats::frame.materialChanges++;
+    if (memcmp(block, materialBlock, sizeof(block)) == 0)
+        return;
+
+    flush();
+    memcpy(materialBlock, block, sizeof(block));
+    materialDirty = true;
+}
+
+/**
+ * Deactivates a material, as Material::deactivate() resetting the shininess and the
+ * emission.
+ * @param   Material    * mat   The material to deactivate.
+ */
+void
+GL3Renderer::unsetMaterial(Material * mat)
+{
+    if (memcmp(materialBlock[3], defaultMaterial[3], 2 * 4 * sizeof(GLfloat)) == 0)
+        return;
+
+    flush();
+    memcpy(materialBlock[3], defaultMaterial[3], 2 * 4 * sizeof(GLfloat));
+    materialDirty = true;
+}
+
+/**
+ * Multiplies a matrix into the modelview, saving the previous one.
+ * @param   GLfloat matrix[16]  The matrix, stored by columns.
+ */
+void
+GL3Renderer::pushMatrix(const GLfloat matrix[16])
+{
+    double model[16];
+
+    flush();
+
+    for (unsigned idx = 0; idx < 16; idx++)
+        model[idx] = matrix[idx];
+
+    stack.insert(stack.end(), modelview, modelview + 16);
+    mat4Multiply(modelview, model, modelview);
+    matricesDirty = true;
+}
+
+/**
+ * Restores the modelview saved by the last pushMatrix().
+ */
+void
+GL3Renderer::popMatrix()
+{
+    if (stack.size() < 16)
+        return;
+
+    flush();
+
+    std::copy(stack.end() - 16, stack.end(), modelview);
+    stack.resize(stack.size() - 16);
+    matricesDirty = true;
+}
+
+/**
+ * Starts a primitive.
+ * @param   GLenum  mode    The kind of primitive, as glBegin.
+ */
+void
+GL3Renderer::begin(GLenum mode)
+{
+    primMode = mode;
+    if (program != 0)
+        primFirst = vertexStream->getOffset() / sizeof(BufferVertex);
+}
+
+/**
+ * Adds a vertex to the current primitive.
+ * @param   GLdouble    x, y, z     The coordinates of the vertex.
+ * @param   GLdouble    s, t        The texture coordinates of the vertex.
+ */
+void
+GL3Renderer::vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s, GLdouble t)
+{
+    BufferVertex vert = { (GLfloat) x, (GLfloat) y, (GLfloat) z, (GLfloat) s, (GLfloat) t };
+    GLsizeiptr written;
+
+    if (program == 0)
+        return;
+
+    /* With the region full, the primitives written are drawn and the current one goes on
+     * at the start of the next region. */
+    if (vertexStream->getSpace() < (GLsizeiptr) sizeof(BufferVertex)) {
+        written = vertexStream->getOffset() - primFirst * sizeof(BufferVertex);
+
+        flush();
+        vertexStream->wrap(written);
+        primFirst = (vertexStream->getOffset() - written) / sizeof(BufferVertex);
+        if (vertexStream->getSpace() < (GLsizeiptr) sizeof(BufferVertex))
+            return;
+    }
+
+    memcpy(vertexStream->getPointer(), &vert, sizeof(vert));
+    vertexStream->commit(sizeof(vert));
+}
+
+/**
+ * Finishes the current primitive, splitting it into points, lines and triangles.
+ */
+void
+GL3Renderer::end()
+{
+    if (program == 0)
+        return;
+
+    GeometryBuffer::split(primMode, polyMode, NULL, primFirst,
+            vertexStream->getOffset() / sizeof(BufferVertex) - primFirst,
+            &points, &lines, &triangles);
+}
+
+/**
+ * Draws the geometry of a static figure from its buffer objects.
+ * @param   GeometryBuffer  * geometry  The geometry to draw.
+ */
+void
+GL3Renderer::drawStatic(GeometryBuffer * geometry)
+{
+    flush();
+    if (program == 0)
+        return;
+
+    applyState();
+    geometry->drawCore(polyMode);
+}
+
+/**
+ * Draws the instances of a geometry at once, with their matrices streamed into a buffer
+ * read once per instance.
+ * @param   GeometryBuffer  * geometry  The geometry to draw.
+ * @param   GLfloat     * matrices  The matrices of the instances, 16 floats by columns each.
+ * @param   unsigned    count       The number of instances.
+ */
+void
+GL3Renderer::drawInstanced(GeometryBuffer * geometry, const GLfloat * matrices,
+        unsigned count)
+{
+    unsigned col;
+
+    flush();
+    if (program == 0 || count == 0)
+        return;
+
+    applyState();
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, count * 16 * sizeof(GLfloat), matrices, GL_STREAM_DRAW);
+    for (col = 0; col < 4; col++) {
+        glEnableVertexAttribArray(ATTR_INSTANCE + col);
+        glVertexAttribPointer(ATTR_INSTANCE + col, 4, GL_FLOAT, GL_FALSE,
+                16 * sizeof(GLfloat), (void *) (col * 4 * sizeof(GLfloat)));
+        glVertexAttribDivisor(ATTR_INSTANCE + col, 1);
+    }
+
+    geometry->drawCore(polyMode, count);
+
+    for (col = 0; col < 4; col++) {
+        glVertexAttribDivisor(ATTR_INSTANCE + col, 0);
+        glDisableVertexAttribArray(ATTR_INSTANCE + col);
+    }
+}
+
+/**
+ * Reads the back buffer of the current context.
+ * @param   GLuint          width   The width of the frame.
+ * @param   GLuint          height  The height of the frame.
+ * @param   unsigned char   * pixels    The buffer of width * height * 4 bytes.
+ * @return  Whether the pixels could be read.
+ */
+bool
+GL3Renderer::readPixels(GLuint width, GLuint height, unsigned char * pixels)
+{
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    return glGetError() == GL_NO_ERROR;
+}
@@ -0,0 +1,202 @@
+/**
+ * Implementation of the renderer which only counts the work it receives.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "renderer.h"
+
+using namespace GEngine;
+
+/**
+ * Constructor of the null renderer, with all the counters to zero.
+ */
+NullRenderer::NullRenderer()
+{
+    total.reset();
+    frames = 0;
+    checksum = 0.0;
+}
+
+/**
+ * Starts a frame.
+ * @param   GLuint  position[2]     The position of the viewport, unused.
+ * @param   GLuint  screen[3]       The dimensions of the viewport, unused.
+ * @param   GLfloat bgcolor[3]      The background color, unused.
+ * @param   GLfloat fgcolor[3]      The foreground color, unused.
+ */
+void
+NullRenderer::beginFrame(const GLuint position[2], const GLuint screen[3],
+        const GLfloat bgcolor[3], const GLfloat fgcolor[3])
+{
+}
+
+/**
+ * Finishes a frame, counting it.
+ */
+void
+NullRenderer::endFrame()
+{
+    frames++;
+}
+
+/**
+ * Activates a camera, nothing to do.
+ * @param   Camera  * cam   The camera.
+ */
+void
+NullRenderer::activateCamera(Camera * cam)
+{
+}
+
+/**
+ * Deactivates a camera, nothing to do.
+ * @param   Camera  * cam   The camera.
+ */
+void
+NullRenderer::deactivateCamera(Camera * cam)
+{
+}
+
+/**
+ * Sets the ambient light, nothing to do.
+ * @param   GLfloat ambient[4]  The RGBA ambient light.
+ */
+void
+NullRenderer::setAmbient(const GLfloat ambient[4])
+{
+}
+
+/**
+ * Counts the upload of a light.
+ * @param   Light   * light     The light.
+ */
+void
+NullRenderer::setLight(Light * light)
+{
+    RenderStats::frame.lightUploads++;
+    total.lightUploads++;
+}
+
+/**
+ * Counts a change of the polygon mode.
+ * @param   GLenum  face    The faces affected.
+ * @param   GLenum  mode    The mode.
+ */
+void
+NullRenderer::setPolygonMode(GLenum face, GLenum mode)
+{
+    RenderStats::frame.polygonModeChanges++;
+    total.polygonModeChanges++;
+}
+
+/**
+ * Counts the activation of a material.
+ * @param   Material    * mat   The material.
+ */
+void
+NullRenderer::setMaterial(Material * mat)
+{
+    RenderStats::frame.materialChanges++;
+    total.materialChanges++;
+}
+
+/**
+ * Deactivates a material, nothing to do.
+ * @param   Material    * mat   The material.
+ */
+void
+NullRenderer::unsetMaterial(Material * mat)
+{
+}
+
+/**
+ * Multiplies a matrix into the modelview, ignored.
+ * @param   GLfloat matrix[16]  The matrix.
+ */
+void
+NullRenderer::pushMatrix(const GLfloat matrix[16])
+{
+}
+
+/**
+ * Restores the modelview, ignored.
+ */
+void
+NullRenderer::popMatrix()
+{
+}
+
+/**
+ * Starts a primitive, counting it.
+ * @param   GLenum  mode    The kind of primitive.
+ */
+void
+NullRenderer::begin(GLenum mode)
+{
+    total.drawCalls++;
+}
+
+/**
+ * Counts a vertex. Its coordinates are added to the checksum, so the work done to
+ * calculate them cannot be discarded.
+ * @param   GLdouble    x, y, z     The coordinates of the vertex.
+ * @param   GLdouble    s, t        The texture coordinates of the vertex.
+ */
+void
+NullRenderer::vertex(GLdouble x, GLdouble y, GLdouble z, GLdouble s, GLdouble t)
+{
+    total.vertices++;
+    checksum += x + y + z;
+}
+
+/**
+ * Finishes a primitive, nothing to do.
+ */
+void
+NullRenderer::end()
+{
+}
+
+/**
+ * There are no pixels to read.
+ * @return  Always false.
+ */
+bool
+NullRenderer::readPixels(GLuint width, GLuint height, unsigned char * pixels)
+{
+    return false;
+}
+
+/**
+ * Gets the counters of all the frames received.
+ * @return  The counters.
+ */
+const RenderStats&
+NullRenderer::getTotal() const
+{
+    return total;
+}
+
+/**
+ * Gets the number of frames received.
+ * @return  The number of frames.
+ */
+unsigned long long
+NullRenderer::getFrames() const
+{
+    return frames;
+}
+
+/**
+ * Gets the sum of all the coordinates received.
+ * @return  The checksum.
+ */
+double
+NullRenderer::getChecksum() const
+{
+    return checksum;
+}
@@ -0,0 +1,581 @@
+/**
+ * Implementation of the scene files.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "scenefile.h"
+#include "package.h"
+#include "profiler.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace GEngine;
+
+/* The size of the records of each section. */
+static const size_t recordSizes[SCENE_FILE_SECTIONS] = {
+    sizeof(SceneFileMaterial),
+    sizeof(SceneFileLight),
+    sizeof(SceneFileBatch),
+    sizeof(BufferVertex),
+    sizeof(GLuint),
+    sizeof(BufferDraw),
+    sizeof(unsigned long long)
+};
+
+/* The pages are read when the file is mapped, by the thread loading it, and not when the
+ * geometry is uploaded by the thread drawing it. */
+#ifdef MAP_POPULATE
+static const int mapFlags = MAP_PRIVATE | MAP_POPULATE;
+#else
+static const int mapFlags = MAP_PRIVATE;
+#endif
+
+/**
+ * Rounds an offset up to the boundary of the sections.
+ * @param   unsigned long long  offset  The offset.
+ * @return  The offset of the next section.
+ */
+static unsigned long long
+align(unsigned long long offset)
+{
+    return (offset + SCENE_FILE_ALIGN - 1) / SCENE_FILE_ALIGN * SCENE_FILE_ALIGN;
+}
+
+/**
+ * Constructor, without a file.
+ */
+SceneFile::SceneFile()
+{
+    data = NULL;
+    size = 0;
+}
+
+/**
+ * Destructor, unmapping the file.
+ */
+SceneFile::~SceneFile()
+{
+    close();
+}
+
+/**
+ * Gets the header of the file.
+ * @return  The header.
+ */
+const SceneFileHeader *
+SceneFile::header() const
+{
+    return (const SceneFileHeader *) data;
+}
+
+/**
+ * Gets the first record of a section.
+ * @param   unsigned    sect    The section, a SCENE_FILE_* value.
+ * @return  The records.
+ */
+const void *
+SceneFile::section(unsigned sect) const
+{
+    return data + header()->sections[sect].offset;
+}
+
+/**
+ * Writes a scene into a file. The whole file is built in memory and written at once; the
+ * materials are the ones of the batches and the horizon, each one written once.
+ * @param   char    * path  The path of the file.
+ * @param   Scene   * scene The scene.
+ * @return  Whether the file was written.
+ */
+bool
+SceneFile::write(const char * path, Scene * scene)
+{
+    std::map<Material *, GLint> known;
+    std::vector<Material *> mats;
+    std::vector<SceneFileBatch> batches;
+    std::vector<unsigned char> image;
+    SceneFileHeader head;
+    SceneFileSection * sect = head.sections;
+    unsigned long long offset;
+    FILE * file;
+    bool done;
+
+    PROFILE_SCOPE("SceneFile::write");
+
+    if (!scene->finalized)
+        scene->finalize();
+
+    auto material = [&](Material * mat) {
+        if (mat == NULL)
+            return -1;
+        if (known.find(mat) == known.end()) {
+            known[mat] = mats.size();
+            mats.push_back(mat);
+        }
+        return known[mat];
+    };
+
+    memset(&head, 0, sizeof(head));
+    head.magic = SCENE_FILE_MAGIC;
+    head.version = SCENE_FILE_VERSION;
+    head.limits[0] = scene->limits.xmin;
+    head.limits[1] = scene->limits.xmax;
+    head.limits[2] = scene->limits.ymin;
+    head.limits[3] = scene->limits.ymax;
+    head.limits[4] = scene->limits.zmin;
+    head.limits[5] = scene->limits.zmax;
+    memcpy(head.ambient, scene->ambient, sizeof(head.ambient));
+    head.horizon = scene->horizon == &Scene::black ? -1 : material(scene->horizon);
+
+    if (scene->camera != NULL) {
+        head.camera = 1;
+        head.eye[0] = scene->camera->position.x;
+        head.eye[1] = scene->camera->position.y;
+        head.eye[2] = scene->camera->position.z;
+        head.angles[0] = scene->camera->yaw;
+        head.angles[1] = scene->camera->pitch;
+        head.angles[2] = scene->camera->roll;
+    }
+
+    if (scene->pvs.isBaked()) {
+        scene->pvs.getDims(head.dims);
+        head.targets = scene->pvs.getTargets();
+    }
+
+    for (unsigned idx = 0; idx < scene->batches.size(); idx++) {
+        const StaticBatch * batch = scene->batches[idx];
+        SceneFileBatch rec;
+
+        rec.material = material(batch->material);
+        rec.state = batch->state;
+        rec.figures = batch->figures;
+        rec.firstVertex = sect[SCENE_FILE_VERTICES].count;
+        rec.vertexCount = batch->geometry.getVertexCount();
+        rec.firstIndex = sect[SCENE_FILE_INDICES].count;
+        rec.indexCount = batch->geometry.getIndexCount();
+        rec.firstDraw = sect[SCENE_FILE_DRAWS].count;
+        rec.drawCount = batch->geometry.getDrawCount();
+        memcpy(rec.bounds, batch->geometry.getBounds(), sizeof(rec.bounds));
+        batches.push_back(rec);
+
+        sect[SCENE_FILE_VERTICES].count += rec.vertexCount;
+        sect[SCENE_FILE_INDICES].count += rec.indexCount;
+        sect[SCENE_FILE_DRAWS].count += rec.drawCount;
+    }
+    sect[SCENE_FILE_MATERIALS].count = mats.size();
+    sect[SCENE_FILE_LIGHTS].count = scene->lights.size();
+    sect[SCENE_FILE_BATCHES].count = batches.size();
+    sect[SCENE_FILE_SETS].count = scene->pvs.getSets().size();
+
+    offset = sizeof(head);
+    for (unsigned idx = 0; idx < SCENE_FILE_SECTIONS; idx++) {
+        sect[idx].offset = align(offset);
+        offset = sect[idx].offset + sect[idx].count * recordSizes[idx];
+    }
+    head.size = offset;
+
+    image.assign(head.size, 0);
+    memcpy(image.data(), &head, sizeof(head));
+
+    for (unsigned idx = 0; idx < mats.size(); idx++) {
+        SceneFileMaterial * rec = (SceneFileMaterial *)
+            &image[sect[SCENE_FILE_MATERIALS].offset] + idx;
+
+        memcpy(rec->ambient, mats[idx]->getMatProperty(GL_AMBIENT), sizeof(rec->ambient));
+        memcpy(rec->diffuse, mats[idx]->getMatProperty(GL_DIFFUSE), sizeof(rec->diffuse));
+        memcpy(rec->specular, mats[idx]->getMatProperty(GL_SPECULAR),
+                sizeof(rec->specular));
+        memcpy(rec->emission, mats[idx]->getMatProperty(GL_EMISSION),
+                sizeof(rec->emission));
+        rec->shininess = mats[idx]->getMatProperty(GL_SHININESS)[0];
+    }
+
+    for (unsigned idx = 0; idx < scene->lights.size(); idx++) {
+        SceneFileLight * rec = (SceneFileLight *) &image[sect[SCENE_FILE_LIGHTS].offset] + idx;
+        const Light * light = scene->lights[idx];
+
+        memcpy(rec->ambient, light->intA, sizeof(rec->ambient));
+        memcpy(rec->diffuse, light->intD, sizeof(rec->diffuse));
+        memcpy(rec->specular, light->intSP, sizeof(rec->specular));
+        memcpy(rec->position, light->position, sizeof(rec->position));
+        memcpy(rec->spotDir, light->spDir, sizeof(rec->spotDir));
+        rec->spotExp = light->spExp;
+        rec->spotAngle = light->spAng;
+        memcpy(rec->atten, light->atten, sizeof(rec->atten));
+    }
+
+    memcpy(&image[sect[SCENE_FILE_BATCHES].offset], batches.data(),
+            batches.size() * sizeof(SceneFileBatch));
+
+    for (unsigned idx = 0; idx < batches.size(); idx++) {
+        const GeometryBuffer& geometry = scene->batches[idx]->geometry;
+
+        memcpy(&image[sect[SCENE_FILE_VERTICES].offset] +
+                batches[idx].firstVertex * sizeof(BufferVertex), geometry.getVertices(),
+                batches[idx].vertexCount * sizeof(BufferVertex));
+        memcpy(&image[sect[SCENE_FILE_INDICES].offset] +
+                batches[idx].firstIndex * sizeof(GLuint), geometry.getIndices(),
+                batches[idx].indexCount * sizeof(GLuint));
+        memcpy(&image[sect[SCENE_FILE_DRAWS].offset] +
+                batches[idx].firstDraw * sizeof(BufferDraw), geometry.getDraws(),
+                batches[idx].drawCount * sizeof(BufferDraw));
+    }
+
+    memcpy(&image[sect[SCENE_FILE_SETS].offset], scene->pvs.getSets().data(),
+            sect[SCENE_FILE_SETS].count * sizeof(unsigned long long));
+
+    if ((file = fopen(path, "wb")) == NULL)
+        return false;
+
+    done = fwrite(image.data(), image.size(), 1, file) == 1;
+
+    return fclose(file) == 0 && done;
+}
+
+/**
+ * Checks the mapping: the header, that every section and every range of the batches is
+ * inside the file, that the indices of every batch are among its vertices, and that the
+ * sets are the ones of the batches. The indices are the only part read whole: an index
+ * out of its batch would make the GPU read past the buffer of the vertices.
+ * @return  Whether the file can be used.
+ */
+bool
+SceneFile::check() const
+{
+    const SceneFileHeader * head = header();
+    const SceneFileSection * sect = head->sections;
+    const SceneFileBatch * batches;
+    const BufferDraw * draws;
+    const GLuint * indices;
+    unsigned long long words;
+
+    if (size < sizeof(SceneFileHeader) || head->magic != SCENE_FILE_MAGIC ||
+            head->version != SCENE_FILE_VERSION || head->size != size)
+        return false;
+
+    for (unsigned idx = 0; idx < SCENE_FILE_SECTIONS; idx++) {
+        if (sect[idx].offset % SCENE_FILE_ALIGN != 0 || sect[idx].offset > size ||
+                sect[idx].count > (size - sect[idx].offset) / recordSizes[idx])
+            return false;
+    }
+
+    if (head->horizon < -1 || head->horizon >= (GLint) sect[SCENE_FILE_MATERIALS].count)
+        return false;
+
+    batches = (const SceneFileBatch *) section(SCENE_FILE_BATCHES);
+    draws = (const BufferDraw *) section(SCENE_FILE_DRAWS);
+    indices = (const GLuint *) section(SCENE_FILE_INDICES);
+    for (unsigned idx = 0; idx < sect[SCENE_FILE_BATCHES].count; idx++) {
+        const SceneFileBatch& batch = batches[idx];
+
+        if (batch.material < -1 ||
+                batch.material >= (GLint) sect[SCENE_FILE_MATERIALS].count ||
+                (unsigned long long) batch.firstVertex + batch.vertexCount >
+                sect[SCENE_FILE_VERTICES].count ||
+                (unsigned long long) batch.firstIndex + batch.indexCount >
+                sect[SCENE_FILE_INDICES].count ||
+                (unsigned long long) batch.firstDraw + batch.drawCount >
+                sect[SCENE_FILE_DRAWS].count)
+            return false;
+
+        for (unsigned draw = batch.firstDraw; draw < batch.firstDraw + batch.drawCount;
+                draw++) {
+            if ((unsigned long long) draws[draw].first + draws[draw].count >
+                    batch.indexCount)
+                return false;
+        }
+
+        for (unsigned num = batch.firstIndex; num < batch.firstIndex + batch.indexCount;
+                num++) {
+            if (indices[num] >= batch.vertexCount)
+                return false;
+        }
+    }
+
+    if (head->targets == 0)
+        return sect[SCENE_FILE_SETS].count == 0;
+
+    words = (head->targets + 63) / 64;
+    return head->targets == SCENE_NEIGHBOURS + sect[SCENE_FILE_BATCHES].count &&
+        sect[SCENE_FILE_SETS].count ==
+        (unsigned long long) head->dims[0] * head->dims[1] * head->dims[2] * words;
+}
+
+/**
+ * Maps a scene file and creates its materials and its camera.
+ * @param   char    * path  The path of the file.
+ * @return  Whether the file was mapped, false if it is not a scene file of this version.
+ */
+bool
+SceneFile::open(const char * path)
+{
+    struct stat info;
+    void * map;
+    int fd;
+
+    PROFILE_SCOPE("SceneFile::open");
+
+    close();
+
+    if ((fd = ::open(path, O_RDONLY)) < 0)
+        return false;
+
+    if (fstat(fd, &info) < 0 || info.st_size < (off_t) sizeof(SceneFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    map = mmap(NULL, info.st_size, PROT_READ, mapFlags, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    data = (const unsigned char *) map;
+    size = info.st_size;
+    return prepare();
+}
+
+/**
+ * Reads a scene file kept in a package into anonymous memory, then uses it as if it were
+ * the mapping of the file.
+ * @param   Package     * package   The package.
+ * @param   unsigned    entry       The entry of the file.
+ * @return  Whether the entry was read and is a scene file of this version.
+ */
+bool
+SceneFile::open(const Package * package, unsigned entry)
+{
+    const PackageEntry& desc = package->getEntry(entry);
+    void * map;
+
+    PROFILE_SCOPE("SceneFile::open");
+
+    close();
+
+    if (desc.type != PACKAGE_SCENE || desc.size < sizeof(SceneFileHeader))
+        return false;
+
+    map = mmap(NULL, desc.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return false;
+
+    data = (const unsigned char *) map;
+    size = desc.size;
+    if (!package->read(entry, map)) {
+        close();
+        return false;
+    }
+    return prepare();
+}
+
+/**
+ * Checks the image of the file, then creates its materials and its camera.
+ * @return  Whether it is a scene file of this version; if not, it is closed.
+ */
+bool
+SceneFile::prepare()
+{
+    const SceneFileHeader * head;
+    const SceneFileMaterial * mats;
+
+    if (!check()) {
+        close();
+        return false;
+    }
+
+    head = header();
+    mats = (const SceneFileMaterial *) section(SCENE_FILE_MATERIALS);
+    for (unsigned idx = 0; idx < head->sections[SCENE_FILE_MATERIALS].count; idx++) {
+        Material * mat = new Material();
+
+        mat->setMatProperty(GL_AMBIENT, (GLfloat *) mats[idx].ambient);
+        mat->setMatProperty(GL_DIFFUSE, (GLfloat *) mats[idx].diffuse);
+        mat->setMatProperty(GL_SPECULAR, (GLfloat *) mats[idx].specular);
+        mat->setMatProperty(GL_EMISSION, (GLfloat *) mats[idx].emission);
+        mat->setMatProperty(GL_SHININESS, (GLfloat *) &mats[idx].shininess);
+        materials.push_back(mat);
+    }
+
+    camera = StaticCamera(Geometry::Point(head->eye[0], head->eye[1], head->eye[2]),
+            head->angles[0], head->angles[1], head->angles[2]);
+
+    return true;
+}
+
+/**
+ * Unmaps the file and frees its materials.
+ */
+void
+SceneFile::close()
+{
+    for (unsigned idx = 0; idx < materials.size(); idx++)
+        delete materials[idx];
+    materials.clear();
+
+    if (data != NULL)
+        munmap((void *) data, size);
+    data = NULL;
+    size = 0;
+}
+
+/**
+ * Creates the scene of the file. Its batches use the geometry of the mapping and the
+ * materials of the file, so the file must be kept open while the scene exists.
+ * @return  The scene, or NULL if no file is open.
+ */
+Scene *
+SceneFile::createScene()
+{
+    const SceneFileHeader * head = header();
+    const SceneFileLight * lights;
+    const SceneFileBatch * recs;
+    const BufferVertex * vertices;
+    const GLuint * indices;
+    const BufferDraw * draws;
+    long long limits[6];
+    std::vector<GLfloat> boxes;
+    Scene * scene;
+
+    PROFILE_SCOPE("SceneFile::createScene");
+
+    if (data == NULL)
+        return NULL;
+
+    std::copy(head->limits, head->limits + 6, limits);
+    scene = new Scene(limits);
+    memcpy(scene->ambient, head->ambient, sizeof(head->ambient));
+    if (head->horizon >= 0)
+        scene->setHorizon(materials[head->horizon]);
+    if (head->camera)
+        scene->addCamera(&camera);
+
+    lights = (const SceneFileLight *) section(SCENE_FILE_LIGHTS);
+    for (unsigned idx = 0; idx < head->sections[SCENE_FILE_LIGHTS].count; idx++) {
+        Light light;
+
+        memcpy(light.intA, lights[idx].ambient, sizeof(light.intA));
+        memcpy(light.intD, lights[idx].diffuse, sizeof(light.intD));
+        memcpy(light.intSP, lights[idx].specular, sizeof(light.intSP));
+        memcpy(light.position, lights[idx].position, sizeof(light.position));
+        memcpy(light.spDir, lights[idx].spotDir, sizeof(light.spDir));
+        light.spExp = lights[idx].spotExp;
+        light.spAng = lights[idx].spotAngle;
+        memcpy(light.atten, lights[idx].atten, sizeof(light.atten));
+        scene->addLight(light);
+    }
+
+    recs = (const SceneFileBatch *) section(SCENE_FILE_BATCHES);
+    vertices = (const BufferVertex *) section(SCENE_FILE_VERTICES);
+    indices = (const GLuint *) section(SCENE_FILE_INDICES);
+    draws = (const BufferDraw *) section(SCENE_FILE_DRAWS);
+    for (unsigned idx = 0; idx < head->sections[SCENE_FILE_BATCHES].count; idx++) {
+        StaticBatch * batch = new StaticBatch();
+
+        batch->geometry.map(vertices + recs[idx].firstVertex, recs[idx].vertexCount,
+                indices + recs[idx].firstIndex, recs[idx].indexCount,
+                draws + recs[idx].firstDraw, recs[idx].drawCount, recs[idx].bounds);
+        batch->material = recs[idx].material >= 0 ? materials[recs[idx].material] : NULL;
+        batch->state = recs[idx].state;
+        batch->figures = recs[idx].figures;
+        batch->dirty = false;
+        scene->batches.push_back(batch);
+        scene->batched += batch->figures;
+        boxes.insert(boxes.end(), recs[idx].bounds, recs[idx].bounds + 6);
+    }
+    scene->batchTree.build(boxes.data(), scene->batches.size());
+    scene->finalized = true;
+
+    if (head->targets > 0)
+        scene->pvs.setSets(head->dims, head->targets,
+                (const unsigned long long *) section(SCENE_FILE_SETS));
+
+    return scene;
+}
+
+/**
+ * Constructor of the loader.
+ * @param   char    * pattern   The pattern of the paths of the files, taking the x, y
+ *                              and z of the scenes as long long numbers.
+ * @param   Package * package   The package whose entries are named by the pattern, NULL
+ *                              to map the files from the disk.
+ */
+SceneFileLoader::SceneFileLoader(const char * pattern, const Package * package)
+{
+    this->pattern = pattern;
+    this->package = package;
+}
+
+/**
+ * Destructor of the loader, freeing the scenes which were not released.
+ */
+SceneFileLoader::~SceneFileLoader()
+{
+    std::map<Scene *, SceneFile *>::iterator it;
+
+    for (it = files.begin(); it != files.end(); it++) {
+        delete it->first;
+        delete it->second;
+    }
+}
+
+/**
+ * Maps the file of a scene, or reads its entry of the package, and creates the scene
+ * from it.
+ * @param   long long   x, y, z     The coordinates of the scene in its map.
+ * @return  The scene, or NULL if it has no file.
+ */
+Scene *
+SceneFileLoader::load(long long x, long long y, long long z)
+{
+    char path[SCENE_FILE_PATH];
+    SceneFile * file = new SceneFile();
+    Scene * scene;
+    int entry;
+    bool opened;
+
+    snprintf(path, sizeof(path), pattern.c_str(), x, y, z);
+    if (package == NULL)
+        opened = file->open(path);
+    else
+        opened = (entry = package->find(path)) >= 0 && file->open(package, entry);
+
+    if (!opened) {
+        delete file;
+        return NULL;
+    }
+
+    scene = file->createScene();
+    lock.lock();
+    files[scene] = file;
+    lock.unlock();
+
+    return scene;
+}
+
+/**
+ * Frees a scene, then unmaps its file.
+ * @param   Scene   * scene     The scene.
+ */
+void
+SceneFileLoader::release(Scene * scene)
+{
+    std::map<Scene *, SceneFile *>::iterator it;
+    SceneFile * file = NULL;
+
+    lock.lock();
+    if ((it = files.find(scene)) != files.end()) {
+        file = it->second;
+        files.erase(it);
+    }
+    lock.unlock();
+
+    delete scene;
+    delete file;
+}
@@ -0,0 +1,49 @@
+/**
+ * Implementation of the render statistics.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "stats.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace GEngine;
+
+RenderStats RenderStats::frame = RenderStats();
+
+/**
+ * Sets all the counters to zero.
+ */
+void
+RenderStats::reset()
+{
+    memset(this, 0, sizeof(RenderStats));
+}
+
+/**
+ * Writes the counters into a buffer as text, one counter per line.
+ * @param   char    * buffer    The buffer where the text is written.
+ * @param   size_t  size        The size of the buffer.
+ * @return  The number of characters written, as snprintf.
+ */
+int
+RenderStats::format(char * buffer, size_t size) const
+{
+    return snprintf(buffer, size,
+            "Draw calls: %lu\n"
+            "Vertices: %lu\n"
+            "Materials: %lu\n"
+            "Polygon modes: %lu\n"
+            "Lights: %lu\n"
+            "Figures: %lu drawn, %lu culled, %lu occluded\n"
+            "Instances: %lu\n"
+            "Redundant GL calls: %lu\n"
+            "Stream waits: %lu\n",
+            drawCalls, vertices, materialChanges, polygonModeChanges,
+            lightUploads, figuresDrawn, figuresCulled, figuresOccluded, instances, stateCallsSkipped,
+            streamWaits);
+}
@@ -0,0 +1,212 @@
+/**
+ * Implementation of the stream buffers.
+ *
+ * @author  Roberto Fernandez Cueto
+ * @date    18.10.2026
+ *
+ * $Id$
+ */
+
+#include "stream.h"
+#include "glstate.h"
+#include "stats.h"
+#include <string.h>
+
+using namespace GEngine;
+
+/* The flags of the storage and of its mapping: written and read by the CPU, drawn while it
+ * is mapped and without explicit flushes. */
+#define STREAM_FLAGS    (GL_MAP_WRITE_BIT | GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | \
+        GL_MAP_COHERENT_BIT)
+
+/* The nanoseconds waited for a fence before checking it again. */
+#define STREAM_TIMEOUT  1000000000
+
+/**
+ * Creates the buffer object. It must be called with the context current, after
+ * GLState::init(). The buffer is left unbound.
+ * @param   GLenum      target  The target the buffer is bound to.
+ * @param   GLsizeiptr  size    The size of each region, in bytes.
+ */
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr size)
+{
+    this->target = target;
+    this->size = size;
+    persistent = GLState::hasPersistentMapping();
+    data = NULL;
+    region = 0;
+    used = uploaded = 0;
+    for (unsigned idx = 0; idx < STREAM_REGIONS; idx++)
+        fences[idx] = 0;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+
+    if (persistent) {
+        glBufferStorage(target, size * STREAM_REGIONS, NULL, STREAM_FLAGS);
+        data = (unsigned char *) glMapBufferRange(target, 0, size * STREAM_REGIONS,
+                STREAM_FLAGS);
+        if (data == NULL) {
+            /* The storage is immutable, so the buffer is created again. */
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(target, buffer);
+            persistent = false;
+        }
+    }
+
+    if (!persistent) {
+        glBufferData(target, size, NULL, GL_STREAM_DRAW);
+        copy.resize(size);
+        data = copy.data();
+    }
+
+    glBindBuffer(target, 0);
+}
+
+/**
+ * Destructor, freeing the buffer and the fences.
+ */
+StreamBuffer::~StreamBuffer()
+{
+    for (unsigned idx = 0; idx < STREAM_REGIONS; idx++) {
+        if (fences[idx] != 0)
+            glDeleteSync(fences[idx]);
+    }
+
+    if (persistent) {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        glBindBuffer(target, 0);
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+/**
+ * Fences the draws of the region being written and goes to the next one, waiting until
+ * the GPU has finished drawing it. Without the mapping, the buffer is orphaned instead:
+ * the driver keeps the old storage until it is drawn and gives a new one.
+ */
+void
+StreamBuffer::next()
+{
+    GLenum status;
+
+    used = uploaded = 0;
+
+    if (!persistent) {
+        glBindBuffer(target, buffer);
+        glBufferData(target, size, NULL, GL_STREAM_DRAW);
+        return;
+    }
+
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % STREAM_REGIONS;
+    if (fences[region] == 0)
+        return;
+
+    status = glClientWaitSync(fences[region], 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        RenderStats::frame.streamWaits++;
+        do {
+            status = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT,
+                    STREAM_TIMEOUT);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+
+    glDeleteSync(fences[region]);
+    fences[region] = 0;
+}
+
+/**
+ * Gets the bytes which can still be written in the region.
+ * @return  The free bytes.
+ */
+GLsizeiptr
+StreamBuffer::getSpace() const
+{
+    return size - used;
+}
+
+/**
+ * Gets where the next bytes have to be written.
+ * @return  The pointer, valid for getSpace() bytes.
+ */
+void *
+StreamBuffer::getPointer() const
+{
+    return data + (persistent ? region * size : 0) + used;
+}
+
+/**
+ * Gets the offset in the buffer of the next bytes, to draw them once they are written.
+ * @return  The offset in bytes.
+ */
+GLintptr
+StreamBuffer::getOffset() const
+{
+    return (persistent ? region * size : 0) + used;
+}
+
+/**
+ * Marks bytes as written after getPointer().
+ * @param   GLsizeiptr  bytes   The bytes written, at most getSpace().
+ */
+void
+StreamBuffer::commit(GLsizeiptr bytes)
+{
+    used += bytes;
+}
+
+/**
+ * Binds the buffer to its target. Without the mapping, the bytes written since the last
+ * call are uploaded.
+ */
+void
+StreamBuffer::bind()
+{
+    glBindBuffer(target, buffer);
+
+    if (!persistent && uploaded < used) {
+        glBufferSubData(target, uploaded, used - uploaded, data + uploaded);
+        uploaded = used;
+    }
+}
+
+/**
+ * Moves to the next region when the current one is full. The last bytes written, the
+ * part of a primitive not finished yet, are copied to the start of the new region.
+ * @param   GLsizeiptr  keep    The bytes to carry, at the end of the written ones.
+ */
+void
+StreamBuffer::wrap(GLsizeiptr keep)
+{
+    unsigned char * last = (unsigned char *) getPointer() - keep;
+
+    next();
+
+    memmove(getPointer(), last, keep);
+    used = keep;
+}
+
+/**
+ * Ends the frame: the region is fenced after the draws of the frame, so the next frame
+ * is written while the GPU draws this one.
+ */
+void
+StreamBuffer::endFrame()
+{
+    if (used > 0)
+        next();
+}
+
+/**
+ * Returns whether the buffer is mapped persistently, with the vertices written straight
+ * into it.
+ * @return  Whether it is mapped.
+ */
+bool
+StreamBuffer::isPersistent() const
+{
+    return persistent;
+}
@@ -7,7 +7,15 @@
 
 #include <GL/gl.h>
 #include "world.h"
+#include "profiler.h"
+#include "stats.h"
+#include "jobs.h"
+#include "glstate.h"
 #include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <tuple>
 #ifdef DEBUG
 #include <stdio.h>
 #endif
@@ -17,6 +25,94 @@ using namespace GEngine::Geometry;
 
 
 Material Scene::black = Material();
+
+/* The polygon modes of the figures, in the order they are sorted. */
+enum {
+    STATE_FILL,     /* Figures with a material. */
+    STATE_SOLID,    /* Solid figures without material: lines in front, points behind. */
+    STATE_WIRE      /* Wired figures. */
+};
+
+/* The step to the scene on each side of a scene, along x, y and z. */
+static const int sideSteps[GES_DOWN + 1][3] = {
+    {0, 0, -1},     /* GES_NORTH */
+    {0, 0, 1},      /* GES_SOUTH */
+    {1, 0, 0},      /* GES_EAST */
+    {-1, 0, 0},     /* GES_WEST */
+    {0, 0, 0},      /* GES_CENTER */
+    {0, 1, 0},      /* GES_UP */
+    {0, -1, 0}      /* GES_DOWN */
+};
+
+/**
+ * Gets the polygon mode used by a figure.
+ * @param   Figure  * fig   The figure.
+ * @return  The STATE_* value of the figure.
+ */
+static unsigned
+polygonState(Figure * fig)
+{
+    if (fig->getMaterial() != NULL)
+        return STATE_FILL;
+
+    return fig->isSolid() ? STATE_SOLID : STATE_WIRE;
+}
+
+/**
+ * Gets the polygon mode used by an instance.
+ * @param   Instance    * inst  The instance.
+ * @return  The STATE_* value of the instance.
+ */
+static unsigned
+polygonState(Instance * inst)
+{
+    if (inst->getMaterial() != NULL)
+        return STATE_FILL;
+
+    return inst->getMesh()->isSolid() ? STATE_SOLID : STATE_WIRE;
+}
+
+/**
+ * Returns whether a static figure hides the figures behind it: its faces must be filled
+ * with an opaque material.
+ * @param   StaticFigure    * fig   The figure.
+ * @return  Whether it hides them.
+ */
+static bool
+isOccluding(StaticFigure * fig)
+{
+    return polygonState(fig) == STATE_FILL &&
+        fig->getMaterial()->getMatProperty(GL_DIFFUSE)[3] >= 1.0;
+}
+
+/**
+ * Gets the target of the sets of a neighbour scene.
+ * @param   int     dx, dy, dz  The position of the neighbour, -1, 0 or 1 along each axis.
+ * @return  The index of the target.
+ */
+static unsigned
+neighbourTarget(int dx, int dy, int dz)
+{
+    unsigned idx = (dz + 1) * 9 + (dy + 1) * 3 + (dx + 1);
+
+    /* The scene itself is not a target. */
+    return idx < 13 ? idx : idx - 1;
+}
+
+/**
+ * The order of the instances, which puts together the ones drawn at once.
+ * @param   Instance    * a, * b    The instances to compare.
+ * @return  Whether a goes before b.
+ */
+static bool
+instanceLess(const Instance * a, const Instance * b)
+{
+    if (a->getMesh() != b->getMesh())
+        return a->getMesh() < b->getMesh();
+
+    return a->getMaterial() < b->getMaterial();
+}
+
 /**
  * Constructors of the scene.
  */
@@ -32,19 +128,47 @@ Scene::Scene(long long xmin, long long xmax, long long ymin, long long ymax,
 
     horizon = &black;
     camera = NULL;
+    finalized = false;
+    batched = 0;
+    setLimits();
 }
 
 Scene::Scene(long long lim[6])
 {
     limits.xmin = lim[0];
-    limits.xmax = lim[0];
-    limits.ymin = lim[0];
-    limits.ymax = lim[0];
-    limits.zmin = lim[0];
-    limits.zmax = lim[0];
+    limits.xmax = lim[1];
+    limits.ymin = lim[2];
+    limits.ymax = lim[3];
+    limits.zmin = lim[4];
+    limits.zmax = lim[5];
 
     horizon = &black;
     camera = NULL;
+    finalized = false;
+    batched = 0;
+    setLimits();
+}
+
+/**
+ * Splits the limits of the scene into the cells of the grid of the dynamic figures and
+ * the ones of the potentially visible sets.
+ */
+void
+Scene::setLimits()
+{
+    GLfloat box[6] = {(GLfloat) limits.xmin, (GLfloat) limits.ymin, (GLfloat) limits.zmin,
+        (GLfloat) limits.xmax, (GLfloat) limits.ymax, (GLfloat) limits.zmax};
+
+    dynGrid.setLimits(box, SCENE_GRID_CELL);
+    pvs.setCells(box, SCENE_PVS_CELL);
+}
+
+/**
+ * Destructor of the scene.
+ */
+Scene::~Scene()
+{
+    clearBatches();
 }
 
 /**
@@ -55,6 +179,27 @@ void
 Scene::addDynFigure(Figure * fig)
 {
     DynFigures.push_back(fig);
+    gridAdd(--DynFigures.end());
+}
+
+/**
+ * Puts a dynamic figure of DynFigures into the grid, taking the handle the grid gives,
+ * which can be one of a figure which left the scene.
+ * @param   FigureList::iterator    link    The place of the figure in DynFigures.
+ */
+void
+Scene::gridAdd(FigureList::iterator link)
+{
+    /* Until the figure is bounded, it is found everywhere. */
+    unsigned item = dynGrid.insert((*link)->getBounds());
+
+    if (item == gridFigures.size()) {
+        gridFigures.push_back(*link);
+        gridLinks.push_back(link);
+    } else {
+        gridFigures[item] = *link;
+        gridLinks[item] = link;
+    }
 }
 
 /**
@@ -64,7 +209,420 @@ Scene::addDynFigure(Figure * fig)
 void
 Scene::addStaFigure(StaticFigure * fig)
 {
+    /* The geometry is built now, so it is ready for the first frame. */
+    fig->getGeometry();
     StaFigures.push_back(fig);
+
+    /* Until the scene is finalized again, the static figures are drawn one by one. */
+    clearBatches();
+}
+
+/**
+ * Adds a static figure as an occluder. Only the faces of the occluders filled with an
+ * opaque material hide the figures behind them.
+ * @param   StaticFigure    * fig   The occluder.
+ */
+void
+Scene::addOccluder(StaticFigure * fig)
+{
+    occluders.push_back(fig);
+}
+
+/**
+ * Adds an instance to the scene.
+ * @param   Instance    * inst  The instance.
+ */
+void
+Scene::addInstance(Instance * inst)
+{
+    instances.push_back(inst);
+}
+
+/**
+ * Splits the instances into the groups drawn at once, the ones with the same mesh and
+ * material. The instances are kept sorted, and sorted again only when their materials
+ * changed or new ones were added.
+ */
+void
+Scene::groupInstances()
+{
+    unsigned idx;
+
+    if (!std::is_sorted(instances.begin(), instances.end(), instanceLess))
+        std::stable_sort(instances.begin(), instances.end(), instanceLess);
+
+    instanceGroups.clear();
+    for (idx = 0; idx < instances.size(); idx++)
+        if (idx == 0 || instanceLess(instances[idx - 1], instances[idx]))
+            instanceGroups.push_back(idx);
+    instanceGroups.push_back(instances.size());
+}
+
+/**
+ * Removes the batches of static figures.
+ */
+void
+Scene::clearBatches()
+{
+    StaticBatchList::iterator batch;
+
+    for (batch = batches.begin(); batch != batches.end(); batch++) {
+        for (unsigned idx = 0; idx < (*batch)->members.size(); idx++)
+            (*batch)->members[idx]->setBatch(NULL);
+        delete *batch;
+    }
+    batches.clear();
+    batchTree.clear();
+    figureTree.clear();
+    figureIndex.clear();
+    pvs.clear();
+    finalized = false;
+    batched = 0;
+}
+
+/**
+ * Joins the static figures into batches, drawn with a single call each one. The figures
+ * are already in the coordinates of the scene, so they are grouped by the cell of
+ * SCENE_BATCH_CELL units containing their center, their material, their polygon mode and
+ * their primitive. Each batch is bounded by its cell, so it can still be culled. The
+ * figures keep their batch, which is joined again when one of them is edited.
+ */
+void
+Scene::finalize()
+{
+    std::map<std::tuple<long, long, long, Material *, unsigned, GLenum>, StaticBatch *> cells;
+    std::map<std::tuple<long, long, long, Material *, unsigned, GLenum>, StaticBatch *>::iterator
+        cell;
+    StaticFigureList::iterator fig;
+    GeometryBuffer * geometry;
+    const GLfloat * box;
+    long center[3];
+    StaticBatch * batch;
+
+    PROFILE_SCOPE("Scene::finalize");
+
+    clearBatches();
+
+    for (fig = StaFigures.begin(); fig != StaFigures.end(); fig++) {
+        geometry = (*fig)->getGeometry();
+        box = geometry->getBounds();
+
+        for (unsigned axis = 0; axis < 3; axis++)
+            center[axis] = (long) floor((box[axis] + box[axis + 3]) / 2 / SCENE_BATCH_CELL);
+
+        auto key = std::make_tuple(center[0], center[1], center[2], (*fig)->getMaterial(),
+                polygonState(*fig), (*fig)->getMode());
+
+        if ((cell = cells.find(key)) == cells.end()) {
+            batch = new StaticBatch();
+            batch->material = (*fig)->getMaterial();
+            batch->state = polygonState(*fig);
+            batch->figures = 0;
+            batch->dirty = false;
+            batches.push_back(batch);
+            cell = cells.insert(std::make_pair(key, batch)).first;
+        }
+
+        cell->second->geometry.append(*geometry);
+        cell->second->members.push_back(*fig);
+        cell->second->figures++;
+        (*fig)->setBatch(cell->second);
+        batched++;
+
+        figureIndex.push_back(*fig);
+    }
+    buildTrees();
+
+    finalized = true;
+}
+
+/**
+ * Builds the trees of the boxes of the batches, finding the ones seen, and of the boxes
+ * of the static figures, answering the queries.
+ */
+void
+Scene::buildTrees()
+{
+    std::vector<GLfloat> boxes;
+    const GLfloat * box;
+
+    for (unsigned idx = 0; idx < figureIndex.size(); idx++) {
+        box = figureIndex[idx]->getGeometry()->getBounds();
+        boxes.insert(boxes.end(), box, box + 6);
+    }
+    figureTree.build(boxes.data(), figureIndex.size());
+
+    boxes.clear();
+    for (unsigned idx = 0; idx < batches.size(); idx++) {
+        box = batches[idx]->geometry.getBounds();
+        boxes.insert(boxes.end(), box, box + 6);
+    }
+    batchTree.build(boxes.data(), batches.size());
+}
+
+/**
+ * Joins again the batches with figures edited since they were joined, and builds the
+ * trees again with the new boxes. The figures stay in their batches, and the sets baked
+ * are kept, even if the figures moved away from where they were baked.
+ */
+void
+Scene::rejoinBatches()
+{
+    bool rejoined = false;
+
+    for (unsigned idx = 0; idx < batches.size(); idx++) {
+        StaticBatch * batch = batches[idx];
+
+        if (!batch->dirty)
+            continue;
+
+        batch->geometry.clear();
+        for (unsigned fig = 0; fig < batch->members.size(); fig++)
+            batch->geometry.append(*batch->members[fig]->getGeometry());
+        batch->dirty = false;
+        rejoined = true;
+    }
+
+    if (rejoined)
+        buildTrees();
+}
+
+/**
+ * Bakes the potentially visible sets. The faces of the occluders stop the rays cast from
+ * each cell to the sides of the scene shared with each neighbour, sampled four times
+ * along each axis they span, and to some vertices of each batch.
+ */
+void
+Scene::bakePVS()
+{
+    GLfloat lim[6] = {(GLfloat) limits.xmin, (GLfloat) limits.ymin, (GLfloat) limits.zmin,
+        (GLfloat) limits.xmax, (GLfloat) limits.ymax, (GLfloat) limits.zmax};
+    std::vector<GLfloat> triangles, points;
+    std::vector<unsigned> firsts;
+    BufferIndexList faces;
+    int offset[3];
+
+    PROFILE_SCOPE("Scene::bakePVS");
+
+    if (!finalized)
+        finalize();
+
+    for (unsigned idx = 0; idx < occluders.size(); idx++) {
+        GeometryBuffer * geometry = occluders[idx]->getGeometry();
+        const BufferVertex * vertices = geometry->getVertices();
+
+        if (!isOccluding(occluders[idx]))
+            continue;
+
+        faces.clear();
+        geometry->getFaces(&faces);
+        for (unsigned vert = 0; vert < faces.size(); vert++) {
+            triangles.push_back(vertices[faces[vert]].x);
+            triangles.push_back(vertices[faces[vert]].y);
+            triangles.push_back(vertices[faces[vert]].z);
+        }
+    }
+
+    /* The neighbours, in the order of neighbourTarget(). */
+    for (offset[2] = -1; offset[2] <= 1; offset[2]++) {
+        for (offset[1] = -1; offset[1] <= 1; offset[1]++) {
+            for (offset[0] = -1; offset[0] <= 1; offset[0]++) {
+                unsigned steps[3];
+
+                if (offset[0] == 0 && offset[1] == 0 && offset[2] == 0)
+                    continue;
+
+                firsts.push_back(points.size() / 3);
+                for (unsigned axis = 0; axis < 3; axis++)
+                    steps[axis] = offset[axis] == 0 ? 4 : 1;
+
+                for (unsigned step = 0; step < steps[0] * steps[1] * steps[2]; step++) {
+                    unsigned pos[3] = {step % steps[0], step / steps[0] % steps[1],
+                        step / steps[0] / steps[1]};
+
+                    for (unsigned axis = 0; axis < 3; axis++) {
+                        if (offset[axis] != 0)
+                            points.push_back(lim[offset[axis] < 0 ? axis : axis + 3]);
+                        else
+                            points.push_back(lim[axis] + (lim[axis + 3] - lim[axis]) *
+                                    (pos[axis] * 2 + 1) / 8);
+                    }
+                }
+            }
+        }
+    }
+
+    for (unsigned idx = 0; idx < batches.size(); idx++) {
+        const BufferVertex * vertices = batches[idx]->geometry.getVertices();
+        unsigned count = batches[idx]->geometry.getVertexCount();
+        unsigned stride = std::max(1u, count / SCENE_PVS_POINTS);
+
+        firsts.push_back(points.size() / 3);
+        for (unsigned vert = 0; vert < count; vert += stride) {
+            points.push_back(vertices[vert].x);
+            points.push_back(vertices[vert].y);
+            points.push_back(vertices[vert].z);
+        }
+    }
+    firsts.push_back(points.size() / 3);
+
+    pvs.bake(triangles, points, firsts);
+}
+
+/**
+ * Writes the potentially visible sets into a file.
+ * @param   char    * path  The path of the file.
+ * @return  Whether they were written.
+ */
+bool
+Scene::savePVS(const char * path) const
+{
+    return pvs.isBaked() && pvs.save(path);
+}
+
+/**
+ * Reads the potentially visible sets from a file, which must have been baked for the
+ * same limits and batches.
+ * @param   char    * path  The path of the file.
+ * @return  Whether they were read.
+ */
+bool
+Scene::loadPVS(const char * path)
+{
+    if (!finalized || !pvs.load(path))
+        return false;
+
+    if (pvs.getTargets() != SCENE_NEIGHBOURS + batches.size()) {
+        pvs.clear();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Gets the cell of the potentially visible sets where the camera is.
+ * @return  The cell, or -1 without sets, camera, or out of the limits of the scene.
+ */
+int
+Scene::cameraCell() const
+{
+    double eye[3];
+    GLfloat pos[3];
+
+    if (camera == NULL || !pvs.isBaked())
+        return -1;
+
+    camera->getEye(eye);
+    for (unsigned axis = 0; axis < 3; axis++)
+        pos[axis] = eye[axis];
+
+    return pvs.getCell(pos);
+}
+
+/**
+ * Returns whether a neighbour scene can be seen from the camera. Without the sets, or
+ * with the camera out of the scene, all of them can.
+ * @param   int     dx, dy, dz  The position of the neighbour, -1, 0 or 1 along each axis.
+ * @return  Whether it can be seen.
+ */
+bool
+Scene::isNeighbourVisible(int dx, int dy, int dz) const
+{
+    int cell = cameraCell();
+
+    if (cell < 0 || (dx == 0 && dy == 0 && dz == 0))
+        return true;
+
+    return pvs.isVisible(cell, neighbourTarget(dx, dy, dz));
+}
+
+/**
+ * Gets the static figures whose box is crossed by a segment.
+ * @param   GLfloat origin[3]   The start of the segment.
+ * @param   GLfloat dir[3]      The direction of the segment.
+ * @param   GLfloat length      The length of the segment, in units of dir.
+ * @param   StaticFigureVector  * found     The list receiving the figures.
+ */
+void
+Scene::castRay(const GLfloat origin[3], const GLfloat dir[3], GLfloat length,
+        StaticFigureVector * found) const
+{
+    std::vector<unsigned> items;
+
+    figureTree.intersect(origin, dir, length, &items);
+    for (unsigned idx = 0; idx < items.size(); idx++)
+        found->push_back(figureIndex[items[idx]]);
+}
+
+/**
+ * Gets the static figures whose box overlaps a region.
+ * @param   GLfloat region[6]   The minimum and maximum x, y and z of the region.
+ * @param   StaticFigureVector  * found     The list receiving the figures.
+ */
+void
+Scene::findFigures(const GLfloat region[6], StaticFigureVector * found) const
+{
+    std::vector<unsigned> items;
+
+    figureTree.query(region, &items);
+    for (unsigned idx = 0; idx < items.size(); idx++)
+        found->push_back(figureIndex[items[idx]]);
+}
+
+/**
+ * Puts the figures of some handles of the grid into a list, in the order of the handles.
+ * @param   unsigned    items       The handles, sorted.
+ * @param   FigureVector    * found The list receiving the figures.
+ */
+void
+Scene::gridFound(std::vector<unsigned>& items, FigureVector * found) const
+{
+    std::sort(items.begin(), items.end());
+    for (unsigned idx = 0; idx < items.size(); idx++)
+        found->push_back(gridFigures[items[idx]]);
+}
+
+/**
+ * Gets the dynamic figures which can be seen through a frustum.
+ * @param   Frustum     frustum     The frustum.
+ * @param   FigureVector    * found The list receiving the figures.
+ */
+void
+Scene::findDynFigures(const Frustum& frustum, FigureVector * found) const
+{
+    std::vector<unsigned> items;
+
+    dynGrid.cull(frustum, &items);
+    gridFound(items, found);
+}
+
+/**
+ * Gets the dynamic figures whose box overlaps a region.
+ * @param   GLfloat region[6]   The minimum and maximum x, y and z of the region.
+ * @param   FigureVector    * found The list receiving the figures.
+ */
+void
+Scene::findDynFigures(const GLfloat region[6], FigureVector * found) const
+{
+    std::vector<unsigned> items;
+
+    dynGrid.query(region, &items);
+    gridFound(items, found);
+}
+
+/**
+ * Gets the dynamic figures whose box is closer to a point than a radius.
+ * @param   GLfloat center[3]   The point.
+ * @param   GLfloat radius      The radius.
+ * @param   FigureVector    * found The list receiving the figures.
+ */
+void
+Scene::findDynFigures(const GLfloat center[3], GLfloat radius, FigureVector * found) const
+{
+    std::vector<unsigned> items;
+
+    dynGrid.queryRadius(center, radius, &items);
+    gridFound(items, found);
 }
 
 /**
@@ -78,80 +636,299 @@ Scene::setHorizon(Material * hor)
 }
 
 /**
- * Prints the dynamic figures on the screen.
+ * Changes the state from the one of a figure to the one of the next figure, as
+ * Figure::activeMaterial() and deactivateMaterial() would, but skipping the polygon
+ * modes and the materials that are already set.
+ * @param   DrawItem    * prev  The figure drawn before, NULL if it is the first one.
+ * @param   DrawItem    * item  The figure to draw, NULL after the last one.
+ * @param   Renderer    * rend  The renderer receiving the state.
  */
 void
-Scene::printDynamic()
+Scene::changeState(const DrawItem * prev, const DrawItem * item, Renderer * rend)
 {
-    FaceList                * faces;
-    FaceList::iterator      faceIt;
-    PointList::iterator     pointIter;
-    FigureList::iterator    iter;
+    Material * prevMat = prev != NULL ? prev->material : NULL;
+    Material * mat = item != NULL ? item->material : NULL;
 
-    /* Going through the list of DynFigures. */
-    for (iter = DynFigures.begin(); iter != DynFigures.end(); iter++) {
-        faces = (*iter)->print();
-        
-        (*iter)->activeMaterial();
+    if (prevMat != NULL && prevMat != mat)
+        rend->unsetMaterial(prevMat);
 
-        /* Going through each of the faces. */
-        for (faceIt = faces->begin(); faceIt != faces->end(); faceIt++) {
-            glBegin((*iter)->getMode());
-
-            /* Printing the points. */
-            for (pointIter = (*faceIt)->vertex->begin(); pointIter != (*faceIt)->vertex->end(); pointIter++){
-    			/* Printing the points. */
-                glTexCoord2d((*pointIter)->s, (*pointIter)->t);
-                glVertex3d((*pointIter)->x, (*pointIter)->y, - (*pointIter)->z);
-            }
+    if (item == NULL)
+        return;
 
-            glEnd();
+    if (prev == NULL || prev->state != item->state) {
+        switch (item->state) {
+            case STATE_FILL:
+                rend->setPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+                break;
+            case STATE_SOLID:
+                rend->setPolygonMode(GL_FRONT, GL_LINE);
+                rend->setPolygonMode(GL_BACK, GL_POINT);
+                break;
+            default:
+                rend->setPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         }
-        delete faces;
-        (*iter)->deactivateMaterial();
     }
+
+    if (mat != NULL && mat != prevMat)
+        rend->setMaterial(mat);
 }
 
 /**
- * Prints the static figures on the screen.
+ * Calculates the key to sort a figure. The figures with a translucent material go in a
+ * second pass, from the back to the front; the other ones are grouped by state and, with
+ * the same state, drawn from the front to the back.
+ * @param   Material    * mat   The material of the figure, or NULL.
+ * @param   unsigned    state   The polygon mode of the figure.
+ * @param   double  pos[3]      The position of the figure.
+ * @param   double  view[16]    The modelview matrix of the camera.
+ * @return  The key of the figure.
+ */
+unsigned long long
+Scene::sortKey(Material * mat, unsigned state, const double pos[3],
+        const double view[16]) const
+{
+    unsigned long long key, depth, matId = 0, texId = 0;
+    const GLfloat * diffuse;
+    double dist, range = limits.zmax - limits.zmin;
+
+    /* The distance in front of the camera to the figure, as a fraction of the depth of
+     * the scene. */
+    dist = - (view[2] * pos[0] + view[6] * pos[1] + view[10] * pos[2] + view[14]);
+    dist = range > 0 ? dist / range : 0.0;
+    dist = dist < 0.0 ? 0.0 : (dist > 1.0 ? 1.0 : dist);
+    depth = (unsigned long long) (dist * 0xFFFF);
+
+    if (mat != NULL)
+        matId = mat->getId() & 0xFFFFF;
+
+    key = ((unsigned long long) state << 40) | (matId << 20) | texId;
+
+    diffuse = mat != NULL ? mat->getMatProperty(GL_DIFFUSE) : NULL;
+    if (diffuse != NULL && diffuse[3] < 1.0)
+        return (1ULL << 60) | ((0xFFFF - depth) << 44) | key;
+
+    return (key << 16) | depth;
+}
+
+/**
+ * Records the dynamic and the static figures and the instances. The figures are split in
+ * chunks recorded in parallel, each one into its own buffer; the static ones only record
+ * their geometry, or the one of their batches once the scene is finalized, and each group
+ * of instances records a single instanced draw. The figures, batches and instances out of
+ * the view of the camera, or hidden by the occluders, record nothing. Then, they are
+ * sorted by their state and appended in that order, changing only the state that differs
+ * between two figures.
+ * @param   CommandBuffer   * cmds  The buffer receiving the figures.
  */
 void
-Scene::printStatic()
+Scene::recordFigures(CommandBuffer * cmds)
 {
-    FaceList                * faces;
-    FaceList::iterator      faceIt;
-    PointList::iterator     pointIter;
-    StaticFigureList::iterator    iter;
+    DrawItemVector::iterator item;
+    const DrawItem * prev = NULL;
+    Frustum frustum;
+    double view[16];
+    unsigned chunks, count, statics, dynamics;
+    int cell;
+
+    PROFILE_SCOPE("Scene::recordFigures");
+
+    camera->getModelview(view);
+    frustum.set(camera);
+
+    /* The occluders seen are rasterized by the workers while the figures are culled by
+     * the frustum and the sets, to test the ones left against them. */
+    occlusion.begin(camera);
+    for (unsigned idx = 0; idx < occluders.size(); idx++) {
+        GeometryBuffer * geometry = occluders[idx]->getGeometry();
+
+        if (isOccluding(occluders[idx]) && frustum.isBoxVisible(geometry->getBounds()))
+            occlusion.addOccluder(geometry);
+    }
+    occlusion.end();
+
+    /* Only the dynamic figures seen are recorded, found by their cells. Once finalized,
+     * only the batches seen are recorded too; the others are culled. */
+    drawList.clear();
+    findDynFigures(frustum, &drawList);
+    dynamics = drawList.size();
+    RenderStats::frame.figuresCulled += DynFigures.size() - dynamics;
+    visibleBatches.clear();
+    if (finalized) {
+        rejoinBatches();
+        batchTree.cull(frustum, &visibleBatches);
+
+        /* The batches out of the set of the cell of the camera are not seen either. */
+        if ((cell = cameraCell()) >= 0)
+            visibleBatches.erase(std::remove_if(visibleBatches.begin(), visibleBatches.end(),
+                        [&](unsigned batch) {
+                            return !pvs.isVisible(cell, SCENE_NEIGHBOURS + batch);
+                        }), visibleBatches.end());
+        RenderStats::frame.figuresCulled += batched;
+        for (unsigned idx = 0; idx < visibleBatches.size(); idx++)
+            RenderStats::frame.figuresCulled -= batches[visibleBatches[idx]]->figures;
+    } else
+        drawList.insert(drawList.end(), StaFigures.begin(), StaFigures.end());
+    statics = drawList.size() + visibleBatches.size();
+    groupInstances();
+    count = statics + instanceGroups.size() - 1;
+    drawItems.resize(count);
+
+    chunks = (count + SCENE_RECORD_CHUNK - 1) / SCENE_RECORD_CHUNK;
+    if (recorders.size() < chunks)
+        recorders.resize(chunks);
+
+    occlusion.wait();
+
+    JobPool::instance()->parallelFor(chunks, [&](unsigned chunk) {
+        unsigned last = (chunk + 1) * SCENE_RECORD_CHUNK;
+        std::vector<GLfloat> matrices;
+        GeometryBuffer * geometry;
+        StaticBatch * batch;
+        Figure * fig;
+        Instance * inst;
+        const GLfloat * box;
+        GLfloat center[3], radius;
+        double pos[3];
 
-   /* Going through the list of static figures. */
-    for (iter = StaFigures.begin(); iter != StaFigures.end(); iter++) {
-        faces = (*iter)->print();
-        
-        (*iter)->activeMaterial();
+        PROFILE_SCOPE("Scene::recordChunk");
 
-        /* Going through each of the faces. */
-        for (faceIt = faces->begin(); faceIt != faces->end(); faceIt++) {
-            glBegin((*iter)->getMode());
+        if (last > count)
+            last = count;
 
-            /* Printing the points. */
-            for (pointIter = (*faceIt)->vertex->begin(); pointIter != (*faceIt)->vertex->end(); pointIter++){
-    			/* Printing the points. */
-                glTexCoord2d((*pointIter)->s, (*pointIter)->t);
-                glVertex3d((*pointIter)->x, (*pointIter)->y, - (*pointIter)->z);
+        recorders[chunk].clear();
+        for (unsigned idx = chunk * SCENE_RECORD_CHUNK; idx < last; idx++) {
+            DrawItem& draw = drawItems[idx];
+
+            draw.buffer = chunk;
+            draw.first = recorders[chunk].getCommands().size();
+            draw.drawn = draw.culled = draw.occluded = 0;
+
+            if (idx < dynamics) {
+                fig = drawList[idx];
+                draw.material = fig->getMaterial();
+                draw.state = polygonState(fig);
+                pos[0] = fig->org[0];
+                pos[1] = fig->org[1];
+                pos[2] = - fig->org[2];
+
+                /* The figures never bounded are always drawn. */
+                box = fig->getBounds();
+                if (box == NULL || occlusion.isBoxVisible(box)) {
+                    fig->record(&recorders[chunk]);
+                    draw.drawn = 1;
+                } else
+                    draw.occluded = 1;
+            } else if (idx < statics) {
+                /* The static figures are drawn from their geometry, built only once. */
+                if (idx < drawList.size()) {
+                    fig = drawList[idx];
+                    geometry = ((StaticFigure *) fig)->getGeometry();
+                    draw.material = fig->getMaterial();
+                    draw.state = polygonState(fig);
+                    draw.drawn = 1;
+                } else {
+                    batch = batches[visibleBatches[idx - drawList.size()]];
+                    geometry = &batch->geometry;
+                    draw.material = batch->material;
+                    draw.state = batch->state;
+                    draw.drawn = batch->figures;
+                }
+
+                box = geometry->getBounds();
+                for (unsigned axis = 0; axis < 3; axis++)
+                    pos[axis] = (box[axis] + box[axis + 3]) / 2;
+
+                if (idx < drawList.size() && !frustum.isBoxVisible(box))
+                    std::swap(draw.drawn, draw.culled);
+                else if (!occlusion.isBoxVisible(box))
+                    std::swap(draw.drawn, draw.occluded);
+                else
+                    recorders[chunk].drawStatic(geometry);
+            } else {
+                /* The instances of a group share the state, the first one places it. */
+                unsigned first = instanceGroups[idx - statics];
+                unsigned end = instanceGroups[idx - statics + 1];
+
+                inst = instances[first];
+                draw.material = inst->getMaterial();
+                draw.state = polygonState(inst);
+                pos[0] = inst->org[0];
+                pos[1] = inst->org[1];
+                pos[2] = - inst->org[2];
+
+                /* Each instance is tested with the sphere around the mesh, placed by
+                 * its matrix, and only the visible ones are drawn. */
+                geometry = inst->getMesh()->getGeometry();
+                box = geometry->getBounds();
+                for (unsigned axis = 0; axis < 3; axis++)
+                    center[axis] = (box[axis] + box[axis + 3]) / 2;
+                radius = sqrt((box[3] - box[0]) * (box[3] - box[0]) +
+                        (box[4] - box[1]) * (box[4] - box[1]) +
+                        (box[5] - box[2]) * (box[5] - box[2])) / 2;
+
+                matrices.resize((end - first) * 16);
+                for (unsigned num = first; num < end; num++) {
+                    GLfloat * matrix = &matrices[draw.drawn * 16];
+                    GLfloat placed[4], around[6];
+
+                    instances[num]->getMatrix(matrix);
+                    for (unsigned axis = 0; axis < 3; axis++)
+                        placed[axis] = matrix[axis] * center[0] +
+                            matrix[4 + axis] * center[1] + matrix[8 + axis] * center[2] +
+                            matrix[12 + axis];
+                    placed[3] = radius;
+
+                    for (unsigned axis = 0; axis < 3; axis++) {
+                        around[axis] = placed[axis] - radius;
+                        around[axis + 3] = placed[axis] + radius;
+                    }
+
+                    if (!frustum.isSphereVisible(placed))
+                        draw.culled++;
+                    else if (!occlusion.isBoxVisible(around))
+                        draw.occluded++;
+                    else
+                        draw.drawn++;
+                }
+
+                if (draw.drawn > 0)
+                    recorders[chunk].drawInstanced(geometry, matrices.data(), draw.drawn);
+
+                /* The instances are counted apart from the figures when they are drawn. */
+                draw.drawn = 0;
             }
 
-            glEnd();
+            draw.key = sortKey(draw.material, draw.state, pos, view);
+            draw.last = recorders[chunk].getCommands().size();
         }
-        delete faces;
-        (*iter)->deactivateMaterial();
+    });
+
+    /* The figures with the same key keep the order they were added. */
+    std::stable_sort(drawItems.begin(), drawItems.end(),
+            [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+
+    /* The figures out of the view recorded nothing, so they change no state. */
+    for (item = drawItems.begin(); item != drawItems.end(); item++) {
+        RenderStats::frame.figuresDrawn += item->drawn;
+        RenderStats::frame.figuresCulled += item->culled;
+        RenderStats::frame.figuresOccluded += item->occluded;
+        if (item->first == item->last)
+            continue;
+
+        changeState(prev, &*item, cmds);
+        cmds->append(recorders[item->buffer], item->first, item->last);
+        prev = &*item;
     }
+    changeState(prev, NULL, cmds);
 }
 
 /**
- * Prints the whole scene on the screen.
+ * Records the whole scene into a command buffer, which can be executed later by any
+ * renderer.
+ * @param   CommandBuffer   * cmds  The buffer receiving the scene.
  */
 void
-Scene::print()
+Scene::record(CommandBuffer * cmds)
 {
     LightList::iterator     liter;
 
@@ -167,35 +944,48 @@ Scene::print()
     if (camera == NULL)
         return;
     else
-        camera->setFOV(0.1, 90, limits.zmax - limits.zmin);
+        camera->setFOV(0.1, 45, limits.zmax - limits.zmin);
 
-    camera->activate();
+    cmds->activateCamera(camera);
 #ifdef DEBUG
     long long xstep, zstep;
     /* Print the XZ plane as lines for debug. */
-    glBegin(GL_LINES);
+    cmds->begin(GL_LINES);
     for (xstep = limits.xmin; xstep < limits.xmax; xstep += 10) {
-        glVertex3d(xstep, limits.ymin, limits.zmin);
-        glVertex3d(xstep, limits.ymin, limits.zmax);
+        cmds->vertex(xstep, limits.ymin, limits.zmin);
+        cmds->vertex(xstep, limits.ymin, limits.zmax);
     }
 
     for (zstep = limits.zmin; zstep < limits.zmax; zstep += 10) {
-        glVertex3d(limits.xmin, limits.ymin, zstep);
-        glVertex3d(limits.xmax, limits.ymin, zstep);
+        cmds->vertex(limits.xmin, limits.ymin, zstep);
+        cmds->vertex(limits.xmax, limits.ymin, zstep);
     }
-    glEnd();
+    cmds->end();
 #endif
 
-    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambient);
+    cmds->setAmbient(ambient);
  
-    printDynamic();
-    printStatic();
+    recordFigures(cmds);
 
     /* Activating the lights of the scene. */
     for (liter = lights.begin(); liter != lights.end(); liter++)
-        (*liter)->activate();
+        cmds->setLight(*liter);
+
+    cmds->deactivateCamera(camera);
+}
+
+/**
+ * Prints the whole scene on the screen.
+ * @param   Renderer    * rend  The renderer receiving the scene.
+ */
+void
+Scene::print(Renderer * rend)
+{
+    PROFILE_SCOPE("Scene::print");
 
-    camera->deactivate();
+    commands.clear();
+    record(&commands);
+    commands.execute(rend);
 }
 
 /**
@@ -205,13 +995,11 @@ Scene::print()
 void
 Scene::addLight(Light light)
 {
-    int maxLights;
     Light * lamp = new Light(light);
 
     lamp->idx = lights.size();
-    glGetIntegerv(GL_MAX_LIGHTS, &maxLights);
 
-    if ((int)lights.size() < maxLights)
+    if ((int)lights.size() < GLState::getMaxLights())
         lights.push_back(lamp);
     else
         delete lamp;
@@ -234,19 +1022,93 @@ Scene::setAmbient(float red, float green, float blue)
 
 /**
  * Process the scene in the idle state (not printing).
- * @param   double  time    The time since the program was launched.
+ * @param   double  time    The time since the program was launched, in milliseconds.
  */
 void
 Scene::idle(const double time)
 {
-    FigureList::iterator fig;
+    enum position side;
+    Figure * fig;
+
+    PROFILE_SCOPE("Scene::idle");
+
+    for (unsigned dir = 0; dir <= GES_DOWN; dir++)
+        leaving[dir].clear();
 
-    for (fig = DynFigures.begin(); fig != DynFigures.end(); fig++)
-        (*fig)->motion(time);
+    /* The figures are bounded after they move and moved in the grid, to be culled when
+     * they are recorded; the ones out of the limits wait for the map to hand them off. */
+    for (unsigned item = 0; item < gridFigures.size(); item++) {
+        if ((fig = gridFigures[item]) == NULL)
+            continue;
+
+        fig->motion(time);
+        fig->updateBounds();
+        if (fig->getBounds() != NULL) {
+            dynGrid.move(item, fig->getBounds());
+            if ((side = exitOf(fig->getBounds())) != GES_CENTER)
+                leaving[side].push_back(item);
+        }
+    }
     if (camera != NULL)
         camera->cameraCtrl(time, NULL);
 }
 
+/**
+ * Gets the side of the limits a box left through, by its center. The limits take their
+ * minimum and not their maximum, as the scenes of a map do; a box out of them along
+ * several axes is given the first one, x, then y, then z.
+ * @param   GLfloat box[6]  The minimum and maximum x, y and z of the box.
+ * @return  The side, or GES_CENTER if the center is inside the limits.
+ */
+enum position
+Scene::exitOf(const GLfloat box[6]) const
+{
+    GLfloat center[3];
+
+    for (unsigned axis = 0; axis < 3; axis++)
+        center[axis] = (box[axis] + box[axis + 3]) * 0.5f;
+
+    if (center[0] >= (GLfloat) limits.xmax)
+        return GES_EAST;
+    if (center[0] < (GLfloat) limits.xmin)
+        return GES_WEST;
+    if (center[1] >= (GLfloat) limits.ymax)
+        return GES_UP;
+    if (center[1] < (GLfloat) limits.ymin)
+        return GES_DOWN;
+    if (center[2] >= (GLfloat) limits.zmax)
+        return GES_SOUTH;
+    if (center[2] < (GLfloat) limits.zmin)
+        return GES_NORTH;
+
+    return GES_CENTER;
+}
+
+/**
+ * Moves the figures which left through a side, found by the last idle(), to the scene
+ * on that side. Each one is spliced from DynFigures into the list of the other scene and
+ * its handle is moved between the grids, so the move does not depend on the figures of
+ * either scene.
+ * @param   position    side    The side.
+ * @param   Scene       * target    The scene on that side.
+ */
+void
+Scene::handOff(enum position side, Scene * target)
+{
+    std::vector<unsigned>& batch = leaving[side];
+    FigureList::iterator link;
+
+    for (unsigned idx = 0; idx < batch.size(); idx++) {
+        link = gridLinks[batch[idx]];
+        target->DynFigures.splice(target->DynFigures.end(), DynFigures, link);
+        target->gridAdd(link);
+
+        dynGrid.remove(batch[idx]);
+        gridFigures[batch[idx]] = NULL;
+    }
+    batch.clear();
+}
+
 /**
  * Sets the camera for the scene.
  * @param   Camera  cam     The camera to be set into the screen.
@@ -257,3 +1119,511 @@ Scene::addCamera(Camera * cam)
     camera = cam;
 }
 
+
+/**
+ * Destructor of the loaders.
+ */
+SceneLoader::~SceneLoader()
+{
+}
+
+/**
+ * Keeps the changes of a scene leaving the block around the camera. Nothing is kept by
+ * default.
+ * @param   Scene       * scene     The scene.
+ * @param   long long   x, y, z     The coordinates of the scene in its map.
+ */
+void
+SceneLoader::store(Scene * scene, long long x, long long y, long long z)
+{
+}
+
+/**
+ * Frees a scene once it is stored.
+ * @param   Scene   * scene     The scene.
+ */
+void
+SceneLoader::release(Scene * scene)
+{
+    delete scene;
+}
+
+/**
+ * Constructor of the map.
+ * @param   SceneLoader * loader    The source of the scenes.
+ * @param   long long   sizeX, sizeY, sizeZ The size of the scenes along each axis.
+ */
+Map::Map(SceneLoader * loader, long long sizeX, long long sizeY, long long sizeZ)
+    : loaders(MAP_LOADERS)
+{
+    this->loader = loader;
+    size[0] = sizeX;
+    size[1] = sizeY;
+    size[2] = sizeZ;
+    placed = false;
+    camera = NULL;
+    for (unsigned axis = 0; axis < 3; axis++) {
+        center[axis] = 0;
+        eye[axis] = heading[axis] = 0.0;
+    }
+}
+
+/**
+ * Destructor of the map. The scenes being loaded are waited for, and all of them are
+ * freed, so it must be destroyed in the thread of the context.
+ */
+Map::~Map()
+{
+    SceneMap::iterator it;
+
+    lock.lock();
+    pending.clear();
+    lock.unlock();
+    loaders.wait();
+
+    for (it = resident.begin(); it != resident.end(); it++)
+        if (it->second != NULL)
+            loader->release(it->second);
+    for (it = loaded.begin(); it != loaded.end(); it++)
+        if (it->second != NULL)
+            loader->release(it->second);
+    for (unsigned idx = 0; idx < stored.size(); idx++)
+        loader->release(stored[idx]);
+}
+
+/**
+ * Sets the camera of the map.
+ * @param   Camera  * cam   The camera.
+ */
+void
+Map::addCamera(Camera * cam)
+{
+    camera = cam;
+}
+
+/**
+ * Returns whether a scene is in the block of 3x3x3 scenes around the one of the camera.
+ * @param   SceneKey    key     The coordinates of the scene.
+ * @return  Whether it is.
+ */
+bool
+Map::isNear(const SceneKey& key) const
+{
+    return llabs(std::get<0>(key) - center[0]) <= 1 &&
+        llabs(std::get<1>(key) - center[1]) <= 1 && llabs(std::get<2>(key) - center[2]) <= 1;
+}
+
+/**
+ * Moves the block to the scene of the camera, with the lock taken. The scenes leaving it
+ * are given to the loading threads to be stored, the ones waiting to be loaded out of it
+ * are forgotten, and the ones entering it are requested. All the requests are sorted
+ * again: the scene of the camera first, then by their distance, sooner the ones in the
+ * direction the camera moves.
+ * @param   long long   coords[3]   The coordinates of the scene of the camera.
+ */
+void
+Map::moveTo(const long long coords[3])
+{
+    SceneMap::iterator it;
+    SceneRequestList::iterator req;
+    long long offset[3];
+
+    for (unsigned axis = 0; axis < 3; axis++)
+        center[axis] = coords[axis];
+    placed = true;
+
+    for (it = resident.begin(); it != resident.end(); ) {
+        Scene * scene = it->second;
+        SceneKey key = it->first;
+
+        if (isNear(key)) {
+            it++;
+            continue;
+        }
+
+        if (scene != NULL) {
+            loaders.submit([this, scene, key]() {
+                loader->store(scene, std::get<0>(key), std::get<1>(key), std::get<2>(key));
+
+                std::lock_guard<std::mutex> guard(lock);
+                stored.push_back(scene);
+            });
+        }
+        it = resident.erase(it);
+    }
+
+    for (req = pending.begin(); req != pending.end(); ) {
+        if (isNear(req->key)) {
+            req++;
+            continue;
+        }
+        requested.erase(req->key);
+        req = pending.erase(req);
+    }
+
+    for (offset[2] = -1; offset[2] <= 1; offset[2]++) {
+        for (offset[1] = -1; offset[1] <= 1; offset[1]++) {
+            for (offset[0] = -1; offset[0] <= 1; offset[0]++) {
+                SceneRequest request;
+
+                request.key = std::make_tuple(coords[0] + offset[0], coords[1] + offset[1],
+                        coords[2] + offset[2]);
+                if (resident.count(request.key) > 0 || requested.count(request.key) > 0)
+                    continue;
+
+                requested.insert(request.key);
+                pending.push_back(request);
+                loaders.submit([this]() { loadNext(); });
+            }
+        }
+    }
+
+    for (req = pending.begin(); req != pending.end(); req++) {
+        double dist = 0.0, ahead = 0.0, step;
+
+        for (unsigned axis = 0; axis < 3; axis++) {
+            step = (axis == 0 ? std::get<0>(req->key) : axis == 1 ? std::get<1>(req->key) :
+                    std::get<2>(req->key)) - center[axis];
+            dist += step * step;
+            ahead += step * heading[axis];
+        }
+        req->priority = dist == 0.0 ? -1.0 : dist - MAP_AHEAD * ahead;
+    }
+
+    /* The first one to load goes at the end. */
+    std::sort(pending.begin(), pending.end(),
+            [](const SceneRequest& a, const SceneRequest& b) {
+                return a.priority > b.priority;
+            });
+}
+
+/**
+ * Loads the scene requested first, in a loading thread. The lock is only taken to get
+ * the request and to give the scene, never while it is loaded.
+ */
+void
+Map::loadNext()
+{
+    SceneRequest request;
+    Scene * scene;
+
+    lock.lock();
+    if (pending.empty()) {
+        lock.unlock();
+        return;
+    }
+    request = pending.back();
+    pending.pop_back();
+    lock.unlock();
+
+    scene = loader->load(std::get<0>(request.key), std::get<1>(request.key),
+            std::get<2>(request.key));
+
+    std::lock_guard<std::mutex> guard(lock);
+    loaded[request.key] = scene;
+}
+
+/**
+ * Follows the camera. If the loading threads hold the lock, nothing is done until the
+ * next call, so the frame goes on without waiting; otherwise the block is moved when the
+ * camera changes of scene, the scenes loaded become part of it and the ones stored are
+ * freed.
+ */
+void
+Map::update()
+{
+    std::unique_lock<std::mutex> guard(lock, std::try_to_lock);
+    SceneReleaseList releasing;
+    SceneMap::iterator it;
+    long long coords[3];
+    double pos[3], length = 0.0;
+
+    PROFILE_SCOPE("Map::update");
+
+    if (camera == NULL || !guard.owns_lock())
+        return;
+
+    /* The direction of travel is kept while the camera stands still. */
+    camera->getEye(pos);
+    for (unsigned axis = 0; axis < 3; axis++)
+        length += (pos[axis] - eye[axis]) * (pos[axis] - eye[axis]);
+    length = sqrt(length);
+    for (unsigned axis = 0; axis < 3; axis++) {
+        if (!placed)
+            heading[axis] = 0.0;
+        else if (length > 0.0)
+            heading[axis] = (pos[axis] - eye[axis]) / length;
+        eye[axis] = pos[axis];
+        coords[axis] = (long long) floor(pos[axis] / size[axis]);
+    }
+
+    if (!placed || coords[0] != center[0] || coords[1] != center[1] ||
+            coords[2] != center[2])
+        moveTo(coords);
+
+    for (it = loaded.begin(); it != loaded.end(); it++) {
+        requested.erase(it->first);
+        if (isNear(it->first)) {
+            if (it->second != NULL)
+                it->second->camera = NULL;
+            resident[it->first] = it->second;
+        } else if (it->second != NULL)
+            releasing.push_back(it->second);
+    }
+    loaded.clear();
+    releasing.insert(releasing.end(), stored.begin(), stored.end());
+    stored.clear();
+    guard.unlock();
+
+    for (unsigned idx = 0; idx < releasing.size(); idx++)
+        loader->release(releasing[idx]);
+}
+
+/**
+ * Prints the scenes of the block, first the one of the camera. The ones its potentially
+ * visible sets say cannot be seen from the camera are skipped.
+ * @param   Renderer    * rend  The renderer receiving the scenes.
+ */
+void
+Map::print(Renderer * rend)
+{
+    Scene * home = getScene(0, 0, 0), * scene;
+    SceneMap::iterator it;
+
+    PROFILE_SCOPE("Map::print");
+
+    if (camera == NULL)
+        return;
+
+    if (home != NULL) {
+        home->camera = camera;
+        home->print(rend);
+        home->camera = NULL;
+    }
+
+    for (it = resident.begin(); it != resident.end(); it++) {
+        if ((scene = it->second) == NULL || scene == home)
+            continue;
+
+        if (home != NULL && !home->isNeighbourVisible(std::get<0>(it->first) - center[0],
+                    std::get<1>(it->first) - center[1], std::get<2>(it->first) - center[2]))
+            continue;
+
+        scene->camera = camera;
+        scene->print(rend);
+        scene->camera = NULL;
+    }
+}
+
+/**
+ * Hands the dynamic figures which left the limits of their scene in the last idle to the
+ * scene they entered, each side of each scene at once. The figures whose scene is still
+ * loading, is out of the block or does not exist stay where they are, found again out of
+ * the limits by the next idle, so they are handed off once the scene is there.
+ */
+void
+Map::handOff()
+{
+    SceneMap::iterator it, target;
+    Scene * scene;
+
+    PROFILE_SCOPE("Map::handOff");
+
+    for (it = resident.begin(); it != resident.end(); it++) {
+        if ((scene = it->second) == NULL)
+            continue;
+
+        for (unsigned side = 0; side <= GES_DOWN; side++) {
+            if (scene->leaving[side].empty())
+                continue;
+
+            target = resident.find(std::make_tuple(
+                        std::get<0>(it->first) + sideSteps[side][0],
+                        std::get<1>(it->first) + sideSteps[side][1],
+                        std::get<2>(it->first) + sideSteps[side][2]));
+            if (target != resident.end() && target->second != NULL)
+                scene->handOff((enum position) side, target->second);
+        }
+    }
+}
+
+/**
+ * Processes the map in the idle state: follows the camera, then processes the scenes
+ * of the block, hands off the dynamic figures leaving them, and processes the camera,
+ * which is moved only once.
+ * @param   double  time    The time since the program was launched, in milliseconds.
+ */
+void
+Map::idle(const double time)
+{
+    SceneMap::iterator it;
+
+    PROFILE_SCOPE("Map::idle");
+
+    update();
+
+    for (it = resident.begin(); it != resident.end(); it++)
+        if (it->second != NULL)
+            it->second->idle(time);
+    handOff();
+
+    if (camera != NULL)
+        camera->cameraCtrl(time, NULL);
+}
+
+/**
+ * Gets a scene of the block.
+ * @param   int     dx, dy, dz  The position from the scene of the camera, -1, 0 or 1.
+ * @return  The scene, or NULL if it is not loaded or there is none.
+ */
+Scene *
+Map::getScene(int dx, int dy, int dz) const
+{
+    SceneMap::const_iterator it = resident.find(std::make_tuple(center[0] + dx,
+                center[1] + dy, center[2] + dz));
+
+    return it != resident.end() ? it->second : NULL;
+}
+
+/**
+ * Gets the number of scenes requested and not handed yet.
+ * @return  The number of scenes.
+ */
+unsigned
+Map::getRequested() const
+{
+    return requested.size();
+}
+
+/**
+ * Constructor of the region, without maps.
+ */
+Region::Region()
+{
+    current = NULL;
+}
+
+/**
+ * Adds a map to the region.
+ * @param   Map     * map   The map.
+ */
+void
+Region::addMap(Map * map)
+{
+    maps.push_back(map);
+    if (current == NULL)
+        current = map;
+}
+
+/**
+ * Sets the map being played.
+ * @param   Map     * map   The map, one of the region.
+ */
+void
+Region::setMap(Map * map)
+{
+    current = map;
+}
+
+/**
+ * Gets the map being played.
+ * @return  The map, NULL if there is none.
+ */
+Map *
+Region::getMap() const
+{
+    return current;
+}
+
+/**
+ * Constructor of the world, without regions.
+ */
+World::World()
+{
+    current = NULL;
+}
+
+/**
+ * Adds a region to the world.
+ * @param   Region  * region    The region.
+ */
+void
+World::addRegion(Region * region)
+{
+    regions.push_back(region);
+    if (current == NULL)
+        current = region;
+}
+
+/**
+ * Sets the region being played.
+ * @param   Region  * region    The region, one of the world.
+ */
+void
+World::setRegion(Region * region)
+{
+    current = region;
+}
+
+/**
+ * Gets the region being played.
+ * @return  The region, NULL if there is none.
+ */
+Region *
+World::getRegion() const
+{
+    return current;
+}
+
+/**
+ * Constructor of the universe, without worlds.
+ */
+Universe::Universe()
+{
+    current = NULL;
+}
+
+/**
+ * Adds a world to the universe.
+ * @param   World   * world     The world.
+ */
+void
+Universe::addWorld(World * world)
+{
+    worlds.push_back(world);
+    if (current == NULL)
+        current = world;
+}
+
+/**
+ * Sets the world being played.
+ * @param   World   * world     The world, one of the universe.
+ */
+void
+Universe::setWorld(World * world)
+{
+    current = world;
+}
+
+/**
+ * Gets the world being played.
+ * @return  The world, NULL if there is none.
+ */
+World *
+Universe::getWorld() const
+{
+    return current;
+}
+
+/**
+ * Gets the map being played.
+ * @return  The map of the current region of the current world, NULL if there is none.
+ */
+Map *
+Universe::getMap() const
+{
+    if (current == NULL || current->getRegion() == NULL)
+        return NULL;
+
+    return current->getRegion()->getMap();
+}